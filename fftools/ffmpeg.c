@@ -338,6 +338,7 @@ static void ffmpeg_cleanup(int ret)
 
     hw_device_free_all();
 
+    av_executor_free(&thread_pool);
     av_freep(&filter_nbthreads);
 
     av_freep(&input_files);
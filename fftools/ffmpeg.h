@@ -41,6 +41,7 @@
 #include "libavutil/avutil.h"
 #include "libavutil/dict.h"
 #include "libavutil/eval.h"
+#include "libavutil/executor.h"
 #include "libavutil/fifo.h"
 #include "libavutil/hwcontext.h"
 #include "libavutil/pixfmt.h"
@@ -716,6 +717,9 @@ extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_pipeline_stages;
+extern int thread_pool_size;
+extern AVExecutor *thread_pool;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
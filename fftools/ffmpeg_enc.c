@@ -326,6 +326,7 @@ int enc_open(void *opaque, const AVFrame *frame)
         enc_ctx->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
 
     enc_ctx->flags |= AV_CODEC_FLAG_FRAME_DURATION;
+    enc_ctx->thread_pool = thread_pool;
 
     ret = hw_device_setup_for_encode(e, enc_ctx, frame ? frame->hw_frames_ctx : NULL);
     if (ret < 0) {
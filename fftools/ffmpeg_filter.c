@@ -49,6 +49,8 @@ typedef struct FilterGraphPriv {
     char             log_name[32];
 
     int              is_simple;
+    // the graph runs one of the leading stages of a pipelined simple filtergraph
+    int              is_stage;
     // true when the filtergraph contains only meta filters
     // that do not modify the frame data
     int              is_meta;
@@ -126,6 +128,8 @@ typedef struct InputFilterPriv {
 
     int                 eof;
     int                 bound;
+    // the input is fed by the preceding stage of a pipelined simple filtergraph
+    int                 src_is_stage;
     int                 drop_warned;
     uint64_t            nb_dropped;
 
@@ -246,6 +250,9 @@ typedef struct OutputFilterPriv {
     FPSConvContext          fps;
 
     unsigned                flags;
+
+    // the output feeds the next stage of a pipelined simple filtergraph
+    int                     dst_is_stage;
 } OutputFilterPriv;
 
 static OutputFilterPriv *ofp_from_ofilter(OutputFilter *ofilter)
@@ -932,8 +939,10 @@ static int ofilter_bind_ifilter(OutputFilter *ofilter, InputFilterPriv *ifp,
 static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_idx)
 {
     FilterGraphPriv      *fgp = fgp_from_fg(ifp->ifilter.graph);
+    FilterGraphPriv  *fgp_src = fgp_from_fg(fg_src);
     OutputFilter *ofilter_src = fg_src->outputs[out_idx];
     OutputFilterOptions opts;
+    unsigned sch_idx_src = fg_src->index;
     char name[32];
     int ret;
 
@@ -958,7 +967,15 @@ static int ifilter_bind_fg(InputFilterPriv *ifp, FilterGraph *fg_src, int out_id
     if (ret < 0)
         return ret;
 
-    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(fg_src->index, out_idx),
+    if (fgp_src->is_stage) {
+        ifp->src_is_stage = 1;
+        ofp_from_ofilter(ofilter_src)->dst_is_stage = 1;
+        // stages are created after the simple filtergraphs of preceding
+        // outputs, which are known to the scheduler but not in filtergraphs
+        sch_idx_src = fgp_src->sch_idx;
+    }
+
+    ret = sch_connect(fgp->sch, SCH_FILTER_OUT(sch_idx_src, out_idx),
                                 SCH_FILTER_IN(fgp->sch_idx, ifp->index));
     if (ret < 0)
         return ret;
@@ -1203,6 +1220,214 @@ fail:
     return 0;
 }
 
+/**
+ * Print a parsed filter back as a filtergraph description, escaping the
+ * option keys and values for the option parser and the options for the
+ * graph parser.
+ */
+static int filter_print(AVBPrint *bp, const AVFilterParams *p)
+{
+    const AVDictionaryEntry *e = NULL;
+    AVBPrint args;
+    int ret = 0;
+
+    av_bprint_escape(bp, p->filter_name, "=,;[]", AV_ESCAPE_MODE_BACKSLASH, 0);
+    if (p->instance_name) {
+        av_bprint_chars(bp, '@', 1);
+        av_bprint_escape(bp, p->instance_name, "=,;[]", AV_ESCAPE_MODE_BACKSLASH, 0);
+    }
+
+    av_bprint_init(&args, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while ((e = av_dict_iterate(p->opts, e))) {
+        if (args.len)
+            av_bprint_chars(&args, ':', 1);
+        av_bprint_escape(&args, e->key,   "=:", AV_ESCAPE_MODE_BACKSLASH, 0);
+        av_bprint_chars(&args, '=', 1);
+        av_bprint_escape(&args, e->value, "=:", AV_ESCAPE_MODE_BACKSLASH, 0);
+    }
+    if (!av_bprint_is_complete(&args))
+        ret = AVERROR(ENOMEM);
+    else if (args.len) {
+        av_bprint_chars(bp, '=', 1);
+        av_bprint_escape(bp, args.str, "[],;", AV_ESCAPE_MODE_BACKSLASH, 0);
+    }
+    av_bprint_finalize(&args, NULL);
+
+    return ret;
+}
+
+/**
+ * Split a filtergraph description consisting of a single linear chain of
+ * filters into at most max_parts descriptions of consecutive filters.
+ *
+ * @return number of parts written to *pparts, 0 if the description cannot
+ *         be split (it does not parse, contains link labels, scaler flags or
+ *         several chains, or a single filter), a negative error code on
+ *         failure
+ */
+static int chain_split(const char *desc, int max_parts, char ***pparts)
+{
+    AVFilterGraph        *graph;
+    AVFilterGraphSegment *seg = NULL;
+    const AVFilterChain  *ch;
+    char **parts = NULL;
+    int nb_parts = 0, ret = 0;
+
+    graph = avfilter_graph_alloc();
+    if (!graph)
+        return AVERROR(ENOMEM);
+
+    // parsing errors are reported when the graph itself is created
+    if (avfilter_graph_segment_parse(graph, desc, 0, &seg) < 0 ||
+        seg->nb_chains != 1 || seg->scale_sws_opts)
+        goto end;
+
+    ch = seg->chains[0];
+    for (size_t i = 0; i < ch->nb_filters; i++) {
+        if (ch->filters[i]->nb_inputs || ch->filters[i]->nb_outputs)
+            goto end;
+    }
+
+    nb_parts = FFMIN(ch->nb_filters, max_parts);
+    if (nb_parts < 2) {
+        nb_parts = 0;
+        goto end;
+    }
+
+    parts = av_calloc(nb_parts, sizeof(*parts));
+    if (!parts) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (int i = 0; i < nb_parts; i++) {
+        // part i contains the filters from start to end (exclusive)
+        const size_t start = ch->nb_filters *  i      / nb_parts;
+        const size_t end   = ch->nb_filters * (i + 1) / nb_parts;
+        AVBPrint bp;
+
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        for (size_t j = start; j < end && ret >= 0; j++) {
+            if (j > start)
+                av_bprint_chars(&bp, ',', 1);
+            ret = filter_print(&bp, ch->filters[j]);
+        }
+        if (ret < 0) {
+            av_bprint_finalize(&bp, NULL);
+            goto end;
+        }
+        ret = av_bprint_finalize(&bp, &parts[i]);
+        if (ret < 0)
+            goto end;
+    }
+
+    *pparts = parts;
+    parts   = NULL;
+end:
+    if (parts) {
+        for (int i = 0; i < nb_parts; i++)
+            av_freep(&parts[i]);
+        av_freep(&parts);
+    }
+    avfilter_graph_segment_free(&seg);
+    avfilter_graph_free(&graph);
+
+    return ret < 0 ? ret : nb_parts;
+}
+
+/**
+ * Create the leading stages of a pipelined simple filtergraph, each as
+ * a separate filtergraph running in its own thread. The first stage is fed
+ * by ist, every following stage by the output of the preceding one.
+ *
+ * @param fg_last will be set to the filtergraph running the last of the
+ *                created stages
+ */
+static int fg_create_stages(FilterGraph **fg_last, InputStream *ist,
+                            char **stages, int nb_stages, Scheduler *sch,
+                            const OutputFilterOptions *opts)
+{
+    FilterGraph *fg_prev = NULL;
+    char *sws_opts = NULL;
+    int ret = 0;
+
+    // graph-level options of simple filtergraphs are not applied to
+    // standalone filtergraphs, so pass the scaling options explicitly;
+    // the graph syntax requires them to start with the flags
+    if (av_dict_count(opts->sws_opts)) {
+        const AVDictionaryEntry *e = av_dict_get(opts->sws_opts, "sws_flags", NULL, 0);
+        AVDictionary *other = NULL;
+        char *other_str = NULL;
+
+        ret = av_dict_copy(&other, opts->sws_opts, 0);
+        if (ret >= 0)
+            ret = av_dict_set(&other, "sws_flags", NULL, 0);
+        if (ret >= 0)
+            ret = av_dict_get_string(other, &other_str, '=', ':');
+        av_dict_free(&other);
+        if (ret < 0)
+            return ret;
+
+        sws_opts = av_asprintf("%s%s%s", e ? e->value : "bicubic",
+                               *other_str ? ":" : "", other_str);
+        av_freep(&other_str);
+        if (!sws_opts)
+            return AVERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < nb_stages; i++) {
+        FilterGraph     *fg;
+        FilterGraphPriv *fgp;
+        char *desc = stages[i];
+
+        stages[i] = NULL;
+
+        if (sws_opts) {
+            char *tmp = av_asprintf("sws_flags=%s;%s", sws_opts, desc);
+            av_freep(&desc);
+            if (!tmp) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            desc = tmp;
+        }
+
+        ret = fg_create(NULL, desc, sch);
+        if (ret < 0)
+            break;
+        fg  = filtergraphs[nb_filtergraphs - 1];
+        fgp = fgp_from_fg(fg);
+
+        fgp->is_stage = 1;
+        if (opts->nb_threads >= 0)
+            fgp->nb_threads = opts->nb_threads;
+
+        snprintf(fgp->log_name, sizeof(fgp->log_name), "vf%s/%d",
+                 opts->name, i);
+
+        if (fg->nb_inputs != 1 || fg->nb_outputs != 1) {
+            av_log(fg, AV_LOG_ERROR, "Pipeline stage '%s' was expected to have "
+                   "exactly 1 input and 1 output. Please adjust the filter "
+                   "chain or disable pipelining.\n", fgp->graph_desc);
+            ret = AVERROR(EINVAL);
+            break;
+        }
+
+        ret = fg_prev ?
+              ifilter_bind_fg(ifp_from_ifilter(fg->inputs[0]), fg_prev, 0) :
+              ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
+        if (ret < 0)
+            break;
+
+        fg_prev = fg;
+    }
+
+    av_freep(&sws_opts);
+
+    *fg_last = fg_prev;
+    return ret;
+}
+
 int fg_create_simple(FilterGraph **pfg,
                      InputStream *ist,
                      char *graph_desc,
@@ -1210,10 +1435,35 @@ int fg_create_simple(FilterGraph **pfg,
                      const OutputFilterOptions *opts)
 {
     const enum AVMediaType type = ist->par->codec_type;
-    FilterGraph *fg;
+    FilterGraph *fg, *fg_src = NULL;
     FilterGraphPriv *fgp;
+    char **stages = NULL;
+    int nb_stages = 0;
     int ret;
 
+    if (filter_pipeline_stages > 1 && type == AVMEDIA_TYPE_VIDEO) {
+        nb_stages = chain_split(graph_desc, filter_pipeline_stages, &stages);
+        if (nb_stages < 0) {
+            av_freep(&graph_desc);
+            return nb_stages;
+        }
+    }
+
+    if (nb_stages > 1) {
+        // the last stage is run by the simple filtergraph itself
+        av_freep(&graph_desc);
+        graph_desc = stages[nb_stages - 1];
+
+        ret = fg_create_stages(&fg_src, ist, stages, nb_stages - 1, sch, opts);
+        for (int i = 0; i < nb_stages - 1; i++)
+            av_freep(&stages[i]);
+        av_freep(&stages);
+        if (ret < 0) {
+            av_freep(&graph_desc);
+            return ret;
+        }
+    }
+
     ret = fg_create(pfg, graph_desc, sch);
     if (ret < 0)
         return ret;
@@ -1241,7 +1491,9 @@ int fg_create_simple(FilterGraph **pfg,
         return AVERROR(EINVAL);
     }
 
-    ret = ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
+    ret = fg_src ?
+          ifilter_bind_fg(ifp_from_ifilter(fg->inputs[0]), fg_src, 0) :
+          ifilter_bind_ist(fg->inputs[0], ist, opts->vs);
     if (ret < 0)
         return ret;
 
@@ -1926,10 +2178,9 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
     fgt->graph = avfilter_graph_alloc();
     if (!fgt->graph)
         return AVERROR(ENOMEM);
+    fgt->graph->thread_pool = thread_pool;
 
-    if (simple) {
-        OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[0]);
-
+    if (simple || fgp->is_stage) {
         if (filter_nbthreads) {
             ret = av_opt_set(fgt->graph, "threads", filter_nbthreads, 0);
             if (ret < 0)
@@ -1939,6 +2190,12 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             if (ret < 0)
                 return ret;
         }
+    } else {
+        fgt->graph->nb_threads = filter_complex_nbthreads;
+    }
+
+    if (simple) {
+        OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[0]);
 
         if (av_dict_count(ofp->sws_opts)) {
             ret = av_dict_get_string(ofp->sws_opts,
@@ -1956,8 +2213,6 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             av_opt_set(fgt->graph, "aresample_swr_opts", args, 0);
             av_free(args);
         }
-    } else {
-        fgt->graph->nb_threads = filter_complex_nbthreads;
     }
 
     hw_device = hw_device_for_filter();
@@ -2095,6 +2350,13 @@ static int ifilter_parameters_from_frame(InputFilter *ifilter, const AVFrame *fr
 
     ifp->format              = frame->format;
 
+    // frames from a preceding pipeline stage carry the frame rate of its output
+    if (ifp->src_is_stage && frame->opaque_ref) {
+        const FrameData *fd = (const FrameData*)frame->opaque_ref->data;
+        if (fd->frame_rate_filter.num > 0 && fd->frame_rate_filter.den > 0)
+            ifp->opts.framerate = fd->frame_rate_filter;
+    }
+
     ifp->width               = frame->width;
     ifp->height              = frame->height;
     ifp->sample_aspect_ratio = frame->sample_aspect_ratio;
@@ -2444,9 +2706,33 @@ static int close_output(OutputFilterPriv *ofp, FilterGraphThread *fgt)
     FilterGraphPriv *fgp = fgp_from_fg(ofp->ofilter.graph);
     int ret;
 
-    // we are finished and no frames were ever seen at this output,
-    // at least initialize the encoder with a dummy frame
-    if (!fgt->got_frame) {
+    // the next pipeline stage expects an EOF frame carrying the timestamp
+    // at which the stream ended, before the stream itself is closed
+    if (ofp->dst_is_stage) {
+        AVFrame *frame = fgt->frame;
+        int64_t eof_pts = ofp->filter ? av_buffersink_get_eof_pts(ofp->filter) :
+                                        AV_NOPTS_VALUE;
+
+        av_frame_unref(frame);
+
+        frame->opaque    = (void*)(intptr_t)FRAME_OPAQUE_EOF;
+        frame->pts       = fgt->got_frame ? ofp->next_pts : AV_NOPTS_VALUE;
+        frame->time_base = ofp->tb_out;
+
+        // the stream may end after its last frame, e.g. after setpts
+        if (fgt->got_frame && eof_pts != AV_NOPTS_VALUE) {
+            eof_pts = av_rescale_q(eof_pts, av_buffersink_get_time_base(ofp->filter),
+                                   ofp->tb_out) -
+                      av_rescale_q(ofp->ts_offset, AV_TIME_BASE_Q, ofp->tb_out);
+            frame->pts = FFMAX(frame->pts, eof_pts);
+        }
+
+        ret = sch_filter_send(fgp->sch, fgp->sch_idx, ofp->index, frame);
+        if (ret < 0 && ret != AVERROR_EOF)
+            return ret;
+    } else if (!fgt->got_frame) {
+        // we are finished and no frames were ever seen at this output,
+        // at least initialize the encoder with a dummy frame
         AVFrame *frame = fgt->frame;
         FrameData *fd;
 
@@ -2557,7 +2843,10 @@ static int fg_output_frame(OutputFilterPriv *ofp, FilterGraphThread *fgt,
 
         if (type == AVMEDIA_TYPE_VIDEO) {
             ofp->fps.frame_number++;
-            ofp->next_pts++;
+            // the next pipeline stage is sent the end of the last frame
+            // as its EOF timestamp
+            ofp->next_pts += (ofp->dst_is_stage && frame_out->duration > 0) ?
+                             frame_out->duration : 1;
 
             if (i == nb_frames_prev && frame)
                 frame->flags &= ~AV_FRAME_FLAG_KEY;
@@ -2642,6 +2931,8 @@ static int fg_output_step(OutputFilterPriv *ofp, FilterGraphThread *fgt,
         }
 
         fd->frame_rate_filter = ofp->fps.framerate;
+        if (ofp->dst_is_stage && !fd->frame_rate_filter.num)
+            fd->frame_rate_filter = av_buffersink_get_frame_rate(filter);
     }
 
     ret = fg_output_frame(ofp, fgt, frame);
@@ -2804,7 +3095,8 @@ static int send_eof(FilterGraphThread *fgt, InputFilter *ifilter,
         if (ret < 0)
             return ret;
     } else {
-        if (ifp->format < 0) {
+        // inputs fed by a pipeline stage have no fallback parameters
+        if (ifp->format < 0 && !ifp->src_is_stage) {
             // the filtergraph was never configured, use the fallback parameters
             ifp->format                 = ifp->opts.fallback->format;
             ifp->sample_rate            = ifp->opts.fallback->sample_rate;
@@ -42,6 +42,7 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
+#include "libavutil/cpu.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
@@ -74,6 +75,9 @@ int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+int filter_pipeline_stages = 0;
+int thread_pool_size = 0;
+AVExecutor *thread_pool;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
@@ -623,6 +627,22 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_max_running_tasks(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double num;
+    int ret;
+
+    if (!strcmp(arg, "auto"))
+        return sch_max_running_tasks(go->sch, av_cpu_count());
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, 0, INT_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    return sch_max_running_tasks(go->sch, num);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1396,6 +1416,15 @@ int ffmpeg_parse_options(int argc, char **argv, Scheduler *sch)
         goto fail;
     }
 
+    if (thread_pool_size > 0) {
+        thread_pool = av_executor_alloc(NULL, thread_pool_size);
+        if (!thread_pool) {
+            ret = AVERROR(ENOMEM);
+            errmsg = "creating the thread pool";
+            goto fail;
+        }
+    }
+
     /* configure terminal and setup signal handlers */
     term_init();
 
@@ -1710,6 +1739,12 @@ const OptionDef options[] = {
     { "filter_threads",         OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_threads },
         "number of non-complex filter threads" },
+    { "filter_pipeline_stages", OPT_TYPE_INT, OPT_EXPERT,
+        { &filter_pipeline_stages },
+        "split simple filter chains into this many stages running in parallel", "number" },
+    { "thread_pool",            OPT_TYPE_INT, OPT_EXPERT,
+        { &thread_pool_size },
+        "share this many threads between the slice threading of all decoders, encoders and filtergraphs", "number" },
 #if FFMPEG_OPT_FILTER_SCRIPT
     { "filter_script",          OPT_TYPE_STRING, OPT_PERSTREAM | OPT_EXPERT | OPT_OUTPUT,
         { .off = OFFSET(filter_scripts) },
@@ -1991,6 +2026,9 @@ const OptionDef options[] = {
     { "sdp_file",   OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT | OPT_OUTPUT,
         { .func_arg = opt_sdp_file },
         "specify a file in which to print sdp information", "file" },
+    { "max_running_tasks", OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_max_running_tasks },
+        "maximum number of transcoding tasks running concurrently", "number" },
 
     { "time_base",     OPT_TYPE_STRING, OPT_EXPERT | OPT_PERSTREAM | OPT_OUTPUT,
         { .off = OFFSET(time_bases) },
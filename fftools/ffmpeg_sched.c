@@ -69,6 +69,12 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    /* run slot state of the task, only accessed from its own thread:
+     * 0 - the task does not take part in run slots or has finished,
+     * 1 - the task holds a run slot,
+     * 2 - the task gave up its run slot while waiting for another task */
+    int                 run_slot;
 } SchTask;
 
 typedef struct SchDecOutput {
@@ -311,8 +317,81 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    /* Run slots limit the number of decoders, filtergraphs and encoders
+     * that process data at the same time; 0 means no limit.
+     * See sch_max_running_tasks(). */
+    unsigned            nb_run_slots;
+    unsigned            run_slots_free;
+    uint64_t            run_slots_waits;
+    pthread_mutex_t     run_slots_lock;
+    pthread_cond_t      run_slots_cond;
+    // SchTask run by the calling thread, set if nb_run_slots is non-zero
+    pthread_key_t       run_slot_task;
 };
 
+/**
+ * Wait for a free run slot and take it for the given task.
+ */
+static void run_slot_acquire(Scheduler *sch, SchTask *task)
+{
+    pthread_mutex_lock(&sch->run_slots_lock);
+
+    if (!sch->run_slots_free)
+        sch->run_slots_waits++;
+
+    while (!sch->run_slots_free)
+        pthread_cond_wait(&sch->run_slots_cond, &sch->run_slots_lock);
+
+    sch->run_slots_free--;
+
+    pthread_mutex_unlock(&sch->run_slots_lock);
+
+    task->run_slot = 1;
+}
+
+/**
+ * Give up the run slot held by the given task. Never blocks, so it may be
+ * called with other locks held.
+ */
+static void run_slot_release(Scheduler *sch, SchTask *task, int new_state)
+{
+    pthread_mutex_lock(&sch->run_slots_lock);
+
+    av_assert0(sch->run_slots_free < sch->nb_run_slots);
+    sch->run_slots_free++;
+    pthread_cond_signal(&sch->run_slots_cond);
+
+    pthread_mutex_unlock(&sch->run_slots_lock);
+
+    task->run_slot = new_state;
+}
+
+/**
+ * Must be called by a thread right before it goes to sleep waiting for
+ * another task (waiting=1, possibly with locks held) and once it was woken
+ * up (waiting=0, with no locks held). A task that holds a run slot gives it
+ * up for the duration of the wait, so that a task blocked on its input or
+ * output never prevents other tasks from running.
+ */
+static void run_slot_wait(void *opaque, int waiting)
+{
+    Scheduler *sch = opaque;
+    SchTask  *task;
+
+    if (!sch->nb_run_slots)
+        return;
+
+    task = pthread_getspecific(sch->run_slot_task);
+    if (!task)
+        return;
+
+    if (waiting && task->run_slot == 1)
+        run_slot_release(sch, task, 2);
+    else if (!waiting && task->run_slot == 2)
+        run_slot_acquire(sch, task);
+}
+
 /**
  * Wait until this task is allowed to proceed.
  *
@@ -321,20 +400,26 @@ struct Scheduler {
  */
 static int waiter_wait(Scheduler *sch, SchWaiter *w)
 {
-    int terminate;
+    int terminate, waited = 0;
 
     if (!atomic_load(&w->choked))
         return 0;
 
     pthread_mutex_lock(&w->lock);
 
-    while (atomic_load(&w->choked) && !atomic_load(&sch->terminate))
+    while (atomic_load(&w->choked) && !atomic_load(&sch->terminate)) {
+        if (!waited++)
+            run_slot_wait(sch, 1);
         pthread_cond_wait(&w->cond, &w->lock);
+    }
 
     terminate = atomic_load(&sch->terminate);
 
     pthread_mutex_unlock(&w->lock);
 
+    if (waited)
+        run_slot_wait(sch, 0);
+
     return terminate;
 }
 
@@ -371,8 +456,9 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
-static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
-                       enum QueueType type)
+static int queue_alloc(Scheduler *sch, ThreadQueue **ptq,
+                       unsigned nb_streams, unsigned queue_size,
+                       enum QueueType type, unsigned flags)
 {
     ThreadQueue *tq;
 
@@ -393,10 +479,13 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     }
 
     tq = tq_alloc(nb_streams, queue_size,
-                  (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES);
+                  (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES,
+                  flags);
     if (!tq)
         return AVERROR(ENOMEM);
 
+    tq_set_wait_cb(tq, run_slot_wait, sch);
+
     *ptq = tq;
     return 0;
 }
@@ -566,6 +655,11 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->finish_lock);
     pthread_cond_destroy(&sch->finish_cond);
 
+    pthread_mutex_destroy(&sch->run_slots_lock);
+    pthread_cond_destroy(&sch->run_slots_cond);
+    if (sch->nb_run_slots)
+        pthread_key_delete(sch->run_slot_task);
+
     av_freep(psch);
 }
 
@@ -602,6 +696,14 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->run_slots_lock, NULL);
+    if (ret)
+        goto fail;
+
+    ret = pthread_cond_init(&sch->run_slots_cond, NULL);
+    if (ret)
+        goto fail;
+
     return sch;
 fail:
     sch_free(&sch);
@@ -615,6 +717,26 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+int sch_max_running_tasks(Scheduler *sch, unsigned nb_tasks)
+{
+    int ret;
+
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    if (!sch->nb_run_slots && nb_tasks) {
+        ret = pthread_key_create(&sch->run_slot_task, NULL);
+        if (ret)
+            return AVERROR(ret);
+    } else if (sch->nb_run_slots && !nb_tasks) {
+        pthread_key_delete(sch->run_slot_task);
+    }
+
+    sch->nb_run_slots   = nb_tasks;
+    sch->run_slots_free = nb_tasks;
+
+    return 0;
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -761,10 +883,6 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
-    if (ret < 0)
-        return ret;
-
     if (send_end_ts) {
         ret = av_thread_message_queue_alloc(&dec->queue_end_ts, 1, sizeof(Timestamp));
         if (ret < 0)
@@ -805,7 +923,9 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!enc->send_pkt)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
+    // encoder input is sent either by its single source, or under the
+    // sync queue lock
+    ret = queue_alloc(sch, &enc->queue, 1, 0, QUEUE_FRAMES, THREAD_QUEUE_FLAG_SPSC);
     if (ret < 0)
         return ret;
 
@@ -853,7 +973,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(sch, &fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES, 0);
     if (ret < 0)
         return ret;
 
@@ -1443,6 +1563,23 @@ fail:
     return ret;
 }
 
+static int dec_is_heartbeat_dst(const Scheduler *sch, unsigned dec_idx)
+{
+    for (unsigned i = 0; i < sch->nb_mux; i++) {
+        const SchMux *mux = &sch->mux[i];
+
+        for (unsigned j = 0; j < mux->nb_streams; j++) {
+            const SchMuxStream *ms = &mux->streams[j];
+
+            for (unsigned k = 0; k < ms->nb_sub_heartbeat_dst; k++)
+                if (ms->sub_heartbeat_dst[k] == dec_idx)
+                    return 1;
+        }
+    }
+
+    return 0;
+}
+
 static int start_prepare(Scheduler *sch)
 {
     int ret;
@@ -1487,6 +1624,13 @@ static int start_prepare(Scheduler *sch)
             if (!o->dst_finished)
                 return AVERROR(ENOMEM);
         }
+
+        // subtitle heartbeats are sent from muxer threads, concurrently with
+        // the decoder's own source
+        ret = queue_alloc(sch, &dec->queue, 1, 0, QUEUE_PACKETS,
+                          dec_is_heartbeat_dst(sch, i) ? 0 : THREAD_QUEUE_FLAG_SPSC);
+        if (ret < 0)
+            return ret;
     }
 
     for (unsigned i = 0; i < sch->nb_enc; i++) {
@@ -1536,8 +1680,11 @@ static int start_prepare(Scheduler *sch)
             }
         }
 
-        ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
-                          QUEUE_PACKETS);
+        // with a single stream, all packets come from one source; the
+        // pre-muxing queue flush is serialized with it by mux_ready_lock
+        ret = queue_alloc(sch, &mux->queue, mux->nb_streams, mux->queue_size,
+                          QUEUE_PACKETS,
+                          mux->nb_streams == 1 ? THREAD_QUEUE_FLAG_SPSC : 0);
         if (ret < 0)
             return ret;
     }
@@ -2531,7 +2678,18 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    if (sch->nb_run_slots) {
+        pthread_setspecific(sch->run_slot_task, task);
+        // demuxers and muxers spend their time in I/O, so they run freely
+        if (task->node.type != SCH_NODE_TYPE_DEMUX &&
+            task->node.type != SCH_NODE_TYPE_MUX)
+            run_slot_acquire(sch, task);
+    }
+
     ret = task->func(task->func_arg);
+
+    if (task->run_slot == 1)
+        run_slot_release(sch, task, 0);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
@@ -2625,6 +2783,10 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
     if (finish_ts)
         *finish_ts = trailing_dts(sch, 1);
 
+    if (sch->nb_run_slots)
+        av_log(sch, AV_LOG_VERBOSE, "Tasks waited for one of %u run slots "
+               "%"PRIu64" times\n", sch->nb_run_slots, sch->run_slots_waits);
+
     sch->state = SCH_STATE_STOPPED;
 
     return ret;
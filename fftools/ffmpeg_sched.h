@@ -298,6 +298,22 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Limit the number of decoders, filtergraphs and encoders that may be
+ * processing data at the same time.
+ *
+ * Every component still runs in its own thread. A decoder, filtergraph or
+ * encoder takes a run slot when its thread starts and keeps it until the
+ * thread finishes, except while it sleeps waiting for another component
+ * (for input, for downstream to consume its output, or to be unchoked).
+ * Demuxers and muxers do not take run slots, since they mostly block in I/O.
+ *
+ * Must be called before sch_start().
+ *
+ * @param nb_tasks Maximum number of running tasks, 0 means no limit.
+ */
+int sch_max_running_tasks(Scheduler *sch, unsigned nb_tasks);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -37,17 +39,41 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+typedef struct RingItem {
+    // AVFrame or AVPacket, depending on ThreadQueue.type
+    void           *data;
+    unsigned        stream_idx;
+} RingItem;
+
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
     enum ThreadQueueType type;
 
+    // used for queues that may have multiple concurrent senders,
+    // all accesses are protected by lock
     AVContainerFifo *fifo;
     AVFifo          *fifo_stream_index;
 
+    /* Lock-free ring used with THREAD_QUEUE_FLAG_SPSC. ring_write is only
+     * modified by the sender and ring_read only by the receiver; lock and cond
+     * are only used for sleeping when the ring is full or empty.
+     * The ring has a power-of-two number of items, of which at most
+     * ring_capacity may be used at any time. */
+    RingItem         *ring;
+    unsigned        ring_mask;
+    unsigned        ring_capacity;
+    atomic_uint     ring_write;
+    atomic_uint     ring_read;
+    atomic_int      send_waiting;
+    atomic_int      recv_waiting;
+
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    void          (*wait_cb)(void *opaque, int waiting);
+    void           *wait_opaque;
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -60,6 +86,16 @@ void tq_free(ThreadQueue **ptq)
     av_container_fifo_free(&tq->fifo);
     av_fifo_freep2(&tq->fifo_stream_index);
 
+    if (tq->ring) {
+        for (unsigned i = 0; i <= tq->ring_mask; i++) {
+            if (tq->type == THREAD_QUEUE_FRAMES)
+                av_frame_free((AVFrame**)&tq->ring[i].data);
+            else
+                av_packet_free((AVPacket**)&tq->ring[i].data);
+        }
+        av_freep(&tq->ring);
+    }
+
     av_freep(&tq->finished);
 
     pthread_cond_destroy(&tq->cond);
@@ -68,8 +104,39 @@ void tq_free(ThreadQueue **ptq)
     av_freep(ptq);
 }
 
+static int ring_alloc(ThreadQueue *tq, size_t queue_size)
+{
+    size_t ring_size = 1;
+
+    if (queue_size > UINT_MAX / 2)
+        return AVERROR(EINVAL);
+
+    while (ring_size < queue_size)
+        ring_size <<= 1;
+
+    tq->ring = av_calloc(ring_size, sizeof(*tq->ring));
+    if (!tq->ring)
+        return AVERROR(ENOMEM);
+    tq->ring_mask     = ring_size - 1;
+    tq->ring_capacity = queue_size;
+
+    for (size_t i = 0; i < ring_size; i++) {
+        tq->ring[i].data = (tq->type == THREAD_QUEUE_FRAMES) ?
+                           (void*)av_frame_alloc() : (void*)av_packet_alloc();
+        if (!tq->ring[i].data)
+            return AVERROR(ENOMEM);
+    }
+
+    atomic_init(&tq->ring_write,   0);
+    atomic_init(&tq->ring_read,    0);
+    atomic_init(&tq->send_waiting, 0);
+    atomic_init(&tq->recv_waiting, 0);
+
+    return 0;
+}
+
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      enum ThreadQueueType type)
+                      enum ThreadQueueType type, unsigned flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -94,10 +161,18 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
     tq->nb_streams = nb_streams;
 
     tq->type = type;
 
+    if (flags & THREAD_QUEUE_FLAG_SPSC) {
+        if (ring_alloc(tq, queue_size) < 0)
+            goto fail;
+        return tq;
+    }
+
     tq->fifo = (type == THREAD_QUEUE_FRAMES) ?
                av_container_fifo_alloc_avframe(0) : av_container_fifo_alloc_avpacket(0);
     if (!tq->fifo)
@@ -113,27 +188,121 @@ fail:
     return NULL;
 }
 
+void tq_set_wait_cb(ThreadQueue *tq, void (*wait_cb)(void *opaque, int waiting),
+                    void *opaque)
+{
+    tq->wait_cb     = wait_cb;
+    tq->wait_opaque = opaque;
+}
+
+static void wait_start(ThreadQueue *tq, int *waited)
+{
+    if (!*waited && tq->wait_cb)
+        tq->wait_cb(tq->wait_opaque, 1);
+    *waited = 1;
+}
+
+static void wait_end(ThreadQueue *tq, int waited)
+{
+    if (waited && tq->wait_cb)
+        tq->wait_cb(tq->wait_opaque, 0);
+}
+
+static void item_move(const ThreadQueue *tq, void *dst, void *src)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_move_ref(dst, src);
+    else
+        av_packet_move_ref(dst, src);
+}
+
+static void wake_locked(ThreadQueue *tq)
+{
+    pthread_mutex_lock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+static int ring_full(ThreadQueue *tq, unsigned wpos)
+{
+    return wpos - (unsigned)atomic_load(&tq->ring_read) >= tq->ring_capacity;
+}
+
+static int send_ring(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    unsigned        wpos = atomic_load_explicit(&tq->ring_write,
+                                                memory_order_relaxed);
+    RingItem       *item;
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    if (ring_full(tq, wpos) && !(atomic_load(finished) & FINISHED_RECV)) {
+        int waited = 0;
+
+        pthread_mutex_lock(&tq->lock);
+
+        // the receiver clears this flag and wakes us after consuming an item,
+        // so we must re-check the ring state after setting it
+        while (1) {
+            atomic_store(&tq->send_waiting, 1);
+            if (!ring_full(tq, wpos) || (atomic_load(finished) & FINISHED_RECV))
+                break;
+            wait_start(tq, &waited);
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        }
+        atomic_store(&tq->send_waiting, 0);
+
+        pthread_mutex_unlock(&tq->lock);
+
+        wait_end(tq, waited);
+    }
+
+    if (atomic_load(finished) & FINISHED_RECV) {
+        atomic_fetch_or(finished, FINISHED_SEND);
+        return AVERROR_EOF;
+    }
+
+    item = &tq->ring[wpos & tq->ring_mask];
+    item->stream_idx = stream_idx;
+    item_move(tq, item->data, data);
+
+    atomic_store(&tq->ring_write, wpos + 1);
+
+    if (atomic_exchange(&tq->recv_waiting, 0))
+        wake_locked(tq);
+
+    return 0;
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
-    int *finished;
-    int ret;
+    atomic_int *finished;
+    int ret, waited = 0;
 
     av_assert0(stream_idx < tq->nb_streams);
     finished = &tq->finished[stream_idx];
 
+    if (tq->ring)
+        return send_ring(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
-    if (*finished & FINISHED_SEND) {
+    if (atomic_load(finished) & FINISHED_SEND) {
         ret = AVERROR(EINVAL);
         goto finish;
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo_stream_index))
+    while (!(atomic_load(finished) & FINISHED_RECV) &&
+           !av_fifo_can_write(tq->fifo_stream_index)) {
+        wait_start(tq, &waited);
         pthread_cond_wait(&tq->cond, &tq->lock);
+    }
 
-    if (*finished & FINISHED_RECV) {
+    if (atomic_load(finished) & FINISHED_RECV) {
         ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
+        atomic_fetch_or(finished, FINISHED_SEND);
     } else {
         ret = av_fifo_write(tq->fifo_stream_index, &stream_idx, 1);
         if (ret < 0)
@@ -149,6 +318,8 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 finish:
     pthread_mutex_unlock(&tq->lock);
 
+    wait_end(tq, waited);
+
     return ret;
 }
 
@@ -163,7 +334,7 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
 
         ret = av_fifo_read(tq->fifo_stream_index, &idx, 1);
         av_assert0(ret >= 0);
-        if (tq->finished[idx] & FINISHED_RECV) {
+        if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
             (tq->type == THREAD_QUEUE_FRAMES) ?
             av_frame_unref(data) : av_packet_unref(data);
             continue;
@@ -174,12 +345,14 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     }
 
     for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!tq->finished[i])
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
             continue;
 
         /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
+        if (!(finished & FINISHED_RECV)) {
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
             *stream_idx   = i;
             return AVERROR_EOF;
         }
@@ -190,12 +363,99 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
+// whether the sender finished some stream and the receiver was not told yet
+static int eof_pending(ThreadQueue *tq)
+{
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        if (atomic_load(&tq->finished[i]) == FINISHED_SEND)
+            return 1;
+    return 0;
+}
+
+static int receive_ring(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    unsigned rpos = atomic_load_explicit(&tq->ring_read, memory_order_relaxed);
+    int    waited = 0;
+
+    while (1) {
+        unsigned nb_finished = 0;
+        int      eof_idx     = -1;
+
+        if (rpos != atomic_load(&tq->ring_write)) {
+            RingItem *item = &tq->ring[rpos & tq->ring_mask];
+            unsigned  idx  = item->stream_idx;
+
+            item_move(tq, data, item->data);
+
+            atomic_store(&tq->ring_read, ++rpos);
+
+            if (atomic_exchange(&tq->send_waiting, 0))
+                wake_locked(tq);
+
+            if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
+                (tq->type == THREAD_QUEUE_FRAMES) ?
+                av_frame_unref(data) : av_packet_unref(data);
+                continue;
+            }
+
+            *stream_idx = idx;
+            return 0;
+        }
+
+        for (unsigned int i = 0; i < tq->nb_streams; i++) {
+            int finished = atomic_load(&tq->finished[i]);
+
+            if (finished & FINISHED_RECV)
+                nb_finished++;
+            else if (finished && eof_idx < 0)
+                eof_idx = i;
+        }
+
+        // The sender marks a stream as finished only after writing all of
+        // its items, so EOF may only be returned if the ring is still empty
+        // after reading the flags.
+        if (rpos != atomic_load(&tq->ring_write))
+            continue;
+
+        /* return EOF to the consumer at most once for each stream */
+        if (eof_idx >= 0) {
+            atomic_fetch_or(&tq->finished[eof_idx], FINISHED_RECV);
+            *stream_idx = eof_idx;
+            return AVERROR_EOF;
+        }
+
+        if (nb_finished == tq->nb_streams)
+            return AVERROR_EOF;
+
+        pthread_mutex_lock(&tq->lock);
+
+        // the sender clears this flag and wakes us after writing an item,
+        // so we must re-check the ring state after setting it
+        while (1) {
+            atomic_store(&tq->recv_waiting, 1);
+            if (rpos != atomic_load(&tq->ring_write) || eof_pending(tq))
+                break;
+            wait_start(tq, &waited);
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        }
+        atomic_store(&tq->recv_waiting, 0);
+
+        pthread_mutex_unlock(&tq->lock);
+
+        wait_end(tq, waited);
+        waited = 0;
+    }
+}
+
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 {
-    int ret;
+    int ret, waited = 0;
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return receive_ring(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -208,6 +468,7 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
             pthread_cond_broadcast(&tq->cond);
 
         if (ret == AVERROR(EAGAIN)) {
+            wait_start(tq, &waited);
             pthread_cond_wait(&tq->cond, &tq->lock);
             continue;
         }
@@ -217,6 +478,8 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     pthread_mutex_unlock(&tq->lock);
 
+    wait_end(tq, waited);
+
     return ret;
 }
 
@@ -229,7 +492,7 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -244,7 +507,7 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -26,6 +26,16 @@ enum ThreadQueueType {
     THREAD_QUEUE_PACKETS,
 };
 
+enum ThreadQueueFlags {
+    /**
+     * The queue is only ever sent to from one thread at a time and received
+     * from by one thread. Sends from different threads are allowed, as long
+     * as the caller serializes them (e.g. by a mutex). This allows the queue
+     * to transfer items without locking.
+     */
+    THREAD_QUEUE_FLAG_SPSC = (1 << 0),
+};
+
 typedef struct ThreadQueue ThreadQueue;
 
 /**
@@ -35,11 +45,22 @@ typedef struct ThreadQueue ThreadQueue;
  *                   maintained
  * @param queue_size number of items that can be stored in the queue without
  *                   blocking
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      enum ThreadQueueType type);
+                      enum ThreadQueueType type, unsigned flags);
 void         tq_free(ThreadQueue **tq);
 
+/**
+ * Set a callback that is invoked by a thread calling tq_send() or
+ * tq_receive() whenever that thread has to wait for the other side of the
+ * queue: with waiting=1 before going to sleep, possibly with the queue
+ * locked, and with waiting=0 once it was woken up and the queue was unlocked.
+ * The callback must not block when called with waiting=1.
+ */
+void tq_set_wait_cb(ThreadQueue *tq, void (*wait_cb)(void *opaque, int waiting),
+                    void *opaque);
+
 /**
  * Send an item for the given stream to the queue.
  *
@@ -821,19 +821,241 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * State of the frame being coded shared by the channel jobs.
+ */
+typedef struct AACEncFrameData {
+    const AVFrame *frame;
+    FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    int bitres_alloc[AAC_MAX_CHANNELS];          ///< psy bit allocation of each channel
+    uint8_t quantized[AAC_MAX_CHANNELS];         ///< channels quantized ahead of the parallel pass
+} AACEncFrameData;
+
+/**
+ * Find the element coding a channel.
+ * @return the element, with its type in *tag and the position of the
+ *         channel in it in *idx
+ */
+static ChannelElement *channel_element(const AACEncContext *s, int ch,
+                                       int *tag, int *idx)
+{
+    int i, start_ch = 0;
+
+    for (i = 0; i < s->chan_map[0]; i++) {
+        int chans = s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+        if (ch < start_ch + chans)
+            break;
+        start_ch += chans;
+    }
+    *tag = s->chan_map[i+1];
+    *idx = ch - start_ch;
+    return &s->cpe[i];
+}
+
+/**
+ * Decide the window of a channel, evaluate its clipping risk and transform it.
+ */
+static int window_channel_job(AVCodecContext *avctx, void *arg,
+                              int channel, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *cs = s->ch_ctx[channel];
+    AACEncFrameData *fd = arg;
+    FFPsyWindowInfo *wi = &fd->windows[channel];
+    float *samples2, *la, *overlap;
+    float clip_avoidance_factor;
+    ChannelElement *cpe;
+    SingleChannelElement *sce;
+    IndividualChannelStream *ics;
+    int tag, ch, w, k;
+
+    cpe = channel_element(s, channel, &tag, &ch);
+    sce = &cpe->ch[ch];
+    ics = &sce->ics;
+    overlap  = &s->planar_samples[channel][0];
+    samples2 = overlap + 1024;
+    la       = samples2 + (448+64);
+    if (!fd->frame)
+        la = NULL;
+    if (tag == TYPE_LFE) {
+        wi->window_type[0] = wi->window_type[1] = ONLY_LONG_SEQUENCE;
+        wi->window_shape   = 0;
+        wi->num_windows    = 1;
+        wi->grouping[0]    = 1;
+        wi->clipping[0]    = 0;
+
+        /* Only the lowest 12 coefficients are used in a LFE channel.
+         * The expression below results in only the bottom 8 coefficients
+         * being used for 11.025kHz to 16kHz sample rates.
+         */
+        ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
+    } else {
+        *wi = s->psy.model->window(&s->psy, samples2, la, channel,
+                                   ics->window_sequence[0]);
+    }
+    ics->window_sequence[1] = ics->window_sequence[0];
+    ics->window_sequence[0] = wi->window_type[0];
+    ics->use_kb_window[1]   = ics->use_kb_window[0];
+    ics->use_kb_window[0]   = wi->window_shape;
+    ics->num_windows        = wi->num_windows;
+    ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
+    ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
+    ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
+    ics->swb_offset         = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_swb_offset_128 [s->samplerate_index]:
+                                ff_swb_offset_1024[s->samplerate_index];
+    ics->tns_max_bands      = wi->window_type[0] == EIGHT_SHORT_SEQUENCE ?
+                                ff_tns_max_bands_128 [s->samplerate_index]:
+                                ff_tns_max_bands_1024[s->samplerate_index];
+
+    for (w = 0; w < ics->num_windows; w++)
+        ics->group_len[w] = wi->grouping[w];
+
+    /* Calculate input sample maximums and evaluate clipping risk */
+    clip_avoidance_factor = 0.0f;
+    for (w = 0; w < ics->num_windows; w++) {
+        const float *wbuf = overlap + w * 128;
+        const int wlen = 2048 / ics->num_windows;
+        float max = 0;
+        int j;
+        /* mdct input is 2 * output */
+        for (j = 0; j < wlen; j++)
+            max = FFMAX(max, fabsf(wbuf[j]));
+        wi->clipping[w] = max;
+    }
+    for (w = 0; w < ics->num_windows; w++) {
+        if (wi->clipping[w] > CLIP_AVOIDANCE_FACTOR) {
+            ics->window_clipping[w] = 1;
+            clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi->clipping[w]);
+        } else {
+            ics->window_clipping[w] = 0;
+        }
+    }
+    if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
+        ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
+    } else {
+        ics->clip_avoidance_factor = 1.0f;
+    }
+
+    apply_window_and_mdct(cs, sce, overlap);
+
+    for (k = 0; k < 1024; k++) {
+        if (!(fabs(sce->coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
+            av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
+            return AVERROR(EINVAL);
+        }
+    }
+    avoid_clipping(cs, sce);
+
+    return 0;
+}
+
+/**
+ * Search the scalefactors and codebooks of a channel.
+ */
+static int quantize_channel_job(AVCodecContext *avctx, void *arg,
+                                int channel, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *cs = s->ch_ctx[channel];
+    AACEncFrameData *fd = arg;
+    ChannelElement *cpe;
+    SingleChannelElement *sce;
+    int tag, ch;
+
+    if (fd->quantized[channel])
+        return 0;
+
+    cpe = channel_element(s, channel, &tag, &ch);
+    sce = &cpe->ch[ch];
+
+    cs->cur_channel      = channel;
+    cs->cur_type         = tag;
+    cs->lambda           = s->lambda;
+    cs->psy.bitres.alloc = fd->bitres_alloc[channel];
+    if (s->options.pns && s->coder->mark_pns)
+        s->coder->mark_pns(cs, avctx, sce);
+    s->coder->search_for_quantizers(avctx, cs, sce, s->lambda);
+
+    return 0;
+}
+
+/**
+ * Apply TNS to a channel.
+ */
+static int tns_channel_job(AVCodecContext *avctx, void *arg,
+                               int channel, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *cs = s->ch_ctx[channel];
+    ChannelElement *cpe;
+    SingleChannelElement *sce;
+    int tag, ch;
+
+    cpe = channel_element(s, channel, &tag, &ch);
+    sce = &cpe->ch[ch];
+
+    cs->cur_channel = channel;
+    if (s->options.tns && s->coder->search_for_tns)
+        s->coder->search_for_tns(cs, sce);
+    if (s->options.tns && s->coder->apply_tns_filt)
+        s->coder->apply_tns_filt(cs, sce);
+
+    return 0;
+}
+
+/**
+ * Apply intensity and mid/side stereo to an element.
+ */
+static int stereo_element_job(AVCodecContext *avctx, void *arg,
+                              int el, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    ChannelElement *cpe = &s->cpe[el];
+    AACEncContext *es;
+    int i, start_ch = 0;
+
+    for (i = 0; i < el; i++)
+        start_ch += s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+    es = s->ch_ctx[start_ch];
+
+    es->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(es, avctx, cpe);
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(es, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, s->chan_map[el+1] == TYPE_CPE ? 2 : 1);
+
+    return 0;
+}
+
+/**
+ * Encode a frame. The psychoacoustic analysis of all the elements is done
+ * ahead of their quantization, then the channels, or the elements for the
+ * stereo tools, are coded in parallel with slice threads, and the elements
+ * written in order. The PNS search draws from a single noise generator and
+ * runs in channel order, so the output does not depend on the threads.
+ */
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
     AACEncContext *s = avctx->priv_data;
-    float **samples = s->planar_samples, *samples2, *la, *overlap;
+    AACEncFrameData fd = { .frame = frame };
     ChannelElement *cpe;
     SingleChannelElement *sce;
-    IndividualChannelStream *ics;
-    int i, its, ch, w, chans, tag, start_ch, ret, frame_bits;
+    int i, its, ch, idx, w, chans, tag, start_ch, ret, frame_bits;
     int target_bits, rate_bits, too_many_bits, too_few_bits;
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
-    FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    int ch_ret[AAC_MAX_CHANNELS];
 
     /* add current frame to queue */
     if (frame) {
@@ -851,95 +1073,11 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     if (!avctx->frame_num)
         return 0;
 
-    start_ch = 0;
-    for (i = 0; i < s->chan_map[0]; i++) {
-        FFPsyWindowInfo* wi = windows + start_ch;
-        tag      = s->chan_map[i+1];
-        chans    = tag == TYPE_CPE ? 2 : 1;
-        cpe      = &s->cpe[i];
-        for (ch = 0; ch < chans; ch++) {
-            int k;
-            float clip_avoidance_factor;
-            sce = &cpe->ch[ch];
-            ics = &sce->ics;
-            s->cur_channel = start_ch + ch;
-            overlap  = &samples[s->cur_channel][0];
-            samples2 = overlap + 1024;
-            la       = samples2 + (448+64);
-            if (!frame)
-                la = NULL;
-            if (tag == TYPE_LFE) {
-                wi[ch].window_type[0] = wi[ch].window_type[1] = ONLY_LONG_SEQUENCE;
-                wi[ch].window_shape   = 0;
-                wi[ch].num_windows    = 1;
-                wi[ch].grouping[0]    = 1;
-                wi[ch].clipping[0]    = 0;
-
-                /* Only the lowest 12 coefficients are used in a LFE channel.
-                 * The expression below results in only the bottom 8 coefficients
-                 * being used for 11.025kHz to 16kHz sample rates.
-                 */
-                ics->num_swb = s->samplerate_index >= 8 ? 1 : 3;
-            } else {
-                wi[ch] = s->psy.model->window(&s->psy, samples2, la, s->cur_channel,
-                                              ics->window_sequence[0]);
-            }
-            ics->window_sequence[1] = ics->window_sequence[0];
-            ics->window_sequence[0] = wi[ch].window_type[0];
-            ics->use_kb_window[1]   = ics->use_kb_window[0];
-            ics->use_kb_window[0]   = wi[ch].window_shape;
-            ics->num_windows        = wi[ch].num_windows;
-            ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
-            ics->num_swb            = tag == TYPE_LFE ? ics->num_swb : s->psy.num_bands[ics->num_windows == 8];
-            ics->max_sfb            = FFMIN(ics->max_sfb, ics->num_swb);
-            ics->swb_offset         = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_swb_offset_128 [s->samplerate_index]:
-                                        ff_swb_offset_1024[s->samplerate_index];
-            ics->tns_max_bands      = wi[ch].window_type[0] == EIGHT_SHORT_SEQUENCE ?
-                                        ff_tns_max_bands_128 [s->samplerate_index]:
-                                        ff_tns_max_bands_1024[s->samplerate_index];
-
-            for (w = 0; w < ics->num_windows; w++)
-                ics->group_len[w] = wi[ch].grouping[w];
-
-            /* Calculate input sample maximums and evaluate clipping risk */
-            clip_avoidance_factor = 0.0f;
-            for (w = 0; w < ics->num_windows; w++) {
-                const float *wbuf = overlap + w * 128;
-                const int wlen = 2048 / ics->num_windows;
-                float max = 0;
-                int j;
-                /* mdct input is 2 * output */
-                for (j = 0; j < wlen; j++)
-                    max = FFMAX(max, fabsf(wbuf[j]));
-                wi[ch].clipping[w] = max;
-            }
-            for (w = 0; w < ics->num_windows; w++) {
-                if (wi[ch].clipping[w] > CLIP_AVOIDANCE_FACTOR) {
-                    ics->window_clipping[w] = 1;
-                    clip_avoidance_factor = FFMAX(clip_avoidance_factor, wi[ch].clipping[w]);
-                } else {
-                    ics->window_clipping[w] = 0;
-                }
-            }
-            if (clip_avoidance_factor > CLIP_AVOIDANCE_FACTOR) {
-                ics->clip_avoidance_factor = CLIP_AVOIDANCE_FACTOR / clip_avoidance_factor;
-            } else {
-                ics->clip_avoidance_factor = 1.0f;
-            }
+    avctx->execute2(avctx, window_channel_job, &fd, ch_ret, s->channels);
+    for (ch = 0; ch < s->channels; ch++)
+        if (ch_ret[ch] < 0)
+            return ch_ret[ch];
 
-            apply_window_and_mdct(s, sce, overlap);
-
-            for (k = 0; k < 1024; k++) {
-                if (!(fabs(cpe->ch[ch].coeffs[k]) < 1E16)) { // Ensure headroom for energy calculation
-                    av_log(avctx, AV_LOG_ERROR, "Input contains (near) NaN/+-Inf\n");
-                    return AVERROR(EINVAL);
-                }
-            }
-            avoid_clipping(s, sce);
-        }
-        start_ch += chans;
-    }
     if ((ret = ff_alloc_packet(avctx, avpkt, 8192 * s->channels)) < 0)
         return ret;
     frame_bits = its = 0;
@@ -950,9 +1088,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        memset(fd.quantized, 0, sizeof(fd.quantized));
         for (i = 0; i < s->chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
+            FFPsyWindowInfo* wi = fd.windows + start_ch;
             const float *coeffs[2];
             tag      = s->chan_map[i+1];
             chans    = tag == TYPE_CPE ? 2 : 1;
@@ -960,8 +1098,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -979,12 +1115,16 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+            for (ch = 0; ch < chans; ch++)
+                fd.bitres_alloc[start_ch + ch] = s->psy.bitres.alloc;
+            /* The two-loop coder sets the bandwidth of the analysis the first
+             * time it runs, quantize the element before analyzing the next
+             * ones until then. */
+            if (!s->psy.cutoff && s->options.coder == AAC_CODER_TWOLOOP) {
+                for (ch = 0; ch < chans; ch++) {
+                    quantize_channel_job(avctx, &fd, start_ch + ch, 0);
+                    fd.quantized[start_ch + ch] = 1;
+                }
             }
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
@@ -998,33 +1138,31 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     }
                 }
             }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
+            start_ch += chans;
+        }
+
+        avctx->execute2(avctx, quantize_channel_job, &fd, NULL, s->channels);
+        avctx->execute2(avctx, tns_channel_job,      &fd, NULL, s->channels);
+        for (ch = 0; ch < s->channels; ch++) {
+            cpe = channel_element(s, ch, &tag, &idx);
+            sce = &cpe->ch[idx];
+            if (sce->tns.present)
+                tns_mode = 1;
+            s->cur_channel = ch;
+            if (s->options.pns && s->coder->search_for_pns)
+                s->coder->search_for_pns(s, avctx, sce);
+        }
+        avctx->execute2(avctx, stereo_element_job, &fd, NULL, s->chan_map[0]);
+
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            if (s->options.intensity_stereo && cpe->is_mode)
+                is_mode = 1;
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans == 2) {
                 put_bits(&s->pb, 1, cpe->common_window);
                 if (cpe->common_window) {
@@ -1033,11 +1171,8 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     if (cpe->ms_mode) ms_mode = 1;
                 }
             }
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
+            for (ch = 0; ch < chans; ch++)
                 encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
-            }
-            start_ch += chans;
         }
 
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
@@ -1137,6 +1272,18 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
+    for (int ch = 1; s->ch_ctx && ch < s->channels; ch++) {
+        AACEncContext *cs = s->ch_ctx[ch];
+
+        if (!cs || cs == s)
+            continue;
+        av_tx_uninit(&cs->mdct1024);
+        av_tx_uninit(&cs->mdct128);
+        ff_lpc_end(&cs->lpc);
+        av_freep(&s->ch_ctx[ch]);
+    }
+    av_freep(&s->ch_ctx);
+
     av_tx_uninit(&s->mdct1024);
     av_tx_uninit(&s->mdct128);
     ff_psy_end(&s->psy);
@@ -1150,15 +1297,11 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     return 0;
 }
 
-static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
+static av_cold int mdct_init(AACEncContext *s)
 {
     int ret = 0;
     float scale = 32768.0f;
 
-    s->fdsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
-    if (!s->fdsp)
-        return AVERROR(ENOMEM);
-
     if ((ret = av_tx_init(&s->mdct1024, &s->mdct1024_fn, AV_TX_FLOAT_MDCT, 0,
                           1024, &scale, 0)) < 0)
         return ret;
@@ -1169,6 +1312,53 @@ static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
     return 0;
 }
 
+static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
+{
+    s->fdsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
+    return mdct_init(s);
+}
+
+/**
+ * Set up the contexts coding each channel. With slice threads, every channel
+ * but the first one gets its own copy of the context, whatever the number of
+ * threads, so that the output does not depend on it.
+ */
+static av_cold int alloc_channel_contexts(AVCodecContext *avctx, AACEncContext *s)
+{
+    int ch, ret;
+
+    if (!FF_ALLOCZ_TYPED_ARRAY(s->ch_ctx, s->channels))
+        return AVERROR(ENOMEM);
+
+    s->ch_ctx[0] = s;
+    for (ch = 1; ch < s->channels; ch++) {
+        AACEncContext *cs;
+
+        if (!(avctx->active_thread_type & FF_THREAD_SLICE)) {
+            s->ch_ctx[ch] = s;
+            continue;
+        }
+
+        cs = av_memdup(s, sizeof(*s));
+        if (!cs)
+            return AVERROR(ENOMEM);
+        s->ch_ctx[ch] = cs;
+        cs->mdct1024 = cs->mdct128 = NULL;
+        memset(&cs->lpc, 0, sizeof(cs->lpc));
+
+        if ((ret = mdct_init(cs)) < 0)
+            return ret;
+        if ((ret = ff_lpc_init(&cs->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
 {
     int ch;
@@ -1303,6 +1493,9 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
+    if ((ret = alloc_channel_contexts(avctx, s)) < 0)
+        return ret;
+
     return 0;
 }
 
@@ -1338,7 +1531,8 @@ const FFCodec ff_aac_encoder = {
     .p.type         = AVMEDIA_TYPE_AUDIO,
     .p.id           = AV_CODEC_ID_AAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(AACEncContext),
     .init           = aac_encode_init,
     FF_CODEC_ENCODE_CB(aac_encode_frame),
@@ -221,6 +221,13 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    /**
+     * Contexts used to code each channel, copies of this context with their
+     * own transforms and scratch buffers when the channels are coded in
+     * parallel, else this context itself.
+     */
+    struct AACEncContext **ch_ctx;
 } AACEncContext;
 
 void ff_quantize_band_cost_cache_init(struct AACEncContext *s);
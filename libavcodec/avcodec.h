@@ -1923,6 +1923,22 @@ typedef struct AVCodecContext {
      */
     AVFrameSideData  **decoded_side_data;
     int             nb_decoded_side_data;
+
+    /**
+     * Thread pool shared with other contexts. If set, slice threading runs
+     * its jobs on the threads of this pool instead of creating private
+     * threads, and thread_count is ignored unless it is 1. Frame threading
+     * always uses private threads, so thread_type should be set to
+     * FF_THREAD_SLICE for all threading to be done by the pool.
+     *
+     * The pool must have at least one thread and must outlive the context.
+     * The contexts sharing it are not given a fair share of its threads, so
+     * a busy context delays the others, see av_executor_start_graph().
+     *
+     * - encoding: may be set by user before calling avcodec_open2().
+     * - decoding: may be set by user before calling avcodec_open2().
+     */
+    struct AVExecutor *thread_pool;
 } AVCodecContext;
 
 /**
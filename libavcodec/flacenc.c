@@ -86,6 +86,7 @@ typedef struct FlacSubframe {
     int shift;
 
     RiceContext rc;
+    int bits;
     uint32_t rc_udata[FLAC_MAX_BLOCKSIZE];
     uint64_t rc_sums[32][MAX_PARTITIONS];
 
@@ -120,7 +121,7 @@ typedef struct FlacEncodeContext {
     FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
-    LPCContext lpc_ctx;
+    LPCContext lpc_ctx[FLAC_MAX_CHANNELS];
     struct AVMD5 *md5ctx;
     uint8_t *md5_buffer;
     unsigned int md5_buffer_size;
@@ -129,6 +130,18 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /**
+     * Contexts of the frames encoded in parallel, copies of the main
+     * context except frame_ctx[0] which is the main context itself.
+     */
+    struct FlacEncodeContext **frame_ctx;
+    int nb_frame_ctx;
+    int nb_frames;          ///< number of frames gathered for the next batch
+    int nb_packets;         ///< number of packets of the last batch
+    int next_packet;        ///< index of the next packet to return
+    AVFrame *input;         ///< input frame of this frame context
+    AVPacket *pkt;          ///< packet of this frame context
 } FlacEncodeContext;
 
 
@@ -464,15 +477,43 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
         }
     }
 
-    ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
-                      s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
-
     ff_bswapdsp_init(&s->bdsp);
     ff_flacencdsp_init(&s->flac_dsp);
 
     dprint_compression_options(s);
 
-    return ret;
+    /* With slice threads, batches of frames are encoded in parallel, each
+     * frame with its own copy of the context and each channel with its own
+     * LPC context. */
+    s->nb_frame_ctx = avctx->active_thread_type & FF_THREAD_SLICE ?
+                      avctx->thread_count : 1;
+    s->frame_ctx = av_calloc(s->nb_frame_ctx, sizeof(*s->frame_ctx));
+    if (!s->frame_ctx)
+        return AVERROR(ENOMEM);
+    s->frame_ctx[0] = s;
+    for (i = 1; i < s->nb_frame_ctx; i++) {
+        s->frame_ctx[i] = av_memdup(s, sizeof(*s));
+        if (!s->frame_ctx[i])
+            return AVERROR(ENOMEM);
+    }
+
+    for (i = 0; i < s->nb_frame_ctx; i++) {
+        FlacEncodeContext *fs = s->frame_ctx[i];
+
+        fs->input = av_frame_alloc();
+        fs->pkt   = av_packet_alloc();
+        if (!fs->input || !fs->pkt)
+            return AVERROR(ENOMEM);
+
+        for (int ch = 0; ch < channels; ch++) {
+            ret = ff_lpc_init(&fs->lpc_ctx[ch], avctx->frame_size,
+                              s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
 }
 
 
@@ -1048,7 +1089,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         for (i = 0; i < n; i++)
             smp[i] = smp_33bps[i] >> 1;
 
-    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx, smp, n, min_order, max_order,
+    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx[ch], smp, n, min_order, max_order,
                                   s->options.lpc_coeff_precision, coefs, shift, s->options.lpc_type,
                                   s->options.lpc_passes, omethod,
                                   MIN_LPC_SHIFT, MAX_LPC_SHIFT, 0);
@@ -1206,7 +1247,7 @@ static int count_frame_header(FlacEncodeContext *s)
 }
 
 
-static int encode_frame(FlacEncodeContext *s)
+static int count_frame(FlacEncodeContext *s)
 {
     int ch;
     uint64_t count;
@@ -1214,7 +1255,7 @@ static int encode_frame(FlacEncodeContext *s)
     count = count_frame_header(s);
 
     for (ch = 0; ch < s->channels; ch++)
-        count += encode_residual_ch(s, ch);
+        count += s->frame.subframes[ch].bits;
 
     count += (8 - (count & 7)) & 7; // byte alignment
     count += 16;                    // CRC-16
@@ -1226,6 +1267,17 @@ static int encode_frame(FlacEncodeContext *s)
 }
 
 
+static int encode_frame(FlacEncodeContext *s)
+{
+    int ch;
+
+    for (ch = 0; ch < s->channels; ch++)
+        s->frame.subframes[ch].bits = encode_residual_ch(s, ch);
+
+    return count_frame(s);
+}
+
+
 static void remove_wasted_bits(FlacEncodeContext *s)
 {
     int ch, i, wasted_bits;
@@ -1571,10 +1623,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const AVFrame *frame)
 {
+    const void *samples = frame->data[0];
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = frame->nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1595,7 +1648,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < frame->nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1606,7 +1659,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++)
+        for (i = 0; i < frame->nb_samples * s->channels; i++)
             AV_WL32(tmp + 4*i, samples0[i]);
         buf = s->md5_buffer;
     }
@@ -1616,85 +1669,174 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
-static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
-                             const AVFrame *frame, int *got_packet_ptr)
+static int prepare_frame_thread(AVCodecContext *avctx, void *arg,
+                                int jobnr, int threadnr)
 {
-    FlacEncodeContext *s;
-    int frame_bytes, out_bytes, ret;
+    FlacEncodeContext *s  = avctx->priv_data;
+    FlacEncodeContext *fs = s->frame_ctx[jobnr];
 
-    s = avctx->priv_data;
+    init_frame(fs, fs->input->nb_samples);
 
-    /* when the last block is reached, update the header in extradata */
-    if (!frame) {
-        s->max_framesize = s->max_encoded_framesize;
-        av_md5_final(s->md5ctx, s->md5sum);
-        write_streaminfo(s, avctx->extradata);
-
-        if (!s->flushed) {
-            uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
-                                                         avctx->extradata_size);
-            if (!side_data)
-                return AVERROR(ENOMEM);
-            memcpy(side_data, avctx->extradata, avctx->extradata_size);
-
-            avpkt->pts = s->next_pts;
-
-            *got_packet_ptr = 1;
-            s->flushed = 1;
-        }
+    copy_samples(fs, fs->input->data[0]);
 
-        return 0;
+    channel_decorrelation(fs);
+
+    remove_wasted_bits(fs);
+
+    return 0;
+}
+
+
+static int encode_subframe_thread(AVCodecContext *avctx, void *arg,
+                                  int jobnr, int threadnr)
+{
+    FlacEncodeContext *s  = avctx->priv_data;
+    FlacEncodeContext *fs = s->frame_ctx[jobnr / s->channels];
+    int ch = jobnr % s->channels;
+
+    fs->frame.subframes[ch].bits = encode_residual_ch(fs, ch);
+
+    return 0;
+}
+
+
+static int write_frame_thread(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    FlacEncodeContext *s  = avctx->priv_data;
+    FlacEncodeContext *fs = s->frame_ctx[jobnr];
+
+    av_shrink_packet(fs->pkt, write_frame(fs, fs->pkt));
+
+    return 0;
+}
+
+
+/**
+ * Encode the gathered frames, in parallel as the frames of a fixed blocksize
+ * stream are coded independently, the subframes of each frame too.
+ * The frame numbers, the MD5 sum and the statistics are updated in order.
+ */
+static int encode_frames(AVCodecContext *avctx)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int i, ret;
+
+    for (i = 0; i < s->nb_frames; i++) {
+        FlacEncodeContext *fs = s->frame_ctx[i];
+
+        fs->frame_count   = s->frame_count + i;
+        /* smaller for the final frame */
+        fs->max_framesize = flac_get_max_frame_size(fs->input->nb_samples,
+                                                    s->channels,
+                                                    avctx->bits_per_raw_sample);
     }
 
-    /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = flac_get_max_frame_size(frame->nb_samples,
-                                                   s->channels,
-                                                   avctx->bits_per_raw_sample);
+    avctx->execute2(avctx, prepare_frame_thread, NULL, NULL, s->nb_frames);
+    avctx->execute2(avctx, encode_subframe_thread, NULL, NULL,
+                    s->nb_frames * s->channels);
+
+    for (i = 0; i < s->nb_frames; i++) {
+        FlacEncodeContext *fs = s->frame_ctx[i];
+        int frame_bytes = count_frame(fs);
+
+        /* Fall back on verbatim mode if the compressed frame is larger than it
+           would be if encoded uncompressed. */
+        if (frame_bytes < 0 || frame_bytes > fs->max_framesize) {
+            fs->frame.verbatim_only = 1;
+            frame_bytes = encode_frame(fs);
+            if (frame_bytes < 0) {
+                av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+                return frame_bytes;
+            }
+        }
+
+        if ((ret = ff_get_encode_buffer(avctx, fs->pkt, frame_bytes, 0)) < 0)
+            return ret;
     }
 
-    init_frame(s, frame->nb_samples);
+    avctx->execute2(avctx, write_frame_thread, NULL, NULL, s->nb_frames);
 
-    copy_samples(s, frame->data[0]);
+    for (i = 0; i < s->nb_frames; i++) {
+        FlacEncodeContext *fs = s->frame_ctx[i];
+        AVFrame  *frame = fs->input;
+        AVPacket *pkt   = fs->pkt;
 
-    channel_decorrelation(s);
+        s->frame_count++;
+        s->sample_count += frame->nb_samples;
+        if ((ret = update_md5_sum(s, frame)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+        if (pkt->size > s->max_encoded_framesize)
+            s->max_encoded_framesize = pkt->size;
+        if (pkt->size < s->min_framesize)
+            s->min_framesize = pkt->size;
 
-    remove_wasted_bits(s);
+        pkt->pts      = frame->pts;
+        pkt->dts      = frame->pts;
+        pkt->duration = frame->duration ? frame->duration :
+                        ff_samples_to_time_base(avctx, frame->nb_samples);
+        if ((ret = ff_encode_reordered_opaque(avctx, pkt, frame)) < 0)
+            return ret;
 
-    frame_bytes = encode_frame(s);
+        s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
 
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
+        av_frame_unref(frame);
     }
 
-    if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
-        return ret;
+    s->nb_packets  = s->nb_frames;
+    s->next_packet = 0;
+    s->nb_frames   = 0;
 
-    out_bytes = write_frame(s, avpkt);
+    return 0;
+}
+
+
+static int flac_encode_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    uint8_t *side_data;
+    int ret;
 
-    s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
-        return ret;
+    if (s->next_packet < s->nb_packets) {
+        av_packet_move_ref(avpkt, s->frame_ctx[s->next_packet++]->pkt);
+        return 0;
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
 
-    s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
+    while (s->nb_frames < s->nb_frame_ctx) {
+        ret = ff_encode_get_frame(avctx, s->frame_ctx[s->nb_frames]->input);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        s->nb_frames++;
+    }
 
-    av_shrink_packet(avpkt, out_bytes);
+    if (s->nb_frames) {
+        if ((ret = encode_frames(avctx)) < 0)
+            return ret;
+        av_packet_move_ref(avpkt, s->frame_ctx[s->next_packet++]->pkt);
+        return 0;
+    }
+
+    if (s->flushed)
+        return AVERROR_EOF;
+
+    /* when the last block is reached, update the header in extradata */
+    s->max_framesize = s->max_encoded_framesize;
+    av_md5_final(s->md5ctx, s->md5sum);
+    write_streaminfo(s, avctx->extradata);
+
+    side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                        avctx->extradata_size);
+    if (!side_data)
+        return AVERROR(ENOMEM);
+    memcpy(side_data, avctx->extradata, avctx->extradata_size);
+
+    avpkt->pts = avpkt->dts = s->next_pts;
+    s->flushed = 1;
 
-    *got_packet_ptr = 1;
     return 0;
 }
 
@@ -1703,9 +1845,22 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
 
+    for (int i = 0; s->frame_ctx && i < s->nb_frame_ctx; i++) {
+        FlacEncodeContext *fs = s->frame_ctx[i];
+
+        if (!fs)
+            continue;
+        for (int ch = 0; ch < FLAC_MAX_CHANNELS; ch++)
+            ff_lpc_end(&fs->lpc_ctx[ch]);
+        av_frame_free(&fs->input);
+        av_packet_free(&fs->pkt);
+        if (i)
+            av_freep(&s->frame_ctx[i]);
+    }
+    av_freep(&s->frame_ctx);
+
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
-    ff_lpc_end(&s->lpc_ctx);
     return 0;
 }
 
@@ -1755,12 +1910,13 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
-    FF_CODEC_ENCODE_CB(flac_encode_frame),
+    FF_CODEC_RECEIVE_PACKET_CB(flac_encode_receive_packet),
     .close          = flac_encode_close,
     CODEC_SAMPLEFMTS(AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32),
     .p.priv_class   = &flac_encoder_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_EOF_FLUSH,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
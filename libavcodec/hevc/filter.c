@@ -739,6 +739,82 @@ static int boundary_strength(const HEVCContext *s, const MvField *curr, const Mv
     return 1;
 }
 
+/* bs for the horizontal TU boundary at y0, from x0 to x0 + size */
+static void boundary_strengths_upper(HEVCLocalContext *lc, const HEVCLayerContext *l,
+                                     const HEVCPPS *pps, int x0, int y0, int size)
+{
+    const HEVCSPS *const sps = pps->sps;
+    const HEVCContext *s = lc->parent;
+    const MvField *tab_mvf = s->cur_frame->tab_mvf;
+    int log2_min_pu_size = sps->log2_min_pu_size;
+    int log2_min_tu_size = sps->log2_min_tb_size;
+    int min_pu_width     = sps->min_pu_width;
+    int min_tu_width     = sps->min_tb_width;
+    const RefPicList *rpl_top = (lc->boundary_flags & BOUNDARY_UPPER_SLICE) ?
+                                ff_hevc_get_ref_list(s->cur_frame, x0, y0 - 1) :
+                                s->cur_frame->refPicList;
+    int yp_pu = (y0 - 1) >> log2_min_pu_size;
+    int yq_pu =  y0      >> log2_min_pu_size;
+    int yp_tu = (y0 - 1) >> log2_min_tu_size;
+    int yq_tu =  y0      >> log2_min_tu_size;
+    int bs;
+
+    for (int i = 0; i < size; i += 4) {
+        int x_pu = (x0 + i) >> log2_min_pu_size;
+        int x_tu = (x0 + i) >> log2_min_tu_size;
+        const MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
+        const MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
+        uint8_t top_cbf_luma  = l->cbf_luma[yp_tu * min_tu_width + x_tu];
+        uint8_t curr_cbf_luma = l->cbf_luma[yq_tu * min_tu_width + x_tu];
+
+        if (curr->pred_flag == PF_INTRA || top->pred_flag == PF_INTRA)
+            bs = 2;
+        else if (curr_cbf_luma || top_cbf_luma)
+            bs = 1;
+        else
+            bs = boundary_strength(s, curr, top, rpl_top);
+        l->horizontal_bs[((x0 + i) + y0 * l->bs_width) >> 2] = bs;
+    }
+}
+
+/* bs for the vertical TU boundary at x0, from y0 to y0 + size */
+static void boundary_strengths_left(HEVCLocalContext *lc, const HEVCLayerContext *l,
+                                    const HEVCPPS *pps, int x0, int y0, int size)
+{
+    const HEVCSPS *const sps = pps->sps;
+    const HEVCContext *s = lc->parent;
+    const MvField *tab_mvf = s->cur_frame->tab_mvf;
+    int log2_min_pu_size = sps->log2_min_pu_size;
+    int log2_min_tu_size = sps->log2_min_tb_size;
+    int min_pu_width     = sps->min_pu_width;
+    int min_tu_width     = sps->min_tb_width;
+    const RefPicList *rpl_left = (lc->boundary_flags & BOUNDARY_LEFT_SLICE) ?
+                                 ff_hevc_get_ref_list(s->cur_frame, x0 - 1, y0) :
+                                 s->cur_frame->refPicList;
+    int xp_pu = (x0 - 1) >> log2_min_pu_size;
+    int xq_pu =  x0      >> log2_min_pu_size;
+    int xp_tu = (x0 - 1) >> log2_min_tu_size;
+    int xq_tu =  x0      >> log2_min_tu_size;
+    int bs;
+
+    for (int i = 0; i < size; i += 4) {
+        int y_pu      = (y0 + i) >> log2_min_pu_size;
+        int y_tu      = (y0 + i) >> log2_min_tu_size;
+        const MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
+        const MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
+        uint8_t left_cbf_luma = l->cbf_luma[y_tu * min_tu_width + xp_tu];
+        uint8_t curr_cbf_luma = l->cbf_luma[y_tu * min_tu_width + xq_tu];
+
+        if (curr->pred_flag == PF_INTRA || left->pred_flag == PF_INTRA)
+            bs = 2;
+        else if (curr_cbf_luma || left_cbf_luma)
+            bs = 1;
+        else
+            bs = boundary_strength(s, curr, left, rpl_left);
+        l->vertical_bs[(x0 + (y0 + i) * l->bs_width) >> 2] = bs;
+    }
+}
+
 void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayerContext *l,
                                            const HEVCPPS *pps,
                                            int x0, int y0, int log2_trafo_size)
@@ -747,9 +823,7 @@ void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayer
     const HEVCContext *s = lc->parent;
     const MvField *tab_mvf = s->cur_frame->tab_mvf;
     int log2_min_pu_size = sps->log2_min_pu_size;
-    int log2_min_tu_size = sps->log2_min_tb_size;
     int min_pu_width     = sps->min_pu_width;
-    int min_tu_width     = sps->min_tb_width;
     int is_intra = tab_mvf[(y0 >> log2_min_pu_size) * min_pu_width +
                            (x0 >> log2_min_pu_size)].pred_flag == PF_INTRA;
     int boundary_upper, boundary_left;
@@ -760,37 +834,13 @@ void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayer
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_UPPER_SLICE &&
           (y0 % (1 << sps->log2_ctb_size)) == 0) ||
-         (!pps->loop_filter_across_tiles_enabled_flag &&
+         ((!pps->loop_filter_across_tiles_enabled_flag || lc->tile_edges_deferred) &&
           lc->boundary_flags & BOUNDARY_UPPER_TILE &&
           (y0 % (1 << sps->log2_ctb_size)) == 0)))
         boundary_upper = 0;
 
-    if (boundary_upper) {
-        const RefPicList *rpl_top = (lc->boundary_flags & BOUNDARY_UPPER_SLICE) ?
-                                    ff_hevc_get_ref_list(s->cur_frame, x0, y0 - 1) :
-                                    s->cur_frame->refPicList;
-        int yp_pu = (y0 - 1) >> log2_min_pu_size;
-        int yq_pu =  y0      >> log2_min_pu_size;
-        int yp_tu = (y0 - 1) >> log2_min_tu_size;
-        int yq_tu =  y0      >> log2_min_tu_size;
-
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
-                int x_pu = (x0 + i) >> log2_min_pu_size;
-                int x_tu = (x0 + i) >> log2_min_tu_size;
-                const MvField *top  = &tab_mvf[yp_pu * min_pu_width + x_pu];
-                const MvField *curr = &tab_mvf[yq_pu * min_pu_width + x_pu];
-                uint8_t top_cbf_luma  = l->cbf_luma[yp_tu * min_tu_width + x_tu];
-                uint8_t curr_cbf_luma = l->cbf_luma[yq_tu * min_tu_width + x_tu];
-
-                if (curr->pred_flag == PF_INTRA || top->pred_flag == PF_INTRA)
-                    bs = 2;
-                else if (curr_cbf_luma || top_cbf_luma)
-                    bs = 1;
-                else
-                    bs = boundary_strength(s, curr, top, rpl_top);
-                l->horizontal_bs[((x0 + i) + y0 * l->bs_width) >> 2] = bs;
-            }
-    }
+    if (boundary_upper)
+        boundary_strengths_upper(lc, l, pps, x0, y0, 1 << log2_trafo_size);
 
     // bs for vertical TU boundaries
     boundary_left = x0 > 0 && !(x0 & 7);
@@ -798,37 +848,13 @@ void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayer
         ((!s->sh.slice_loop_filter_across_slices_enabled_flag &&
           lc->boundary_flags & BOUNDARY_LEFT_SLICE &&
           (x0 % (1 << sps->log2_ctb_size)) == 0) ||
-         (!pps->loop_filter_across_tiles_enabled_flag &&
+         ((!pps->loop_filter_across_tiles_enabled_flag || lc->tile_edges_deferred) &&
           lc->boundary_flags & BOUNDARY_LEFT_TILE &&
           (x0 % (1 << sps->log2_ctb_size)) == 0)))
         boundary_left = 0;
 
-    if (boundary_left) {
-        const RefPicList *rpl_left = (lc->boundary_flags & BOUNDARY_LEFT_SLICE) ?
-                                     ff_hevc_get_ref_list(s->cur_frame, x0 - 1, y0) :
-                                     s->cur_frame->refPicList;
-        int xp_pu = (x0 - 1) >> log2_min_pu_size;
-        int xq_pu =  x0      >> log2_min_pu_size;
-        int xp_tu = (x0 - 1) >> log2_min_tu_size;
-        int xq_tu =  x0      >> log2_min_tu_size;
-
-            for (i = 0; i < (1 << log2_trafo_size); i += 4) {
-                int y_pu      = (y0 + i) >> log2_min_pu_size;
-                int y_tu      = (y0 + i) >> log2_min_tu_size;
-                const MvField *left = &tab_mvf[y_pu * min_pu_width + xp_pu];
-                const MvField *curr = &tab_mvf[y_pu * min_pu_width + xq_pu];
-                uint8_t left_cbf_luma = l->cbf_luma[y_tu * min_tu_width + xp_tu];
-                uint8_t curr_cbf_luma = l->cbf_luma[y_tu * min_tu_width + xq_tu];
-
-                if (curr->pred_flag == PF_INTRA || left->pred_flag == PF_INTRA)
-                    bs = 2;
-                else if (curr_cbf_luma || left_cbf_luma)
-                    bs = 1;
-                else
-                    bs = boundary_strength(s, curr, left, rpl_left);
-                l->vertical_bs[(x0 + (y0 + i) * l->bs_width) >> 2] = bs;
-            }
-    }
+    if (boundary_left)
+        boundary_strengths_left(lc, l, pps, x0, y0, 1 << log2_trafo_size);
 
     if (log2_trafo_size > log2_min_pu_size && !is_intra) {
         const RefPicList *rpl = s->cur_frame->refPicList;
@@ -865,6 +891,31 @@ void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayer
     }
 }
 
+void ff_hevc_deblocking_boundary_strengths_tile(HEVCLocalContext *lc,
+                                                const HEVCLayerContext *l,
+                                                const HEVCPPS *pps,
+                                                int x_ctb, int y_ctb)
+{
+    const HEVCSPS *const sps = pps->sps;
+    const HEVCContext *s = lc->parent;
+    const int ctb_size = 1 << sps->log2_ctb_size;
+
+    if (!pps->loop_filter_across_tiles_enabled_flag)
+        return;
+
+    if (lc->boundary_flags & BOUNDARY_UPPER_TILE &&
+        (s->sh.slice_loop_filter_across_slices_enabled_flag ||
+         !(lc->boundary_flags & BOUNDARY_UPPER_SLICE)))
+        boundary_strengths_upper(lc, l, pps, x_ctb, y_ctb,
+                                 FFMIN(ctb_size, sps->width - x_ctb));
+
+    if (lc->boundary_flags & BOUNDARY_LEFT_TILE &&
+        (s->sh.slice_loop_filter_across_slices_enabled_flag ||
+         !(lc->boundary_flags & BOUNDARY_LEFT_SLICE)))
+        boundary_strengths_left(lc, l, pps, x_ctb, y_ctb,
+                                FFMIN(ctb_size, sps->height - y_ctb));
+}
+
 #undef LUMA
 #undef CB
 #undef CR
@@ -2703,8 +2703,6 @@ static void hls_decode_neighbour(HEVCLocalContext *lc,
     int ctb_addr_rs       = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
     int ctb_addr_in_slice = ctb_addr_rs - s->sh.slice_addr;
 
-    l->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
-
     if (pps->entropy_coding_sync_enabled_flag) {
         if (x_ctb == 0 && (y_ctb & (ctb_size - 1)) == 0)
             lc->first_qp_group = 1;
@@ -2764,6 +2762,7 @@ static int hls_decode_entry(HEVCContext *s, GetBitContext *gb)
 
         x_ctb = (ctb_addr_rs % ((sps->width + ctb_size - 1) >> sps->log2_ctb_size)) << sps->log2_ctb_size;
         y_ctb = (ctb_addr_rs / ((sps->width + ctb_size - 1) >> sps->log2_ctb_size)) << sps->log2_ctb_size;
+        l->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
         hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
 
         ret = ff_hevc_cabac_init(lc, pps, ctb_addr_ts, slice_data, slice_size, 0);
@@ -2826,6 +2825,7 @@ static int hls_decode_entry_wpp(AVCodecContext *avctx, void *hevc_lclist,
         int x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
         int y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
 
+        l->tab_slice_address[ctb_addr_rs] = s->sh.slice_addr;
         hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
 
         if (ctb_row)
@@ -2893,6 +2893,81 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctx, void *hevc_lclist,
+                                 int job, int thread)
+{
+    HEVCLocalContext *lc = &((HEVCLocalContext*)hevc_lclist)[thread];
+    const HEVCContext *const s = lc->parent;
+    const HEVCLayerContext *const l = &s->layers[s->cur_layer];
+    const HEVCPPS   *const pps = s->pps;
+    const HEVCSPS   *const sps = pps->sps;
+    const int tile = pps->tile_id[pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs]] + job;
+    const int tile_x = tile % pps->num_tile_columns;
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile]];
+    int ctb_addr_rs = pps->tile_pos_rs[tile];
+    int more_data   = 1;
+    int ret;
+
+    const uint8_t *data      = s->data + s->sh.offset[job];
+    const size_t   data_size = s->sh.size[job];
+
+    lc->first_qp_group      = 1;
+    lc->qp_y                = s->sh.slice_qp;
+    lc->tu.cu_qp_offset_cb  = 0;
+    lc->tu.cu_qp_offset_cr  = 0;
+    lc->end_of_tiles_x      = (pps->col_bd[tile_x] + pps->column_width[tile_x]) << sps->log2_ctb_size;
+    lc->tile_edges_deferred = 1;
+
+    while (more_data && ctb_addr_ts < sps->ctb_size &&
+           pps->tile_id[ctb_addr_ts] == tile) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, ctb_addr_ts);
+
+        /* atomic_load's prototype requires a pointer to non-const atomic variable
+         * (due to implementations via mutexes, where reads involve writes).
+         * Of course, casting const away here is nevertheless safe. */
+        if (atomic_load((atomic_int*)&s->wpp_err))
+            return 0;
+
+        ret = ff_hevc_cabac_init(lc, pps, ctb_addr_ts, data, data_size, 1);
+        if (ret < 0)
+            goto error;
+        hls_sao_param(lc, l, pps, sps,
+                      x_ctb >> sps->log2_ctb_size, y_ctb >> sps->log2_ctb_size);
+
+        l->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        l->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        l->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(lc, l, pps, sps, x_ctb, y_ctb, sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+
+        ctb_addr_ts++;
+    }
+
+    /* Every tile but the last one must be complete, and the slice segment
+     * must end with the last one */
+    if (more_data == (job == s->sh.num_entry_point_offsets) ||
+        (!more_data && ctb_addr_ts < sps->ctb_size && pps->tile_id[ctb_addr_ts] == tile)) {
+        ret = AVERROR_INVALIDDATA;
+        goto error;
+    }
+
+    return 0;
+error:
+    /* Casting const away here is safe, because it is an atomic operation. */
+    atomic_store((atomic_int*)&s->wpp_err, 1);
+    return ret;
+}
+
 static int wpp_progress_init(HEVCContext *s, unsigned count)
 {
     if (s->nb_wpp_progress < count) {
@@ -2919,24 +2994,15 @@ static int wpp_progress_init(HEVCContext *s, unsigned count)
     return 0;
 }
 
-static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
+/* Set up the local contexts and the substreams of the entry points of the
+ * current slice segment for decoding them in parallel. */
+static int init_entry_points(HEVCContext *s, const H2645NAL *nal)
 {
-    const HEVCPPS *const pps = s->pps;
-    const HEVCSPS *const sps = pps->sps;
     const uint8_t *data = nal->data;
     int length          = nal->size;
-    int *ret;
     int64_t offset;
     int64_t startheader, cmpt = 0;
-    int i, j, res = 0;
-
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
-        av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
-            s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
-            sps->ctb_width, sps->ctb_height
-        );
-        return AVERROR_INVALIDDATA;
-    }
+    int i, j;
 
     if (s->avctx->thread_count > s->nb_local_ctx) {
         HEVCLocalContext *tmp = av_malloc_array(s->avctx->thread_count, sizeof(*s->local_ctx));
@@ -2997,6 +3063,28 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 
     s->data = data;
 
+    return 0;
+}
+
+static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
+{
+    const HEVCPPS *const pps = s->pps;
+    const HEVCSPS *const sps = pps->sps;
+    int *ret;
+    int i, res = 0;
+
+    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
+        av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
+            s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
+            sps->ctb_width, sps->ctb_height
+        );
+        return AVERROR_INVALIDDATA;
+    }
+
+    res = init_entry_points(s, nal);
+    if (res < 0)
+        return res;
+
     for (i = 1; i < s->nb_local_ctx; i++) {
         s->local_ctx[i].first_qp_group = 1;
         s->local_ctx[i].qp_y = s->local_ctx[0].qp_y;
@@ -3021,6 +3109,97 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     return res;
 }
 
+/**
+ * Decode the tiles of a slice segment in parallel. The in-loop filters and
+ * the deblocking boundary strengths of the tile edges depend on the
+ * neighbouring tiles, so they are applied afterwards in the same order as
+ * when decoding the tiles sequentially.
+ */
+static int hls_slice_data_tiles(HEVCContext *s, const HEVCLayerContext *l,
+                                const H2645NAL *nal, GetBitContext *gb)
+{
+    const HEVCPPS *const pps = s->pps;
+    const HEVCSPS *const sps = pps->sps;
+    HEVCLocalContext *const lc = &s->local_ctx[0];
+    const int num_tiles = pps->num_tile_columns * pps->num_tile_rows;
+    const int ctb_size  = 1 << sps->log2_ctb_size;
+    const int ctb_addr_ts_start = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    const int tile_start = pps->tile_id[ctb_addr_ts_start];
+    const int tile_end   = tile_start + s->sh.num_entry_point_offsets + 1;
+    int ctb_addr_ts_end, x_ctb = 0, y_ctb = 0;
+    int *ret;
+    int i, res = 0;
+
+    /* Slice segments spanning several tiles must consist of complete tiles */
+    if (pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile_start]] != ctb_addr_ts_start)
+        return hls_decode_entry(s, gb);
+
+    if (tile_end > num_tiles) {
+        av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d %d)\n",
+               tile_start, s->sh.num_entry_point_offsets, num_tiles);
+        return AVERROR_INVALIDDATA;
+    }
+    ctb_addr_ts_end = tile_end < num_tiles ?
+                      pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile_end]] : sps->ctb_size;
+
+    res = init_entry_points(s, nal);
+    if (res < 0)
+        return res;
+
+    /* The slice address of the neighbouring CTBs is used to derive the
+     * boundary flags, so it must be known before decoding any tile. The
+     * tile jobs only read it. */
+    for (i = ctb_addr_ts_start; i < ctb_addr_ts_end; i++)
+        l->tab_slice_address[pps->ctb_addr_ts_to_rs[i]] = s->sh.slice_addr;
+
+    atomic_store(&s->wpp_err, 0);
+
+    ret = av_calloc(s->sh.num_entry_point_offsets + 1, sizeof(*ret));
+    if (!ret)
+        return AVERROR(ENOMEM);
+
+    s->avctx->execute2(s->avctx, hls_decode_entry_tile, s->local_ctx, ret,
+                       s->sh.num_entry_point_offsets + 1);
+
+    for (i = 0; i < s->nb_local_ctx; i++)
+        s->local_ctx[i].tile_edges_deferred = 0;
+
+    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+        res = FFMIN(res, ret[i]);
+    av_free(ret);
+    if (res < 0) {
+        /* mark the slice segment as not decoded */
+        for (i = ctb_addr_ts_start; i < ctb_addr_ts_end; i++)
+            l->tab_slice_address[pps->ctb_addr_ts_to_rs[i]] = -1;
+        return res;
+    }
+
+    if (!s->sh.disable_deblocking_filter_flag) {
+        for (i = ctb_addr_ts_start; i < ctb_addr_ts_end; i++) {
+            int ctb_addr_rs = pps->ctb_addr_ts_to_rs[i];
+            x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+            y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+            hls_decode_neighbour(lc, l, pps, sps, x_ctb, y_ctb, i);
+            ff_hevc_deblocking_boundary_strengths_tile(lc, l, pps, x_ctb, y_ctb);
+        }
+    }
+
+    for (i = ctb_addr_ts_start; i < ctb_addr_ts_end; i++) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[i];
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+
+        ff_hevc_hls_filters(lc, l, pps, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= sps->width &&
+        y_ctb + ctb_size >= sps->height)
+        ff_hevc_hls_filter(lc, l, pps, x_ctb, y_ctb, ctb_size);
+
+    return ctb_addr_ts_end;
+}
+
 static int decode_slice_data(HEVCContext *s, const HEVCLayerContext *l,
                              const H2645NAL *nal, GetBitContext *gb)
 {
@@ -3068,9 +3247,12 @@ static int decode_slice_data(HEVCContext *s, const HEVCLayerContext *l,
     s->local_ctx[0].tu.cu_qp_offset_cr = 0;
 
     if (s->avctx->active_thread_type == FF_THREAD_SLICE  &&
-        s->sh.num_entry_point_offsets > 0                &&
-        pps->num_tile_rows == 1 && pps->num_tile_columns == 1)
-        return hls_slice_data_wpp(s, nal);
+        s->sh.num_entry_point_offsets > 0) {
+        if (pps->num_tile_rows == 1 && pps->num_tile_columns == 1)
+            return hls_slice_data_wpp(s, nal);
+        if (!pps->entropy_coding_sync_enabled_flag)
+            return hls_slice_data_tiles(s, l, nal, gb);
+    }
 
     return hls_decode_entry(s, gb);
 }
@@ -446,6 +446,11 @@ typedef struct HEVCLocalContext {
      * of the deblocking filter */
     int boundary_flags;
 
+    /* set while the tiles of a slice are decoded in parallel; the boundary
+     * strengths of the tile edges are then computed afterwards by
+     * ff_hevc_deblocking_boundary_strengths_tile() */
+    int tile_edges_deferred;
+
     // an array of these structs is used for per-thread state - pad its size
     // to avoid false sharing
     char padding[128];
@@ -709,6 +714,10 @@ void ff_hevc_set_qPy(HEVCLocalContext *lc,
 void ff_hevc_deblocking_boundary_strengths(HEVCLocalContext *lc, const HEVCLayerContext *l,
                                            const HEVCPPS *pps,
                                            int x0, int y0, int log2_trafo_size);
+void ff_hevc_deblocking_boundary_strengths_tile(HEVCLocalContext *lc,
+                                                const HEVCLayerContext *l,
+                                                const HEVCPPS *pps,
+                                                int x_ctb, int y_ctb);
 int ff_hevc_cu_qp_delta_sign_flag(HEVCLocalContext *lc);
 int ff_hevc_cu_qp_delta_abs(HEVCLocalContext *lc);
 int ff_hevc_cu_chroma_qp_offset_flag(HEVCLocalContext *lc);
@@ -109,6 +109,18 @@ typedef struct {
    double *layer_rates;
 } Jpeg2000Tile;
 
+/**
+ * Codeblock coded by a tier-1 job.
+ */
+typedef struct {
+    Jpeg2000Tile *tile;
+    Jpeg2000Component *comp;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    int x0, y0, x1, y1; ///< codeblock area in the transformed component
+    int bandpos, lev;
+} Jpeg2000EncCblk;
+
 typedef struct {
     AVClass *class;
     AVCodecContext *avctx;
@@ -134,6 +146,8 @@ typedef struct {
     Jpeg2000QuantStyle  qntsty;
 
     Jpeg2000Tile *tile;
+    Jpeg2000EncCblk *cblks; ///< codeblocks of all the tiles, coded in parallel
+    int nb_cblks;
     int layer_rates[100];
     uint8_t compression_rate_enc; ///< Is compression done using compression ratio?
 
@@ -1402,84 +1416,133 @@ static void truncpasses(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
-static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+static int dwt_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
 {
-    int compno, reslevelno, bandno, ret;
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    Jpeg2000Component *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
+
+    return ff_dwt_encode(&comp->dwt, comp->i_data);
+}
+
+static int encode_cblk_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000EncoderContext *s = avctx->priv_data;
+    const Jpeg2000EncCblk *job = &s->cblks[jobnr];
+    const Jpeg2000Component *comp = job->comp;
+    const Jpeg2000Band *band = job->band;
     Jpeg2000T1Context t1;
+    int y, x;
+
+    t1.stride = (1<<s->codsty.log2_cblk_width) + 2;
+
+    if (s->codsty.transform == FF_DWT53){
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1.data + (y-job->y0)*t1.stride;
+            for (x = job->x0; x < job->x1; x++){
+                *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
+            }
+        }
+    } else{
+        for (y = job->y0; y < job->y1; y++){
+            int *ptr = t1.data + (y-job->y0)*t1.stride;
+            for (x = job->x0; x < job->x1; x++){
+                *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
+                *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
+                ptr++;
+            }
+        }
+    }
+    encode_cblk(s, &t1, job->cblk, job->tile, job->x1 - job->x0, job->y1 - job->y0,
+                job->bandpos, job->lev);
+
+    return 0;
+}
+
+/**
+ * List the codeblocks of all the tiles for the tier-1 jobs
+ * and allocate their buffers.
+ */
+static int init_cblks(Jpeg2000EncoderContext *s)
+{
+    int tileno, compno, reslevelno, bandno, pass;
     Jpeg2000CodingStyle *codsty = &s->codsty;
-    for (compno = 0; compno < s->ncomponents; compno++){
-        Jpeg2000Component *comp = s->tile[tileno].comp + compno;
 
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
+    for (pass = 0; pass < 2; pass++) {
+        s->nb_cblks = 0;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
+            Jpeg2000Tile *tile = s->tile + tileno;
 
-        av_log(s->avctx, AV_LOG_DEBUG,"dwt\n");
-        if ((ret = ff_dwt_encode(&comp->dwt, comp->i_data)) < 0)
-            return ret;
-        av_log(s->avctx, AV_LOG_DEBUG,"after dwt -> tier1\n");
+            for (compno = 0; compno < s->ncomponents; compno++){
+                Jpeg2000Component *comp = tile->comp + compno;
 
-        for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
-            Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
+                for (reslevelno = 0; reslevelno < codsty->nreslevels; reslevelno++){
+                    Jpeg2000ResLevel *reslevel = comp->reslevel + reslevelno;
 
-            for (bandno = 0; bandno < reslevel->nbands ; bandno++){
-                Jpeg2000Band *band = reslevel->band + bandno;
-                Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
-                int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1, bandpos;
-                yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
-                y0 = yy0;
-                yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
-                            band->coord[1][1]) - band->coord[1][0] + yy0;
+                    for (bandno = 0; bandno < reslevel->nbands ; bandno++){
+                        Jpeg2000Band *band = reslevel->band + bandno;
+                        Jpeg2000Prec *prec = band->prec; // we support only 1 precinct per band ATM in the encoder
+                        int cblkx, cblky, cblkno=0, xx0, x0, xx1, y0, yy0, yy1;
+                        yy0 = bandno == 0 ? 0 : comp->reslevel[reslevelno-1].coord[1][1] - comp->reslevel[reslevelno-1].coord[1][0];
+                        y0 = yy0;
+                        yy1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[1][0] + 1, band->log2_cblk_height) << band->log2_cblk_height,
+                                    band->coord[1][1]) - band->coord[1][0] + yy0;
 
-                if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
-                    continue;
+                        if (band->coord[0][0] == band->coord[0][1] || band->coord[1][0] == band->coord[1][1])
+                            continue;
 
-                bandpos = bandno + (reslevelno > 0);
-
-                for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
-                    if (reslevelno == 0 || bandno == 1)
-                        xx0 = 0;
-                    else
-                        xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
-                    x0 = xx0;
-                    xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
-                                band->coord[0][1]) - band->coord[0][0] + xx0;
-
-                    for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
-                        int y, x;
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr++ = comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] * (1 << NMSEDEC_FRACBITS);
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y++){
-                                int *ptr = t1.data + (y-yy0)*t1.stride;
-                                for (x = xx0; x < xx1; x++){
-                                    *ptr = (comp->i_data[(comp->coord[0][1] - comp->coord[0][0]) * y + x]);
-                                    *ptr = (int64_t)*ptr * (int64_t)(16384 * 65536 / band->i_stepsize) >> 15 - NMSEDEC_FRACBITS;
-                                    ptr++;
+                        for (cblky = 0; cblky < prec->nb_codeblocks_height; cblky++){
+                            if (reslevelno == 0 || bandno == 1)
+                                xx0 = 0;
+                            else
+                                xx0 = comp->reslevel[reslevelno-1].coord[0][1] - comp->reslevel[reslevelno-1].coord[0][0];
+                            x0 = xx0;
+                            xx1 = FFMIN(ff_jpeg2000_ceildivpow2(band->coord[0][0] + 1, band->log2_cblk_width) << band->log2_cblk_width,
+                                        band->coord[0][1]) - band->coord[0][0] + xx0;
+
+                            for (cblkx = 0; cblkx < prec->nb_codeblocks_width; cblkx++, cblkno++){
+                                if (pass) {
+                                    Jpeg2000EncCblk *job = &s->cblks[s->nb_cblks];
+                                    Jpeg2000Cblk *cblk = prec->cblk + cblkno;
+
+                                    job->tile    = tile;
+                                    job->comp    = comp;
+                                    job->band    = band;
+                                    job->cblk    = cblk;
+                                    job->x0      = xx0;
+                                    job->y0      = yy0;
+                                    job->x1      = xx1;
+                                    job->y1      = yy1;
+                                    job->bandpos = bandno + (reslevelno > 0);
+                                    job->lev     = codsty->nreslevels - reslevelno - 1;
+
+                                    cblk->data   = av_malloc(1 + 8192);
+                                    cblk->passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*cblk->passes));
+                                    if (!cblk->data || !cblk->passes)
+                                        return AVERROR(ENOMEM);
                                 }
+                                s->nb_cblks++;
+                                xx0 = xx1;
+                                xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
                             }
+                            yy0 = yy1;
+                            yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
                         }
-                        if (!prec->cblk[cblkno].data)
-                            prec->cblk[cblkno].data = av_malloc(1 + 8192);
-                        if (!prec->cblk[cblkno].passes)
-                            prec->cblk[cblkno].passes = av_malloc_array(JPEG2000_MAX_PASSES, sizeof (*prec->cblk[cblkno].passes));
-                        if (!prec->cblk[cblkno].data || !prec->cblk[cblkno].passes)
-                            return AVERROR(ENOMEM);
-                        encode_cblk(s, &t1, prec->cblk + cblkno, tile, xx1 - xx0, yy1 - yy0,
-                                    bandpos, codsty->nreslevels - reslevelno - 1);
-                        xx0 = xx1;
-                        xx1 = FFMIN(xx1 + (1 << band->log2_cblk_width), band->coord[0][1] - band->coord[0][0] + x0);
                     }
-                    yy0 = yy1;
-                    yy1 = FFMIN(yy1 + (1 << band->log2_cblk_height), band->coord[1][1] - band->coord[1][0] + y0);
                 }
             }
         }
-        av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+        if (!pass) {
+            s->cblks = av_calloc(s->nb_cblks, sizeof(*s->cblks));
+            if (!s->cblks)
+                return AVERROR(ENOMEM);
+        }
     }
+    return 0;
+}
+
+static int encode_tile(Jpeg2000EncoderContext *s, Jpeg2000Tile *tile, int tileno)
+{
+    int ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "rate control\n");
     if (s->compression_rate_enc)
@@ -1498,6 +1561,7 @@ static void cleanup(Jpeg2000EncoderContext *s)
     int tileno, compno;
     Jpeg2000CodingStyle *codsty = &s->codsty;
 
+    av_freep(&s->cblks);
     if (!s->tile)
         return;
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++){
@@ -1554,6 +1618,15 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     reinit(s);
 
+    /* the tile-components are transformed and the codeblocks coded in
+     * parallel with slice threads, the rate control and tier-2 coding are
+     * done per tile in order */
+    av_log(s->avctx, AV_LOG_DEBUG, "dwt\n");
+    avctx->execute2(avctx, dwt_job, NULL, NULL, s->numXtiles * s->numYtiles * s->ncomponents);
+    av_log(s->avctx, AV_LOG_DEBUG, "after dwt -> tier1\n");
+    avctx->execute2(avctx, encode_cblk_job, NULL, NULL, s->nb_cblks);
+    av_log(s->avctx, AV_LOG_DEBUG, "after tier1\n");
+
     if (s->format == CODEC_JP2) {
         av_assert0(s->buf == pkt->data);
 
@@ -1788,6 +1861,8 @@ static av_cold int j2kenc_init(AVCodecContext *avctx)
     init_quantization(s);
     if ((ret=init_tiles(s)) < 0)
         return ret;
+    if ((ret = init_cblks(s)) < 0)
+        return ret;
 
     av_log(s->avctx, AV_LOG_DEBUG, "after init\n");
 
@@ -1840,7 +1915,7 @@ const FFCodec ff_jpeg2000_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_JPEG2000,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE |
-                      AV_CODEC_CAP_FRAME_THREADS,
+                      AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(Jpeg2000EncoderContext),
     .init           = j2kenc_init,
     FF_CODEC_ENCODE_CB(encode_frame),
@@ -2214,95 +2214,150 @@ static inline void mct_decode(const Jpeg2000DecoderContext *s, Jpeg2000Tile *til
 }
 
 
-static inline int tile_codeblocks(const Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
+/**
+ * List the codeblocks of all the tiles for decode_cblk_job().
+ */
+static int init_cblk_jobs(Jpeg2000DecoderContext *s)
 {
-    Jpeg2000T1Context t1;
+    int tileno, compno, reslevelno, bandno, precno, cblkno, pass;
 
-    int compno, reslevelno, bandno;
+    for (pass = 0; pass < 2; pass++) {
+        s->nb_cblk_jobs = 0;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+            Jpeg2000Tile *tile = s->tile + tileno;
 
-    /* Loop on tile components */
-    for (compno = 0; compno < s->ncomponents; compno++) {
-        Jpeg2000Component *comp      = tile->comp   + compno;
-        Jpeg2000CodingStyle *codsty  = tile->codsty + compno;
-        Jpeg2000QuantStyle *quantsty = tile->qntsty + compno;
-
-        int coded = 0;
-        int subbandno = 0;
-
-        t1.stride = (1<<codsty->log2_cblk_width) + 2;
-
-        /* Loop on resolution levels */
-        for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
-            Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
-            /* Loop on bands */
-            for (bandno = 0; bandno < rlevel->nbands; bandno++, subbandno++) {
-                int nb_precincts, precno;
-                Jpeg2000Band *band = rlevel->band + bandno;
-                int cblkno = 0, bandpos;
-                /* See Rec. ITU-T T.800, Equation E-2 */
-                int M_b = quantsty->expn[subbandno] + quantsty->nguardbits - 1;
-
-                bandpos = bandno + (reslevelno > 0);
-
-                if (band->coord[0][0] == band->coord[0][1] ||
-                    band->coord[1][0] == band->coord[1][1])
-                    continue;
+            if (!pass) {
+                memset(tile->coded, 0, sizeof(tile->coded));
+                tile->status = 0;
+            } else if (tile->status < 0) {
+                continue;
+            }
 
-                if ((codsty->cblk_style & JPEG2000_CTSY_HTJ2K_F) && M_b >= 31) {
-                    avpriv_request_sample(s->avctx, "JPEG2000_CTSY_HTJ2K_F and M_b >= 31");
-                    return AVERROR_PATCHWELCOME;
-                }
+            /* Loop on tile components */
+            for (compno = 0; compno < s->ncomponents && tile->status >= 0; compno++) {
+                Jpeg2000Component *comp      = tile->comp   + compno;
+                Jpeg2000CodingStyle *codsty  = tile->codsty + compno;
+                Jpeg2000QuantStyle *quantsty = tile->qntsty + compno;
+                int subbandno = 0;
 
-                nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
-                /* Loop on precincts */
-                for (precno = 0; precno < nb_precincts; precno++) {
-                    Jpeg2000Prec *prec = band->prec + precno;
-
-                    /* Loop on codeblocks */
-                    for (cblkno = 0;
-                         cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
-                         cblkno++) {
-                        int x, y, ret;
-
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-
-                        if (cblk->modes & JPEG2000_CTSY_HTJ2K_F)
-                            ret = ff_jpeg2000_decode_htj2k(s, codsty, &t1, cblk,
-                                                           cblk->coord[0][1] - cblk->coord[0][0],
-                                                           cblk->coord[1][1] - cblk->coord[1][0],
-                                                           M_b, comp->roi_shift);
-                        else
-                            ret = decode_cblk(s, codsty, &t1, cblk,
-                                              cblk->coord[0][1] - cblk->coord[0][0],
-                                              cblk->coord[1][1] - cblk->coord[1][0],
-                                              bandpos, comp->roi_shift, M_b);
-
-                        if (ret)
-                            coded = 1;
-                        else
+                /* Loop on resolution levels */
+                for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
+                    Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+                    /* Loop on bands */
+                    for (bandno = 0; bandno < rlevel->nbands; bandno++, subbandno++) {
+                        int nb_precincts;
+                        Jpeg2000Band *band = rlevel->band + bandno;
+                        /* See Rec. ITU-T T.800, Equation E-2 */
+                        int M_b = quantsty->expn[subbandno] + quantsty->nguardbits - 1;
+
+                        if (band->coord[0][0] == band->coord[0][1] ||
+                            band->coord[1][0] == band->coord[1][1])
                             continue;
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band, M_b);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band, M_b);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band, M_b);
-                   } /* end cblk */
-                } /*end prec */
-            } /* end band */
-        } /* end reslevel */
-
-        /* inverse DWT */
-        if (coded)
-            ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
-
-    } /*end comp */
+
+                        if ((codsty->cblk_style & JPEG2000_CTSY_HTJ2K_F) && M_b >= 31) {
+                            avpriv_request_sample(s->avctx, "JPEG2000_CTSY_HTJ2K_F and M_b >= 31");
+                            tile->status = AVERROR_PATCHWELCOME;
+                            break;
+                        }
+
+                        nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
+                        /* Loop on precincts */
+                        for (precno = 0; precno < nb_precincts; precno++) {
+                            Jpeg2000Prec *prec = band->prec + precno;
+
+                            /* Loop on codeblocks */
+                            for (cblkno = 0;
+                                 cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+                                 cblkno++) {
+                                if (pass) {
+                                    Jpeg2000CblkJob *job = &s->cblk_jobs[s->nb_cblk_jobs];
+
+                                    job->tile    = tile;
+                                    job->band    = band;
+                                    job->cblk    = prec->cblk + cblkno;
+                                    job->compno  = compno;
+                                    job->bandpos = bandno + (reslevelno > 0);
+                                    job->M_b     = M_b;
+                                    job->coded   = 0;
+                                }
+                                s->nb_cblk_jobs++;
+                            } /* end cblk */
+                        } /*end prec */
+                    } /* end band */
+                    if (tile->status < 0)
+                        break;
+                } /* end reslevel */
+            } /*end comp */
+        } /* end tile */
+
+        if (!pass) {
+            av_fast_malloc(&s->cblk_jobs, &s->cblk_jobs_size,
+                           s->nb_cblk_jobs * sizeof(*s->cblk_jobs));
+            if (!s->cblk_jobs)
+                return AVERROR(ENOMEM);
+        }
+    }
     return 0;
 }
 
+static int decode_cblk_job(AVCodecContext *avctx, void *td,
+                           int jobnr, int threadnr)
+{
+    const Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000CblkJob *job         = s->cblk_jobs + jobnr;
+    Jpeg2000Component *comp      = job->tile->comp   + job->compno;
+    Jpeg2000CodingStyle *codsty  = job->tile->codsty + job->compno;
+    Jpeg2000Band *band           = job->band;
+    Jpeg2000Cblk *cblk           = job->cblk;
+    Jpeg2000T1Context t1;
+    int x, y, ret;
+
+    t1.stride = (1<<codsty->log2_cblk_width) + 2;
+
+    if (cblk->modes & JPEG2000_CTSY_HTJ2K_F)
+        ret = ff_jpeg2000_decode_htj2k(s, codsty, &t1, cblk,
+                                       cblk->coord[0][1] - cblk->coord[0][0],
+                                       cblk->coord[1][1] - cblk->coord[1][0],
+                                       job->M_b, comp->roi_shift);
+    else
+        ret = decode_cblk(s, codsty, &t1, cblk,
+                          cblk->coord[0][1] - cblk->coord[0][0],
+                          cblk->coord[1][1] - cblk->coord[1][0],
+                          job->bandpos, comp->roi_shift, job->M_b);
+
+    if (!ret)
+        return 0;
+    job->coded = 1;
+
+    x = cblk->coord[0][0] - band->coord[0][0];
+    y = cblk->coord[1][0] - band->coord[1][0];
+
+    if (codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, comp, &t1, band, job->M_b);
+    else if (codsty->transform == FF_DWT97_INT)
+        dequantization_int_97(x, y, cblk, comp, &t1, band, job->M_b);
+    else
+        dequantization_int(x, y, cblk, comp, &t1, band, job->M_b);
+
+    return 0;
+}
+
+/* inverse DWT of a tile component */
+static int dwt_decode_job(AVCodecContext *avctx, void *td,
+                          int jobnr, int threadnr)
+{
+    const Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000Tile *tile          = s->tile + jobnr / s->ncomponents;
+    int compno                  = jobnr % s->ncomponents;
+    Jpeg2000Component *comp     = tile->comp   + compno;
+    Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+
+    if (tile->status < 0 || !tile->coded[compno])
+        return 0;
+
+    return ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
+}
+
 #define WRITE_FRAME(D, PIXEL)                                                                     \
     static inline void write_frame_ ## D(const Jpeg2000DecoderContext * s, Jpeg2000Tile * tile,   \
                                          AVFrame * picture, int precision)                        \
@@ -2377,9 +2432,8 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
     AVFrame *picture = td;
     Jpeg2000Tile *tile = s->tile + jobnr;
 
-    int ret = tile_codeblocks(s, tile);
-    if (ret < 0)
-        return ret;
+    if (tile->status < 0)
+        return tile->status;
 
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
@@ -2809,6 +2863,16 @@ static int jp2_find_codestream(Jpeg2000DecoderContext *s)
     return 0;
 }
 
+static av_cold int jpeg2000_decode_close(AVCodecContext *avctx)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+
+    av_freep(&s->cblk_jobs);
+    s->cblk_jobs_size = 0;
+
+    return 0;
+}
+
 static av_cold int jpeg2000_decode_init(AVCodecContext *avctx)
 {
     Jpeg2000DecoderContext *s = avctx->priv_data;
@@ -2900,6 +2964,17 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, AVFrame *picture,
         if (++x == s->ncomponents)
             picture->flags |= AV_FRAME_FLAG_LOSSLESS;
 
+    if ((ret = init_cblk_jobs(s)) < 0)
+        goto end;
+
+    /* The codeblocks of all the tiles are decoded in parallel, then the
+     * tile components are transformed and the tiles written. */
+    avctx->execute2(avctx, decode_cblk_job, NULL, NULL, s->nb_cblk_jobs);
+    for (int i = 0; i < s->nb_cblk_jobs; i++)
+        if (s->cblk_jobs[i].coded)
+            s->cblk_jobs[i].tile->coded[s->cblk_jobs[i].compno] = 1;
+    avctx->execute2(avctx, dwt_decode_job, NULL, NULL,
+                    s->numXtiles * s->numYtiles * s->ncomponents);
     avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
 
     jpeg2000_dec_cleanup(s);
@@ -2941,6 +3016,7 @@ const FFCodec ff_jpeg2000_decoder = {
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init             = jpeg2000_decode_init,
     FF_CODEC_DECODE_CB(jpeg2000_decode_frame),
+    .close            = jpeg2000_decode_close,
     .p.priv_class     = &jpeg2000_class,
     .p.max_lowres     = 5,
     .p.profiles       = NULL_IF_CONFIG_SMALL(ff_jpeg2000_profiles),
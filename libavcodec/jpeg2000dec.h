@@ -68,8 +68,21 @@ typedef struct Jpeg2000Tile {
     GetByteContext      packed_headers_stream;  // byte context corresponding to packed headers
     uint16_t tp_idx;                    // Tile-part index
     int coord[2][2];                    // border coordinates {{x0, x1}, {y0, y1}}
+    uint8_t             coded[4];               // whether a codeblock of the component was decoded
+    int                 status;                 // < 0 if the codeblocks of the tile cannot be decoded
 } Jpeg2000Tile;
 
+/* Codeblock decoded by a slice thread job */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Tile *tile;
+    Jpeg2000Band *band;
+    Jpeg2000Cblk *cblk;
+    int compno;
+    int bandpos;
+    int M_b;
+    int coded;
+} Jpeg2000CblkJob;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -111,6 +124,10 @@ typedef struct Jpeg2000DecoderContext {
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    Jpeg2000CblkJob *cblk_jobs;     // codeblocks of all the tiles, decoded in parallel
+    unsigned        cblk_jobs_size;
+    int             nb_cblk_jobs;
+
     uint8_t         isHT; // HTJ2K?
     uint8_t         Ccap15_b14_15; // HTONLY(= 0) or HTDECLARED(= 1) or MIXED(= 3) ?
     uint8_t         Ccap15_b12; // RGNFREE(= 0) or RGN(= 1)?
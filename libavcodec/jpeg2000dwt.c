@@ -25,6 +25,9 @@
  * Discrete wavelet transform
  */
 
+#include <string.h>
+
+#include "libavutil/common.h"
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
@@ -46,6 +49,41 @@
 #define I_LFTG_K             80621ll
 #define I_LFTG_X             53274ll
 
+/* The 9/7 vertical passes transform strips of STRIP_WIDTH columns at once,
+ * one row of the strip per line buffer entry, so that the lifting steps
+ * work on rows. */
+#define STRIP_WIDTH 16
+#define ROW(p, i) ((p) + (i) * STRIP_WIDTH)
+
+/* lifting steps on the rows of a strip */
+static inline void lift_float(float *dst, const float *src0, const float *src1,
+                              float coeff)
+{
+    for (int i = 0; i < STRIP_WIDTH; i++)
+        dst[i] += coeff * (src0[i] + src1[i]);
+}
+
+static inline void lift_int(int32_t *dst, const int32_t *src0, const int32_t *src1,
+                            int coeff)
+{
+    const int64_t c = FFABS(coeff);
+
+    for (int i = 0; i < STRIP_WIDTH; i++) {
+        const int64_t v = (c * (src0[i] + (int64_t)src1[i]) + (1 << 15)) >> 16;
+        dst[i] += coeff < 0 ? -v : v;
+    }
+}
+
+static inline void extend97_rows(void *p, int i0, int i1, size_t size)
+{
+    int i;
+
+    for (i = 1; i <= 4; i++) {
+        memcpy((uint8_t *)p + (i0 - i)     * size, (uint8_t *)p + (i0 + i)     * size, size);
+        memcpy((uint8_t *)p + (i1 + i - 1) * size, (uint8_t *)p + (i1 - i - 1) * size, size);
+    }
+}
+
 static inline void extend53(int *p, int i0, int i1)
 {
     p[i0 - 1] = p[i0 + 1];
@@ -246,6 +284,37 @@ static void sd_1d97_int(int *p, int i0, int i1)
         p[2 * i]     += (I_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]) + (1 << 15)) >> 16;
 }
 
+/* sd_1d97_int() on the rows of a strip */
+static void sd_1d97_int_v(int32_t *p, int i0, int i1)
+{
+    int i;
+
+    if (i1 <= i0 + 1) {
+        for (i = 0; i < STRIP_WIDTH; i++) {
+            if (i0 == 1)
+                ROW(p, 1)[i] = (ROW(p, 1)[i] * I_LFTG_X + (1<<14)) >> 15;
+            else
+                ROW(p, 0)[i] = (ROW(p, 0)[i] * I_LFTG_K + (1<<15)) >> 16;
+        }
+        return;
+    }
+
+    extend97_rows(p, i0, i1, STRIP_WIDTH * sizeof(*p));
+    i0++; i1++;
+
+    for (i = (i0>>1) - 2; i < (i1>>1) + 1; i++) {
+        /* alpha = 1 + alpha' */
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i), ROW(p, 2 * i + 2), -(1 << 16));
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i), ROW(p, 2 * i + 2), -I_LFTG_ALPHA_PRIME);
+    }
+    for (i = (i0>>1) - 1; i < (i1>>1) + 1; i++)
+        lift_int(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), -I_LFTG_BETA);
+    for (i = (i0>>1) - 1; i < (i1>>1); i++)
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), I_LFTG_GAMMA);
+    for (i = (i0>>1); i < (i1>>1); i++)
+        lift_int(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), I_LFTG_DELTA);
+}
+
 static void dwt_encode97_int(DWTContext *s, int *t)
 {
     int lev;
@@ -253,6 +322,7 @@ static void dwt_encode97_int(DWTContext *s, int *t)
     int h = s->linelen[s->ndeclevels-1][1];
     int i;
     int *line = s->i_linebuf;
+    int32_t *strip = s->i_linebuf + 5 * STRIP_WIDTH;
     line += 5;
 
     for (i = 0; i < w * h; i++)
@@ -267,20 +337,21 @@ static void dwt_encode97_int(DWTContext *s, int *t)
         int *l;
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        l = ROW(strip, mv);
+        for (lp = 0; lp < lh; lp += STRIP_WIDTH) {
+            const size_t size = FFMIN(STRIP_WIDTH, lh - lp) * sizeof(*t);
             int i, j = 0;
 
             for (i = 0; i < lv; i++)
-                l[i] = t[w*i + lp];
+                memcpy(ROW(l, i), &t[w*i + lp], size);
 
-            sd_1d97_int(line, mv, mv + lv);
+            sd_1d97_int_v(strip, mv, mv + lv);
 
             // copy back and deinterleave
             for (i =   mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(&t[w*j + lp], ROW(l, i), size);
             for (i = 1-mv; i < lv; i+=2, j++)
-                t[w*j + lp] = l[i];
+                memcpy(&t[w*j + lp], ROW(l, i), size);
         }
 
         // HOR_SD
@@ -400,11 +471,42 @@ static void sr_1d97_float(float *p, int i0, int i1)
         p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
 }
 
+/* sr_1d97_float() on the rows of a strip */
+static void sr_1d97_float_v(float *p, int i0, int i1)
+{
+    int i;
+
+    if (i1 <= i0 + 1) {
+        for (i = 0; i < STRIP_WIDTH; i++) {
+            if (i0 == 1)
+                ROW(p, 1)[i] *= F_LFTG_K/2;
+            else
+                ROW(p, 0)[i] *= F_LFTG_X;
+        }
+        return;
+    }
+
+    extend97_rows(p, i0, i1, STRIP_WIDTH * sizeof(*p));
+
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++)
+        lift_float(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), -F_LFTG_DELTA);
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++)
+        lift_float(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), -F_LFTG_GAMMA);
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
+        lift_float(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), F_LFTG_BETA);
+    /* step 6 */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++)
+        lift_float(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), F_LFTG_ALPHA);
+}
+
 static void dwt_decode97_float(DWTContext *s, float *t)
 {
     int lev;
     int w       = s->linelen[s->ndeclevels - 1][0];
     float *line = s->f_linebuf;
+    float *strip = s->f_linebuf + 5 * STRIP_WIDTH;
     float *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
     line += 5;
@@ -433,19 +535,20 @@ static void dwt_decode97_float(DWTContext *s, float *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        l = ROW(strip, mv);
+        for (lp = 0; lp < lh; lp += STRIP_WIDTH) {
+            const size_t size = FFMIN(STRIP_WIDTH, lh - lp) * sizeof(*data);
             int i, j = 0;
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), &data[w * j + lp], size);
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), &data[w * j + lp], size);
 
-            sr_1d97_float(line, mv, mv + lv);
+            sr_1d97_float_v(strip, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                memcpy(&data[w * i + lp], ROW(l, i), size);
         }
     }
 }
@@ -480,6 +583,38 @@ static void sr_1d97_int(int32_t *p, int i0, int i1)
     }
 }
 
+/* sr_1d97_int() on the rows of a strip */
+static void sr_1d97_int_v(int32_t *p, int i0, int i1)
+{
+    int i;
+
+    if (i1 <= i0 + 1) {
+        for (i = 0; i < STRIP_WIDTH; i++) {
+            if (i0 == 1)
+                ROW(p, 1)[i] = (ROW(p, 1)[i] * I_LFTG_K + (1<<16)) >> 17;
+            else
+                ROW(p, 0)[i] = (ROW(p, 0)[i] * I_LFTG_X + (1<<15)) >> 16;
+        }
+        return;
+    }
+
+    extend97_rows(p, i0, i1, STRIP_WIDTH * sizeof(*p));
+
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++)
+        lift_int(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), -I_LFTG_DELTA);
+    /* step 4 */
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++)
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), -I_LFTG_GAMMA);
+    /*step 5*/
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
+        lift_int(ROW(p, 2 * i),     ROW(p, 2 * i - 1), ROW(p, 2 * i + 1), I_LFTG_BETA);
+    /* step 6, alpha = 1 + alpha' */
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), 1 << 16);
+        lift_int(ROW(p, 2 * i + 1), ROW(p, 2 * i),     ROW(p, 2 * i + 2), I_LFTG_ALPHA_PRIME);
+    }
+}
+
 static void dwt_decode97_int(DWTContext *s, int32_t *t)
 {
     int lev;
@@ -487,6 +622,7 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
     int h       = s->linelen[s->ndeclevels - 1][1];
     int i;
     int32_t *line = s->i_linebuf;
+    int32_t *strip = s->i_linebuf + 5 * STRIP_WIDTH;
     int32_t *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
     line += 5;
@@ -515,19 +651,20 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        l = ROW(strip, mv);
+        for (lp = 0; lp < lh; lp += STRIP_WIDTH) {
+            const size_t size = FFMIN(STRIP_WIDTH, lh - lp) * sizeof(*data);
             int i, j = 0;
             // interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), &data[w * j + lp], size);
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp];
+                memcpy(ROW(l, i), &data[w * j + lp], size);
 
-            sr_1d97_int(line, mv, mv + lv);
+            sr_1d97_int_v(strip, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                memcpy(&data[w * i + lp], ROW(l, i), size);
         }
     }
 
@@ -560,12 +697,12 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
         }
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_calloc((maxlen + 12) * STRIP_WIDTH, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
      case FF_DWT97_INT:
-        s->i_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_calloc((maxlen + 12) * STRIP_WIDTH, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
@@ -577,6 +714,7 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
     default:
         return -1;
     }
+
     return 0;
 }
 
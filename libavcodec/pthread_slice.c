@@ -115,7 +115,7 @@ av_cold int ff_slice_thread_init(AVCodecContext *avctx)
     int thread_count = avctx->thread_count;
     void (*mainfunc)(void *);
 
-    if (!thread_count) {
+    if (!thread_count && !avctx->thread_pool) {
         int nb_cpus = av_cpu_count();
         if  (avctx->height)
             nb_cpus = FFMIN(nb_cpus, (avctx->height+15)/16);
@@ -126,7 +126,7 @@ av_cold int ff_slice_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = 1;
     }
 
-    if (thread_count <= 1) {
+    if (avctx->thread_pool ? thread_count == 1 : thread_count <= 1) {
         avctx->active_thread_type = 0;
         return 0;
     }
@@ -135,8 +135,12 @@ av_cold int ff_slice_thread_init(AVCodecContext *avctx)
     if (!c)
         return AVERROR(ENOMEM);
     mainfunc = ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func,
-                                             mainfunc, thread_count);
+    if (avctx->thread_pool)
+        thread_count = avpriv_slicethread_create_shared(&c->thread, avctx, worker_func,
+                                                        mainfunc, avctx->thread_pool);
+    else
+        thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func,
+                                                 mainfunc, thread_count);
     if (thread_count <= 1) {
         ff_slice_thread_free(avctx);
         avctx->thread_count = 1;
@@ -617,6 +617,21 @@ typedef struct AVFilterGraph {
     avfilter_execute_func *execute;
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
+
+    /**
+     * Thread pool shared with other contexts. May be set by the caller before
+     * adding any filters to the filtergraph. If set, filters with slice
+     * threading capability run their jobs on the threads of this pool instead
+     * of on threads private to the graph, and nb_threads is ignored unless it
+     * is 1. It is also used by the scalers created by filters of the graph.
+     *
+     * The pool must have at least one thread and must outlive the graph. Its
+     * threads are taken in turn by all the users of the pool, with no
+     * fairness between them: the latency of the graph depends on the load of
+     * the other users. Slice threading started from a job already running on
+     * the pool, e.g. by a scaler, runs on the thread of that job.
+     */
+    struct AVExecutor *thread_pool;
 } AVFilterGraph;
 
 /**
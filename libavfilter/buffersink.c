@@ -84,6 +84,8 @@ typedef struct BufferSinkContext {
     unsigned          nb_channel_layouts;
 
     AVFrame *peeked_frame;
+
+    int64_t eof_pts;                    ///< timestamp of the end of the stream
 } BufferSinkContext;
 
 int attribute_align_arg av_buffersink_get_frame(AVFilterContext *ctx, AVFrame *frame)
@@ -126,6 +128,7 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
             /* TODO return the frame instead of copying it */
             return return_or_keep_frame(buf, frame, cur_frame, flags);
         } else if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+            buf->eof_pts = pts;
             return status;
         } else if ((flags & AV_BUFFERSINK_FLAG_NO_REQUEST)) {
             return AVERROR(EAGAIN);
@@ -156,6 +159,8 @@ static av_cold int common_init(AVFilterContext *ctx)
     BufferSinkContext *buf = ctx->priv;
     int ret = 0;
 
+    buf->eof_pts = AV_NOPTS_VALUE;
+
 #if FF_API_BUFFERSINK_OPTS
 
 #define CHECK_LIST_SIZE(field) \
@@ -372,6 +377,13 @@ const AVFrameSideData *const *av_buffersink_get_side_data(const AVFilterContext
     return (const AVFrameSideData *const *)ctx->inputs[0]->side_data;
 }
 
+int64_t av_buffersink_get_eof_pts(const AVFilterContext *ctx)
+{
+    const BufferSinkContext *buf = ctx->priv;
+    av_assert0(fffilter(ctx->filter)->activate == activate);
+    return buf->eof_pts;
+}
+
 #if FF_API_BUFFERSINK_OPTS
 #define NB_ITEMS(list) (list ## _size / sizeof(*list))
 #endif
@@ -126,6 +126,15 @@ AVBufferRef *    av_buffersink_get_hw_frames_ctx       (const AVFilterContext *c
 const AVFrameSideData *const *av_buffersink_get_side_data(const AVFilterContext *ctx,
                                                           int *nb_side_data);
 
+/**
+ * Get the timestamp at which the stream ended, in the time base of the sink.
+ * It may be later than the end of the last frame, e.g. after setpts.
+ *
+ * @return the timestamp, or AV_NOPTS_VALUE if the end of the stream was not
+ *         returned yet by av_buffersink_get_frame_flags() or had no timestamp
+ */
+int64_t av_buffersink_get_eof_pts(const AVFilterContext *ctx);
+
 /** @} */
 
 /**
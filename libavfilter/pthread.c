@@ -71,9 +71,17 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+static int thread_init_internal(ThreadContext *c, AVFilterGraph *graph)
 {
-    nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
+    int nb_threads;
+
+    c->graph = graph;
+    if (graph->thread_pool)
+        nb_threads = avpriv_slicethread_create_shared(&c->thread, c, worker_func, NULL,
+                                                      graph->thread_pool);
+    else
+        nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL,
+                                               graph->nb_threads);
     if (nb_threads <= 1)
         avpriv_slicethread_free(&c->thread);
     return FFMAX(nb_threads, 1);
@@ -93,7 +101,7 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
     if (!graphi->thread)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graphi->thread, graph->nb_threads);
+    ret = thread_init_internal(graphi->thread, graph);
     if (ret <= 1) {
         av_freep(&graphi->thread);
         graph->thread_type = 0;
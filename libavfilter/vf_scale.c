@@ -424,6 +424,7 @@ static av_cold int init(AVFilterContext *ctx)
     // use generic thread-count if the user did not set it explicitly
     if (!scale->sws->threads)
         scale->sws->threads = ff_filter_get_nb_threads(ctx);
+    scale->sws->thread_pool = ctx->graph->thread_pool;
 
     if (!IS_SCALE2REF(ctx) && scale->uses_ref) {
         AVFilterPad pad = {
@@ -0,0 +1,603 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "asyncwriter.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+enum AsyncWriterJobType {
+    JOB_WRITE,
+    JOB_APPEND,
+    JOB_RENAME,
+    JOB_DELETE,
+};
+
+/* a file kept open on the writer thread, see ff_async_writer_open_stream() */
+typedef struct AsyncWriterStream {
+    AVIOContext *pb;
+    int error;              ///< set if opening the file failed
+} AsyncWriterStream;
+
+typedef struct AsyncWriterJob {
+    enum AsyncWriterJobType type;
+    char *url;
+    char *url_dst;
+    AVDictionary *options;
+    int has_options;
+    uint8_t *data;
+    int size;
+    AsyncWriterStream *stream; ///< file appended to, owned by its last job
+    int close;                 ///< close the stream after appending
+    struct AsyncWriterJob *next;
+} AsyncWriterJob;
+
+/* a file being buffered, until it is closed */
+typedef struct AsyncWriterFile {
+    AVIOContext *pb;
+    AVIOContext **owner;
+    char *url;
+    AVDictionary *options;
+    AsyncWriterStream *stream;
+} AsyncWriterFile;
+
+struct FFAsyncWriter {
+    AVFormatContext *s;
+    FFAsyncWriterOpen  io_open;
+    FFAsyncWriterClose io_close;
+    AVIOContext *pb;        ///< used on the writer thread, may be kept open by io_close
+
+    AsyncWriterFile *files;
+    int nb_files;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    AsyncWriterJob *first, *last;
+    int nb_jobs;            ///< queued jobs, including the one being done
+    int queue_size;
+    int error;
+    int abort_request;
+};
+
+static void free_stream(FFAsyncWriter *w, AsyncWriterStream **pstream)
+{
+    if (*pstream)
+        ff_format_io_close(w->s, &(*pstream)->pb);
+    av_freep(pstream);
+}
+
+static void free_job(AsyncWriterJob **pjob)
+{
+    AsyncWriterJob *job = *pjob;
+
+    if (!job)
+        return;
+    av_freep(&job->url);
+    av_freep(&job->url_dst);
+    av_dict_free(&job->options);
+    av_freep(&job->data);
+    av_freep(pjob);
+}
+
+static int default_io_open(AVFormatContext *s, AVIOContext **pb,
+                           const char *url, AVDictionary **options)
+{
+    return s->io_open(s, pb, url, AVIO_FLAG_WRITE, options);
+}
+
+static int default_io_close(AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    return ff_format_io_close(s, pb);
+}
+
+/* Make a complete local file durable before the operations queued after
+ * it, e.g. the rename publishing a playlist which lists it. */
+static int sync_file(AVIOContext *pb)
+{
+#if HAVE_UNISTD_H && !defined(_WIN32)
+    URLContext *h;
+    int fd;
+
+    avio_flush(pb);
+    if (pb->error < 0)
+        return pb->error;
+    h  = ffio_geturlcontext(pb);
+    fd = h ? ffurl_get_file_handle(h) : -1;
+    if (fd >= 0 && fsync(fd) < 0 && errno != EINVAL)
+        return AVERROR(errno);
+#endif
+    return 0;
+}
+
+static int write_file(FFAsyncWriter *w, AsyncWriterJob *job)
+{
+    AVFormatContext *s = w->s;
+    int ret, err;
+
+    for (int retry = 0; retry < 2; retry++) {
+        AVDictionary *options = NULL;
+
+        if (retry) {
+            av_log(s, AV_LOG_WARNING, "Writing '%s' failed, "
+                   "retrying with a new connection.\n", job->url);
+            ff_format_io_close(s, &w->pb);
+        }
+
+        ret = av_dict_copy(&options, job->options, 0);
+        if (ret >= 0)
+            ret = w->io_open(s, &w->pb, job->url, job->has_options ? &options : NULL);
+        av_dict_free(&options);
+        if (ret < 0)
+            continue;
+        if (job->size)
+            avio_write(w->pb, job->data, job->size);
+        ret = sync_file(w->pb);
+        err = w->io_close(s, &w->pb, job->url);
+        if (ret >= 0)
+            ret = err;
+        if (ret >= 0)
+            break;
+    }
+    return ret;
+}
+
+static int append_file(FFAsyncWriter *w, AsyncWriterJob *job)
+{
+    AsyncWriterStream *stream = job->stream;
+    int ret = 0;
+
+    if (!stream->pb && !stream->error) {
+        AVDictionary *options = NULL;
+
+        ret = av_dict_copy(&options, job->options, 0);
+        if (ret >= 0)
+            ret = w->io_open(w->s, &stream->pb, job->url,
+                             job->has_options ? &options : NULL);
+        av_dict_free(&options);
+        /* only report the failure once */
+        if (ret < 0)
+            stream->error = 1;
+    }
+    if (stream->pb && job->size) {
+        avio_write(stream->pb, job->data, job->size);
+        avio_flush(stream->pb);
+        ret = stream->pb->error;
+    }
+    if (job->close) {
+        if (stream->pb) {
+            int err = sync_file(stream->pb);
+            if (err < 0 && ret >= 0)
+                ret = err;
+            err = w->io_close(w->s, &stream->pb, job->url);
+            if (err < 0 && ret >= 0)
+                ret = err;
+        }
+        free_stream(w, &job->stream);
+    }
+    return ret;
+}
+
+static int run_job(FFAsyncWriter *w, AsyncWriterJob *job)
+{
+    int ret;
+
+    switch (job->type) {
+    case JOB_WRITE:
+    case JOB_APPEND:
+        ret = job->stream ? append_file(w, job) : write_file(w, job);
+        if (ret < 0)
+            av_log(w->s, AV_LOG_ERROR, "Failed to write '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return ret;
+    case JOB_RENAME:
+        return ff_rename(job->url, job->url_dst, w->s);
+    case JOB_DELETE:
+        if (job->has_options)
+            return write_file(w, job);
+        /* a file left behind is not an output error */
+        ret = ffurl_delete(job->url);
+        if (ret < 0)
+            av_log(w->s, AV_LOG_ERROR, "Failed to delete '%s': %s\n",
+                   job->url, av_err2str(ret));
+        return 0;
+    }
+    return AVERROR_BUG;
+}
+
+static void *writer_thread(void *arg)
+{
+    FFAsyncWriter *w = arg;
+
+    ff_thread_setname("asyncwriter");
+
+    pthread_mutex_lock(&w->mutex);
+    for (;;) {
+        AsyncWriterJob *job = w->first;
+        int ret;
+
+        if (!job) {
+            if (w->abort_request)
+                break;
+            pthread_cond_wait(&w->cond, &w->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&w->mutex);
+
+        /* the job stays queued while running, for ff_async_writer_flush() */
+        ret = run_job(w, job);
+
+        pthread_mutex_lock(&w->mutex);
+        if (ret < 0 && !w->error)
+            w->error = ret;
+        w->first = job->next;
+        if (!w->first)
+            w->last = NULL;
+        w->nb_jobs--;
+        free_job(&job);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->mutex);
+
+    ff_format_io_close(w->s, &w->pb);
+    return NULL;
+}
+
+int ff_async_writer_alloc(FFAsyncWriter **pw, AVFormatContext *s, int queue_size,
+                          FFAsyncWriterOpen io_open, FFAsyncWriterClose io_close)
+{
+    FFAsyncWriter *w = av_mallocz(sizeof(*w));
+    int ret;
+
+    *pw = NULL;
+    if (!w)
+        return AVERROR(ENOMEM);
+    w->s          = s;
+    w->queue_size = FFMAX(queue_size, 1);
+    w->io_open    = io_open  ? io_open  : default_io_open;
+    w->io_close   = io_close ? io_close : default_io_close;
+
+    ret = pthread_mutex_init(&w->mutex, NULL);
+    if (ret) {
+        av_free(w);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&w->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&w->mutex);
+        av_free(w);
+        return AVERROR(ret);
+    }
+    ret = pthread_create(&w->thread, NULL, writer_thread, w);
+    if (ret) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+        av_free(w);
+        return AVERROR(ret);
+    }
+
+    *pw = w;
+    return 0;
+}
+
+void ff_async_writer_free(FFAsyncWriter **pw)
+{
+    FFAsyncWriter *w = *pw;
+
+    if (!w)
+        return;
+
+    pthread_mutex_lock(&w->mutex);
+    w->abort_request = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->thread, NULL);
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+
+    for (int i = 0; i < w->nb_files; i++) {
+        if (*w->files[i].owner == w->files[i].pb)
+            *w->files[i].owner = NULL;
+        ffio_free_dyn_buf(&w->files[i].pb);
+        av_freep(&w->files[i].url);
+        av_dict_free(&w->files[i].options);
+        /* the writer thread is done with the streams */
+        free_stream(w, &w->files[i].stream);
+    }
+    av_freep(&w->files);
+    av_freep(pw);
+}
+
+static void wait_idle(FFAsyncWriter *w)
+{
+    pthread_mutex_lock(&w->mutex);
+    while (w->nb_jobs)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/* queue a job, taking ownership of it */
+static int queue_job(FFAsyncWriter *w, AsyncWriterJob *job)
+{
+    int ret;
+
+    pthread_mutex_lock(&w->mutex);
+    while (w->nb_jobs >= w->queue_size)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    if (w->last)
+        w->last->next = job;
+    else
+        w->first = job;
+    w->last = job;
+    w->nb_jobs++;
+    ret = w->error;
+    w->error = 0;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    return ret;
+}
+
+static AsyncWriterJob *alloc_job(enum AsyncWriterJobType type, const char *url,
+                                 const char *url_dst, AVDictionary **options)
+{
+    AsyncWriterJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return NULL;
+    job->type = type;
+    job->url  = av_strdup(url);
+    if (url_dst)
+        job->url_dst = av_strdup(url_dst);
+    if (options) {
+        job->has_options = 1;
+        if (av_dict_copy(&job->options, *options, 0) < 0)
+            goto fail;
+    }
+    if (!job->url || (url_dst && !job->url_dst))
+        goto fail;
+    return job;
+fail:
+    free_job(&job);
+    return NULL;
+}
+
+static int open_file(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                     AVDictionary **options, int stream)
+{
+    AsyncWriterFile *file;
+    int ret;
+
+    file = av_dynarray2_add((void **)&w->files, &w->nb_files, sizeof(*w->files), NULL);
+    if (!file)
+        return AVERROR(ENOMEM);
+    memset(file, 0, sizeof(*file));
+
+    file->url = av_strdup(url);
+    if (!file->url) {
+        w->nb_files--;
+        return AVERROR(ENOMEM);
+    }
+    if (options) {
+        ret = av_dict_copy(&file->options, *options, 0);
+        if (ret < 0)
+            goto fail;
+    }
+    if (stream) {
+        file->stream = av_mallocz(sizeof(*file->stream));
+        if (!file->stream) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    ret = avio_open_dyn_buf(&file->pb);
+    if (ret < 0)
+        goto fail;
+
+    file->owner = pb;
+    *pb = file->pb;
+    return 0;
+fail:
+    av_freep(&file->url);
+    av_dict_free(&file->options);
+    av_freep(&file->stream);
+    w->nb_files--;
+    return ret;
+}
+
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    return open_file(w, pb, url, options, 0);
+}
+
+int ff_async_writer_open_stream(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                                AVDictionary **options)
+{
+    return open_file(w, pb, url, options, 1);
+}
+
+static AsyncWriterFile *find_file(FFAsyncWriter *w, AVIOContext *pb)
+{
+    for (int i = 0; i < w->nb_files; i++)
+        if (w->files[i].pb == pb)
+            return &w->files[i];
+    return NULL;
+}
+
+int ff_async_writer_sync(FFAsyncWriter *w, AVIOContext *pb)
+{
+    AsyncWriterFile *file = find_file(w, pb);
+    AsyncWriterJob *job;
+    uint8_t *data;
+    int size;
+
+    if (!file || !file->stream)
+        return AVERROR_BUG;
+
+    size = avio_get_dyn_buf(pb, &data);
+    if (!size)
+        return 0;
+
+    job = alloc_job(JOB_APPEND, file->url, NULL, &file->options);
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->data = av_memdup(data, size);
+    if (!job->data) {
+        free_job(&job);
+        return AVERROR(ENOMEM);
+    }
+    job->size   = size;
+    job->stream = file->stream;
+    ffio_reset_dyn_buf(pb);
+
+    return queue_job(w, job);
+}
+
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb)
+{
+    AsyncWriterFile file, *f;
+    AsyncWriterJob *job;
+
+    if (!*pb)
+        return 0;
+
+    f = find_file(w, *pb);
+    if (!f)
+        return AVERROR_BUG;
+    file = *f;
+    *f = w->files[--w->nb_files];
+    *pb = NULL;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        ffio_free_dyn_buf(&file.pb);
+        av_free(file.url);
+        av_dict_free(&file.options);
+        /* the appends still queued use the stream */
+        wait_idle(w);
+        free_stream(w, &file.stream);
+        return AVERROR(ENOMEM);
+    }
+    job->type        = file.stream ? JOB_APPEND : JOB_WRITE;
+    job->url         = file.url;
+    job->options     = file.options;
+    job->has_options = 1;
+    job->size        = avio_close_dyn_buf(file.pb, &job->data);
+    job->stream      = file.stream;
+    job->close       = 1;
+
+    return queue_job(w, job);
+}
+
+int ff_async_writer_rename(FFAsyncWriter *w, const char *url_src, const char *url_dst)
+{
+    AsyncWriterJob *job = alloc_job(JOB_RENAME, url_src, url_dst, NULL);
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    return queue_job(w, job);
+}
+
+int ff_async_writer_delete(FFAsyncWriter *w, const char *url, AVDictionary **options)
+{
+    AsyncWriterJob *job = alloc_job(JOB_DELETE, url, NULL, options);
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    return queue_job(w, job);
+}
+
+int ff_async_writer_flush(FFAsyncWriter *w)
+{
+    int ret;
+
+    wait_idle(w);
+    pthread_mutex_lock(&w->mutex);
+    ret = w->error;
+    w->error = 0;
+    pthread_mutex_unlock(&w->mutex);
+
+    return ret;
+}
+
+#else
+
+int ff_async_writer_alloc(FFAsyncWriter **pw, AVFormatContext *s, int queue_size,
+                          FFAsyncWriterOpen io_open, FFAsyncWriterClose io_close)
+{
+    *pw = NULL;
+    return AVERROR(ENOSYS);
+}
+
+void ff_async_writer_free(FFAsyncWriter **pw)
+{
+}
+
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_open_stream(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                                AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_sync(FFAsyncWriter *w, AVIOContext *pb)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_rename(FFAsyncWriter *w, const char *url_src, const char *url_dst)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_delete(FFAsyncWriter *w, const char *url, AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_flush(FFAsyncWriter *w)
+{
+    return AVERROR(ENOSYS);
+}
+
+#endif /* HAVE_THREADS */
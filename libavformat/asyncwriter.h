@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_ASYNCWRITER_H
+#define AVFORMAT_ASYNCWRITER_H
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * Background writer of the output files of the segmenting muxers.
+ *
+ * The files are buffered in memory while the muxer writes them, then
+ * opened, written and closed on a background thread when the muxer closes
+ * them. The renames and deletions are done on the same thread, and all the
+ * operations are done in the order they were queued: a playlist closed
+ * after a segment is thus only written once the segment is complete. Local
+ * files are synced to disk before being closed, so that a segment is also
+ * durable before a playlist listing it is renamed into place.
+ *
+ * Queuing an operation only blocks when queue_size operations are pending.
+ *
+ * The files are opened and closed on the background thread, with the io_open
+ * and io_close functions given to ff_async_writer_alloc(). These must thus
+ * be usable from another thread than the one muxing, e.g. s->io_open() and
+ * s->io_close2() when they are used by default. They are never called
+ * concurrently with each other.
+ */
+typedef struct FFAsyncWriter FFAsyncWriter;
+
+/**
+ * Functions used on the background thread to open and close the files,
+ * s->io_open() and ff_format_io_close() if NULL.
+ */
+typedef int (*FFAsyncWriterOpen)(AVFormatContext *s, AVIOContext **pb,
+                                 const char *url, AVDictionary **options);
+typedef int (*FFAsyncWriterClose)(AVFormatContext *s, AVIOContext **pb,
+                                  const char *url);
+
+/**
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available, or
+ *         another negative error code
+ */
+int ff_async_writer_alloc(FFAsyncWriter **pw, AVFormatContext *s, int queue_size,
+                          FFAsyncWriterOpen io_open, FFAsyncWriterClose io_close);
+
+/**
+ * Wait for the pending operations and free the writer. The buffers still
+ * open are discarded, and the pointers they were opened in set to NULL.
+ */
+void ff_async_writer_free(FFAsyncWriter **pw);
+
+/**
+ * Open a memory buffer for the file url in *pb.
+ */
+int ff_async_writer_open(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                         AVDictionary **options);
+
+/**
+ * Open a memory buffer for the file url in *pb, for a file which is only
+ * appended to. The file is opened by the first operation queued with
+ * ff_async_writer_sync(), and stays open until the buffer is closed with
+ * ff_async_writer_close().
+ */
+int ff_async_writer_open_stream(FFAsyncWriter *w, AVIOContext **pb, const char *url,
+                                AVDictionary **options);
+
+/**
+ * Queue appending the data written to a buffer opened with
+ * ff_async_writer_open_stream() since the previous call to the file.
+ */
+int ff_async_writer_sync(FFAsyncWriter *w, AVIOContext *pb);
+
+/**
+ * Close a buffer opened with ff_async_writer_open() and queue writing it.
+ * For a buffer opened with ff_async_writer_open_stream(), queue appending the
+ * remaining data and closing the file.
+ *
+ * This and the other queuing functions return the error of a previously
+ * failed operation, once.
+ */
+int ff_async_writer_close(FFAsyncWriter *w, AVIOContext **pb);
+
+/**
+ * Queue a rename with ff_rename().
+ */
+int ff_async_writer_rename(FFAsyncWriter *w, const char *url_src, const char *url_dst);
+
+/**
+ * Queue the deletion of url: an empty request with options, e.g. an HTTP
+ * DELETE request, if options is not NULL, else ffurl_delete(). Failing to
+ * delete a file is only logged.
+ */
+int ff_async_writer_delete(FFAsyncWriter *w, const char *url, AVDictionary **options);
+
+/**
+ * Wait for the pending operations.
+ */
+int ff_async_writer_flush(FFAsyncWriter *w);
+
+#endif /* AVFORMAT_ASYNCWRITER_H */
@@ -41,6 +41,7 @@
 #include "demux.h"
 #include "mux.h"
 #include "internal.h"
+#include "packedindex.h"
 
 void ff_free_stream(AVStream **pst)
 {
@@ -57,6 +58,7 @@ void ff_free_stream(AVStream **pst)
     avcodec_free_context(&sti->avctx);
     av_bsf_free(&sti->bsfc);
     av_freep(&sti->index_entries);
+    ff_packed_index_free(&sti->packed_index);
     av_freep(&sti->probe_data.buf);
 
     av_bsf_free(&sti->extract_extradata.bsf);
@@ -297,10 +297,10 @@ static void clean_index(AVFormatContext *s)
 
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *st   = s->streams[i];
-        FFStream *const sti = ffstream(st);
         AVIStream *ast = st->priv_data;
-        int n          = sti->nb_index_entries;
+        int n          = ffstream(st)->nb_index_entries;
         int max        = ast->sample_size;
+        const AVIndexEntry *e;
         int64_t pos, size, ts;
 
         if (n != 1 || ast->sample_size == 0)
@@ -309,9 +309,10 @@ static void clean_index(AVFormatContext *s)
         while (max < 1024)
             max += max;
 
-        pos  = sti->index_entries[0].pos;
-        size = sti->index_entries[0].size;
-        ts   = sti->index_entries[0].timestamp;
+        e    = avformat_index_get_entry(st, 0);
+        pos  = e->pos;
+        size = e->size;
+        ts   = e->timestamp;
 
         for (j = 0; j < size; j += max)
             av_add_index_entry(st, pos + j, ts + j, FFMIN(max, size - j), 0,
@@ -458,14 +459,15 @@ static int calculate_bitrate(AVFormatContext *s)
 
     for (i = 0; i<s->nb_streams; i++) {
         int64_t len = 0;
-        FFStream *const sti = ffstream(s->streams[i]);
+        AVStream *st = s->streams[i];
+        FFStream *const sti = ffstream(st);
 
         if (!sti->nb_index_entries)
             continue;
 
         for (j = 0; j < sti->nb_index_entries; j++)
-            len += sti->index_entries[j].size;
-        maxpos = FFMAX(maxpos, sti->index_entries[j-1].pos);
+            len += avformat_index_get_entry(st, j)->size;
+        maxpos = FFMAX(maxpos, avformat_index_get_entry(st, j - 1)->pos);
         lensum += len;
     }
     if (maxpos < av_rescale(avi->io_fsize, 9, 10)) // index does not cover the whole file
@@ -481,11 +483,12 @@ static int calculate_bitrate(AVFormatContext *s)
         AVInteger bitrate_i, den_i, num_i;
 
         for (j = 0; j < sti->nb_index_entries; j++)
-            len += sti->index_entries[j].size;
+            len += avformat_index_get_entry(st, j)->size;
 
         if (sti->nb_index_entries < 2 || st->codecpar->bit_rate > 0)
             continue;
-        duration = sti->index_entries[j-1].timestamp - sti->index_entries[0].timestamp;
+        duration  = avformat_index_get_entry(st, j - 1)->timestamp;
+        duration -= avformat_index_get_entry(st, 0)->timestamp;
         den_i = av_mul_i(av_int2i(duration), av_int2i(st->time_base.num));
         num_i = av_add_i(av_mul_i(av_int2i(8*len), av_int2i(st->time_base.den)), av_shr_i(den_i, 1));
         bitrate_i = av_div_i(num_i, den_i);
@@ -605,7 +608,7 @@ static int avi_read_header(AVFormatContext *s)
             } else {
                 stream_index++;
                 st = avformat_new_stream(s, NULL);
-                if (!st)
+                if (!st || ff_stream_pack_index(st) < 0)
                     return AVERROR(ENOMEM);
 
                 st->id = stream_index;
@@ -1373,8 +1376,8 @@ start_sync:
                 if (size) {
                     FFStream *const sti = ffstream(st);
                     uint64_t pos = avio_tell(pb) - 8;
-                    if (!sti->index_entries || !sti->nb_index_entries ||
-                        sti->index_entries[sti->nb_index_entries - 1].pos < pos) {
+                    if (!sti->nb_index_entries ||
+                        avformat_index_get_entry(st, sti->nb_index_entries - 1)->pos < pos) {
                         av_add_index_entry(st, pos, ast->frame_offset, size,
                                            0, AVINDEX_KEYFRAME);
                     }
@@ -1394,7 +1397,6 @@ static int ni_prepare_read(AVFormatContext *s)
     AVIContext *avi = s->priv_data;
     int best_stream_index = 0;
     AVStream *best_st     = NULL;
-    FFStream *best_sti;
     AVIStream *best_ast;
     int64_t best_ts = INT64_MAX;
     int i;
@@ -1409,7 +1411,7 @@ static int ni_prepare_read(AVFormatContext *s)
         if (!sti->nb_index_entries)
             continue;
 
-        last_ts = sti->index_entries[sti->nb_index_entries - 1].timestamp;
+        last_ts = avformat_index_get_entry(st, sti->nb_index_entries - 1)->timestamp;
         if (!ast->remaining && ts > last_ts)
             continue;
 
@@ -1428,7 +1430,6 @@ static int ni_prepare_read(AVFormatContext *s)
     if (!best_st)
         return AVERROR_EOF;
 
-    best_sti = ffstream(best_st);
     best_ast = best_st->priv_data;
     best_ts  = best_ast->frame_offset;
     if (best_ast->remaining) {
@@ -1439,11 +1440,12 @@ static int ni_prepare_read(AVFormatContext *s)
     } else {
         i = av_index_search_timestamp(best_st, best_ts, AVSEEK_FLAG_ANY);
         if (i >= 0)
-            best_ast->frame_offset = best_sti->index_entries[i].timestamp;
+            best_ast->frame_offset = avformat_index_get_entry(best_st, i)->timestamp;
     }
 
     if (i >= 0) {
-        int64_t pos = best_sti->index_entries[i].pos;
+        const AVIndexEntry *e = avformat_index_get_entry(best_st, i);
+        int64_t pos = e->pos;
         pos += best_ast->packet_size - best_ast->remaining;
         if (avio_seek(s->pb, pos + 8, SEEK_SET) < 0)
           return AVERROR_EOF;
@@ -1453,7 +1455,7 @@ static int ni_prepare_read(AVFormatContext *s)
         avi->stream_index = best_stream_index;
         if (!best_ast->remaining)
             best_ast->packet_size =
-            best_ast->remaining   = best_sti->index_entries[i].size;
+            best_ast->remaining   = e->size;
     }
     else
         return AVERROR_EOF;
@@ -1543,14 +1545,14 @@ resync:
                 pkt->dts /= ast->sample_size;
             pkt->stream_index = avi->stream_index;
 
-            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->index_entries) {
-                AVIndexEntry *e;
+            if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries) {
+                const AVIndexEntry *e;
                 int index;
 
                 index = av_index_search_timestamp(st, ast->frame_offset, AVSEEK_FLAG_ANY);
-                e     = &sti->index_entries[index];
+                e     = avformat_index_get_entry(st, index);
 
-                if (index >= 0 && e->timestamp == ast->frame_offset) {
+                if (e && e->timestamp == ast->frame_offset) {
                     if (index == sti->nb_index_entries-1) {
                         int key=1;
                         uint32_t state=-1;
@@ -1564,8 +1566,14 @@ resync:
                                 }
                             }
                         }
-                        if (!key)
-                            e->flags &= ~AVINDEX_KEYFRAME;
+                        /* the entries may be packed, so they are updated by
+                         * adding them again */
+                        if (!key && e->flags & AVINDEX_KEYFRAME) {
+                            av_add_index_entry(st, e->pos, e->timestamp, e->size,
+                                               e->min_distance,
+                                               e->flags & ~AVINDEX_KEYFRAME);
+                            e = avformat_index_get_entry(st, index);
+                        }
                     }
                     if (e->flags & AVINDEX_KEYFRAME)
                         pkt->flags |= AV_PKT_FLAG_KEY;
@@ -1686,9 +1694,11 @@ static int avi_read_idx1(AVFormatContext *s, int size)
     }
     if (!anykey) {
         for (index = 0; index < s->nb_streams; index++) {
-            FFStream *const sti = ffstream(s->streams[index]);
-            if (sti->nb_index_entries)
-                sti->index_entries[0].flags |= AVINDEX_KEYFRAME;
+            AVStream *st = s->streams[index];
+            const AVIndexEntry *e = avformat_index_get_entry(st, 0);
+            if (e)
+                av_add_index_entry(st, e->pos, e->timestamp, e->size,
+                                   e->min_distance, e->flags | AVINDEX_KEYFRAME);
         }
     }
     return 0;
@@ -1713,27 +1723,25 @@ static int check_stream_max_drift(AVFormatContext *s)
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *st = s->streams[i];
             AVIStream *ast = st->priv_data;
-            FFStream *const sti = ffstream(st);
-            int n = sti->nb_index_entries;
-            while (idx[i] < n && sti->index_entries[idx[i]].pos < pos)
+            int n = ffstream(st)->nb_index_entries;
+            while (idx[i] < n && avformat_index_get_entry(st, idx[i])->pos < pos)
                 idx[i]++;
             if (idx[i] < n) {
+                const AVIndexEntry *e = avformat_index_get_entry(st, idx[i]);
                 int64_t dts;
-                dts = av_rescale_q(sti->index_entries[idx[i]].timestamp /
-                                   FFMAX(ast->sample_size, 1),
+                dts = av_rescale_q(e->timestamp / FFMAX(ast->sample_size, 1),
                                    st->time_base, AV_TIME_BASE_Q);
                 min_dts = FFMIN(min_dts, dts);
-                min_pos = FFMIN(min_pos, sti->index_entries[idx[i]].pos);
+                min_pos = FFMIN(min_pos, e->pos);
             }
         }
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *st = s->streams[i];
-            FFStream *const sti = ffstream(st);
             AVIStream *ast = st->priv_data;
 
             if (idx[i] && min_dts != INT64_MAX / 2) {
                 int64_t dts, delta_dts;
-                dts = av_rescale_q(sti->index_entries[idx[i] - 1].timestamp /
+                dts = av_rescale_q(avformat_index_get_entry(st, idx[i] - 1)->timestamp /
                                    FFMAX(ast->sample_size, 1),
                                    st->time_base, AV_TIME_BASE_Q);
                 delta_dts = av_sat_sub64(dts, min_dts);
@@ -1763,31 +1771,35 @@ static int guess_ni_flag(AVFormatContext *s)
 
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *st = s->streams[i];
-        FFStream *const sti = ffstream(st);
-        int n = sti->nb_index_entries;
+        int n = ffstream(st)->nb_index_entries;
+        int64_t first_pos, first_size, last_pos;
         unsigned int size;
 
         if (n <= 0)
             continue;
 
+        first_pos  = avformat_index_get_entry(st, 0)->pos;
+        first_size = avformat_index_get_entry(st, 0)->size;
+        last_pos   = avformat_index_get_entry(st, n - 1)->pos;
+
         if (n >= 2) {
-            int64_t pos = sti->index_entries[0].pos;
             unsigned tag[2];
-            avio_seek(s->pb, pos, SEEK_SET);
+            avio_seek(s->pb, first_pos, SEEK_SET);
             tag[0] = avio_r8(s->pb);
             tag[1] = avio_r8(s->pb);
             avio_rl16(s->pb);
             size = avio_rl32(s->pb);
-            if (get_stream_idx(tag) == i && pos + size > sti->index_entries[1].pos)
+            if (get_stream_idx(tag) == i &&
+                first_pos + size > avformat_index_get_entry(st, 1)->pos)
                 last_start = INT64_MAX;
-            if (get_stream_idx(tag) == i && size == sti->index_entries[0].size + 8)
+            if (get_stream_idx(tag) == i && size == first_size + 8)
                 last_start = INT64_MAX;
         }
 
-        if (sti->index_entries[0].pos > last_start)
-            last_start = sti->index_entries[0].pos;
-        if (sti->index_entries[n - 1].pos < first_end)
-            first_end = sti->index_entries[n - 1].pos;
+        if (first_pos > last_start)
+            last_start = first_pos;
+        if (last_pos < first_end)
+            first_end = last_pos;
     }
     avio_seek(s->pb, oldpos, SEEK_SET);
 
@@ -1890,17 +1902,16 @@ static int avi_read_seek(AVFormatContext *s, int stream_index,
         if (sti->nb_index_entries > 0)
             av_log(s, AV_LOG_DEBUG, "Failed to find timestamp %"PRId64 " in index %"PRId64 " .. %"PRId64 "\n",
                    timestamp,
-                   sti->index_entries[0].timestamp,
-                   sti->index_entries[sti->nb_index_entries - 1].timestamp);
+                   avformat_index_get_entry(st, 0)->timestamp,
+                   avformat_index_get_entry(st, sti->nb_index_entries - 1)->timestamp);
         return AVERROR_INVALIDDATA;
     }
 
     /* find the position */
-    pos       = sti->index_entries[index].pos;
-    timestamp = sti->index_entries[index].timestamp;
+    pos       = avformat_index_get_entry(st, index)->pos;
+    timestamp = avformat_index_get_entry(st, index)->timestamp;
 
-    av_log(s, AV_LOG_TRACE, "XX %"PRId64" %d %"PRId64"\n",
-            timestamp, index, sti->index_entries[index].timestamp);
+    av_log(s, AV_LOG_TRACE, "XX %"PRId64" %d\n", timestamp, index);
 
     if (CONFIG_DV_DEMUXER && avi->dv_demux) {
         /* One and only one real stream for DV in AVI, and it has video  */
@@ -1949,7 +1960,7 @@ static int avi_read_seek(AVFormatContext *s, int stream_index,
                                           (st2->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ? AVSEEK_FLAG_ANY : 0));
         if (index < 0)
             index = 0;
-        ast2->seek_pos = sti2->index_entries[index].pos;
+        ast2->seek_pos = avformat_index_get_entry(st2, index)->pos;
         pos_min = FFMIN(pos_min,ast2->seek_pos);
     }
     for (i = 0; i < s->nb_streams; i++) {
@@ -1966,9 +1977,10 @@ static int avi_read_seek(AVFormatContext *s, int stream_index,
                 flags | AVSEEK_FLAG_BACKWARD | (st2->codecpar->codec_type != AVMEDIA_TYPE_VIDEO ? AVSEEK_FLAG_ANY : 0));
         if (index < 0)
             index = 0;
-        while (!avi->non_interleaved && index > 0 && sti2->index_entries[index-1].pos >= pos_min)
+        while (!avi->non_interleaved && index > 0 &&
+               avformat_index_get_entry(st2, index - 1)->pos >= pos_min)
             index--;
-        ast2->frame_offset = sti2->index_entries[index].timestamp;
+        ast2->frame_offset = avformat_index_get_entry(st2, index)->timestamp;
     }
 
     /* do the seek */
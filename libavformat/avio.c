@@ -115,6 +115,46 @@ URLContext *ffio_geturlcontext(AVIOContext *s)
         return NULL;
 }
 
+int ffio_read_buffer(AVIOContext *s, AVBufferRef **buf, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t pos, buffered, res;
+    int ret;
+
+    if (!h || !s->seek || s->write_flag || s->update_checksum || size <= 0)
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(s);
+    if (pos < 0)
+        return pos;
+
+    ret = ffurl_read_buffer(h, pos, size, buf);
+    if (ret < 0)
+        return ret;
+    av_assert1(ret == size);
+
+    buffered = s->buf_end - s->buf_ptr;
+    if (size <= buffered) {
+        s->buf_ptr += size;
+        return size;
+    }
+
+    /* skip the referenced data by repositioning the protocol, as reading
+     * through it would defeat the purpose */
+    if ((res = s->seek(s->opaque, pos + size, SEEK_SET)) < 0) {
+        av_buffer_unref(buf);
+        return res;
+    }
+    s->buf_end = s->buf_ptr = s->buf_ptr_max = s->buffer;
+    s->pos = pos + size;
+    s->eof_reached = 0;
+    ctx->bytes_read += size - buffered;
+    s->bytes_read = ctx->bytes_read;
+
+    return size;
+}
+
 static int url_alloc_for_protocol(URLContext **puc, const URLProtocol *up,
                                   const char *filename, int flags,
                                   const AVIOInterruptCB *int_cb)
@@ -844,6 +884,13 @@ int ffurl_get_short_seek(void *urlcontext)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_read_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_read_buffer)
+        return AVERROR(ENOSYS);
+    return h->prot->url_read_buffer(h, pos, size, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
@@ -21,6 +21,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -119,6 +120,22 @@ void ffio_init_write_context(FFIOContext *s, uint8_t *buffer, int buffer_size);
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext as a reference to memory owned by the
+ * underlying protocol, without copying them. Only a few protocols support
+ * this, and only when explicitly enabled by the user.
+ * The referenced data must not be modified. It is followed by at least
+ * AV_INPUT_BUFFER_PADDING_SIZE readable bytes, like packet data, but they
+ * are not necessarily zero.
+ * @param s IO context
+ * @param buf set to the new reference on success
+ * @param size number of bytes requested
+ * @return size on success, AVERROR(ENOSYS) if the data cannot be
+ *    referenced (the read position is unchanged in this case) or
+ *    another AVERROR
+ */
+int ffio_read_buffer(AVIOContext *s, AVBufferRef **buf, int size);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -23,15 +23,21 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
  */
 
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/file_open.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
+#include "libavutil/murmur3.h"
 #include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavutil/thread.h"
 #include "libavutil/tree.h"
 #include "avio.h"
 #include <fcntl.h>
@@ -41,11 +47,53 @@
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <sys/stat.h>
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+/* the persistent store needs shared mappings and file locks */
+#define CACHE_STORE (HAVE_MMAP && HAVE_FCNTL && HAVE_UNISTD_H)
+
+#define STORE_MAGIC     MKTAG('F', 'F', 'c', 's')
+#define STORE_VERSION   2
+#define STORE_ENTRIES   (1 << 16)
+
+/**
+ * Entry of the index of the persistent store. Each entry refers to one block
+ * of a cached resource, stored in a file named after the key.
+ */
+typedef struct StoreEntry {
+    uint64_t key;       ///< hash of the url and block number, 0 if unused
+    uint64_t validator; ///< hash of the size, ETag and mtime of the resource
+    uint32_t size;
+    uint32_t prev;      ///< previous entry in the LRU list plus one, or 0
+    uint32_t next;      ///< next entry in the LRU list plus one, or 0
+    uint32_t padding;
+} StoreEntry;
+
+/**
+ * Index of the persistent store, mapped by all processes using the store.
+ * It is followed by nb_entries StoreEntry, forming an open addressing hash
+ * table with linear probing. The used entries are also linked in a list from
+ * the least to the most recently used one. Accesses are serialized by a lock
+ * on the file.
+ */
+typedef struct StoreIndex {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nb_entries;
+    uint32_t block_size;
+    uint64_t total_size;
+    uint32_t nb_used;
+    uint32_t lru_first; ///< least recently used entry plus one, or 0
+    uint32_t lru_last;  ///< most recently used entry plus one, or 0
+    uint32_t padding;
+} StoreIndex;
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
@@ -65,6 +113,19 @@ typedef struct CacheContext {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    char *cache_dir;
+    int64_t cache_max_size;
+    int block_size;
+
+    /* persistent store state */
+    const char *url;
+    uint64_t validator;
+    int index_fd;
+    StoreIndex *index;
+    uint8_t *block;
+    int64_t block_no;
+    int block_len;
 } CacheContext;
 
 static int cmp(const void *key, const void *node)
@@ -72,6 +133,494 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+#if CACHE_STORE
+#define STORE_MAP_SIZE (sizeof(StoreIndex) + STORE_ENTRIES * sizeof(StoreEntry))
+
+/* serializes the threads of this process, the file lock only the processes */
+static AVMutex store_mutex = AV_MUTEX_INITIALIZER;
+
+static StoreEntry *store_entries(StoreIndex *index)
+{
+    return (StoreEntry *)(index + 1);
+}
+
+static void store_lock(CacheContext *c)
+{
+    struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+
+    ff_mutex_lock(&store_mutex);
+    while (fcntl(c->index_fd, F_SETLKW, &fl) < 0 && errno == EINTR);
+}
+
+static void store_unlock(CacheContext *c)
+{
+    struct flock fl = { .l_type = F_UNLCK, .l_whence = SEEK_SET };
+
+    fcntl(c->index_fd, F_SETLK, &fl);
+    ff_mutex_unlock(&store_mutex);
+}
+
+static uint64_t store_key(const CacheContext *c, int64_t block_no)
+{
+    struct AVMurMur3 *ctx = av_murmur3_alloc();
+    uint8_t hash[16], buf[8];
+    uint64_t key;
+
+    if (!ctx)
+        return 0;
+    AV_WL64(buf, block_no);
+    av_murmur3_init(ctx);
+    av_murmur3_update(ctx, c->url, strlen(c->url) + 1);
+    av_murmur3_update(ctx, buf, sizeof(buf));
+    av_murmur3_final(ctx, hash);
+    av_free(ctx);
+
+    key = AV_RL64(hash);
+    return key ? key : 1;
+}
+
+/* Hash the properties telling whether the resource changed since its blocks
+ * were stored: its size, and its ETag, modification date or mtime if known */
+static uint64_t store_validator(const CacheContext *c)
+{
+    static const char *const opts[] = { "etag", "last_modified" };
+    struct AVMurMur3 *ctx = av_murmur3_alloc();
+    int64_t size  = ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+    int64_t mtime = 0;
+    int fd = ffurl_get_file_handle(c->inner);
+    uint8_t hash[16], buf[16];
+    struct stat st;
+
+    if (!ctx)
+        return 0;
+    if (fd >= 0 && !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        mtime = st.st_mtime * 1000000000LL;
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+        mtime += st.st_mtim.tv_nsec;
+#endif
+    }
+    AV_WL64(buf,     size < 0 ? -1 : size);
+    AV_WL64(buf + 8, mtime);
+    av_murmur3_init(ctx);
+    av_murmur3_update(ctx, buf, sizeof(buf));
+    for (int i = 0; i < FF_ARRAY_ELEMS(opts); i++) {
+        uint8_t *str = NULL;
+
+        if (av_opt_get(c->inner, opts[i], AV_OPT_SEARCH_CHILDREN, &str) < 0 || !str)
+            str = NULL;
+        av_murmur3_update(ctx, str ? str : (const uint8_t *)"", str ? strlen((char *)str) + 1 : 1);
+        av_free(str);
+    }
+    av_murmur3_final(ctx, hash);
+    av_free(ctx);
+
+    return AV_RL64(hash);
+}
+
+static void store_path(const CacheContext *c, uint64_t key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016"PRIx64, c->cache_dir, key);
+}
+
+/* Find the entry of a key, or the free entry it would be inserted into */
+static StoreEntry *store_find(StoreIndex *index, uint64_t key, int insert)
+{
+    StoreEntry *entries = store_entries(index);
+    const uint32_t mask = index->nb_entries - 1;
+
+    for (uint32_t i = key & mask, n = 0; n < index->nb_entries; i = (i + 1) & mask, n++) {
+        if (entries[i].key == key)
+            return &entries[i];
+        if (!entries[i].key)
+            return insert ? &entries[i] : NULL;
+    }
+    return NULL;
+}
+
+static void lru_unlink(StoreIndex *index, StoreEntry *entry)
+{
+    StoreEntry *entries = store_entries(index);
+
+    if (entry->prev)
+        entries[entry->prev - 1].next = entry->next;
+    else
+        index->lru_first = entry->next;
+    if (entry->next)
+        entries[entry->next - 1].prev = entry->prev;
+    else
+        index->lru_last = entry->prev;
+    entry->prev = entry->next = 0;
+}
+
+/* Make an entry the most recently used one */
+static void lru_append(StoreIndex *index, StoreEntry *entry)
+{
+    StoreEntry *entries = store_entries(index);
+    const uint32_t link = entry - entries + 1;
+
+    entry->prev = index->lru_last;
+    entry->next = 0;
+    if (index->lru_last)
+        entries[index->lru_last - 1].next = link;
+    else
+        index->lru_first = link;
+    index->lru_last = link;
+}
+
+/* Update the links to an entry which was moved to another position */
+static void lru_relink(StoreIndex *index, StoreEntry *entry)
+{
+    StoreEntry *entries = store_entries(index);
+    const uint32_t link = entry - entries + 1;
+
+    if (entry->prev)
+        entries[entry->prev - 1].next = link;
+    else
+        index->lru_first = link;
+    if (entry->next)
+        entries[entry->next - 1].prev = link;
+    else
+        index->lru_last = link;
+}
+
+static void store_remove(StoreIndex *index, StoreEntry *entry)
+{
+    StoreEntry *entries = store_entries(index);
+    const uint32_t mask = index->nb_entries - 1;
+    uint32_t i = entry - entries, j = i;
+
+    lru_unlink(index, entry);
+    index->total_size -= entry->size;
+    index->nb_used--;
+    entry->key = 0;
+
+    /* move the following entries back into the hole where needed, so that
+     * probing does not stop early */
+    for (;;) {
+        uint32_t home;
+
+        j = (j + 1) & mask;
+        if (!entries[j].key)
+            break;
+        home = entries[j].key & mask;
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            entries[i] = entries[j];
+            entries[j].key = 0;
+            lru_relink(index, &entries[i]);
+            i = j;
+        }
+    }
+}
+
+/* Evict the least recently used blocks until size more bytes fit */
+static void store_evict(URLContext *h, StoreIndex *index, int64_t size)
+{
+    CacheContext *c = h->priv_data;
+    StoreEntry *entries = store_entries(index);
+
+    while (index->nb_used && index->lru_first &&
+           (index->total_size + size > c->cache_max_size ||
+            index->nb_used >= index->nb_entries / 4 * 3)) {
+        StoreEntry *lru = &entries[index->lru_first - 1];
+        char path[1024];
+
+        store_path(c, lru->key, path, sizeof(path));
+        if (unlink(path) < 0 && errno != ENOENT)
+            av_log(h, AV_LOG_WARNING, "Could not delete %s.\n", path);
+        store_remove(index, lru);
+    }
+}
+
+static int store_open(URLContext *h)
+{
+    CacheContext *c = h->priv_data;
+    StoreIndex *index;
+    struct stat st;
+    char *path;
+    int ret = 0;
+
+    if (mkdir(c->cache_dir, 0777) < 0 && errno != EEXIST) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not create %s.\n", c->cache_dir);
+        return ret;
+    }
+
+    path = av_asprintf("%s/index", c->cache_dir);
+    if (!path)
+        return AVERROR(ENOMEM);
+    c->index_fd = avpriv_open(path, O_RDWR | O_CREAT, 0666);
+    if (c->index_fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not open %s.\n", path);
+        av_free(path);
+        return ret;
+    }
+    av_free(path);
+
+    store_lock(c);
+    if (fstat(c->index_fd, &st) < 0 ||
+        (!st.st_size && ftruncate(c->index_fd, STORE_MAP_SIZE) < 0)) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    if (st.st_size && st.st_size != STORE_MAP_SIZE) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+
+    index = mmap(NULL, STORE_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, c->index_fd, 0);
+    if (index == MAP_FAILED) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    c->index = index;
+
+    if (!index->magic) {
+        index->magic      = STORE_MAGIC;
+        index->version    = STORE_VERSION;
+        index->nb_entries = STORE_ENTRIES;
+        index->block_size = c->block_size;
+    } else if (index->magic != STORE_MAGIC || index->version != STORE_VERSION ||
+               index->nb_entries != STORE_ENTRIES || !index->block_size) {
+        ret = AVERROR_INVALIDDATA;
+        goto end;
+    }
+    /* all users of the store must agree on the block size */
+    c->block_size = index->block_size;
+
+end:
+    store_unlock(c);
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(h, AV_LOG_ERROR, "Invalid cache index in %s.\n", c->cache_dir);
+    return ret;
+}
+
+static void store_close(CacheContext *c)
+{
+    if (c->index)
+        munmap(c->index, STORE_MAP_SIZE);
+    c->index = NULL;
+    /* closing the file drops all the locks of the process on it, so wait
+     * until no other thread holds the lock */
+    if (c->index_fd >= 0) {
+        ff_mutex_lock(&store_mutex);
+        close(c->index_fd);
+        ff_mutex_unlock(&store_mutex);
+    }
+    c->index_fd = -1;
+}
+
+/* Read a block from the store into c->block, returns its size */
+static int store_get(URLContext *h, uint64_t key)
+{
+    CacheContext *c = h->priv_data;
+    StoreEntry *entry;
+    char path[1024];
+    int size = -1, len = 0, fd;
+
+    store_lock(c);
+    entry = store_find(c->index, key, 0);
+    if (entry && entry->validator != c->validator) {
+        /* the resource changed since the block was stored */
+        av_log(h, AV_LOG_VERBOSE, "Dropping outdated block %016"PRIx64".\n", key);
+        store_path(c, key, path, sizeof(path));
+        if (unlink(path) < 0 && errno != ENOENT)
+            av_log(h, AV_LOG_WARNING, "Could not delete %s.\n", path);
+        store_remove(c->index, entry);
+        entry = NULL;
+    }
+    if (entry) {
+        lru_unlink(c->index, entry);
+        lru_append(c->index, entry);
+        size = entry->size;
+    }
+    store_unlock(c);
+    if (size < 0 || size > c->block_size)
+        return AVERROR(ENOENT);
+
+    /* the file stays readable if it is evicted in the meantime */
+    store_path(c, key, path, sizeof(path));
+    fd = avpriv_open(path, O_RDONLY);
+    if (fd < 0)
+        return AVERROR(ENOENT);
+    while (len < size) {
+        int ret = read(fd, c->block + len, size - len);
+        if (ret <= 0)
+            break;
+        len += ret;
+    }
+    close(fd);
+
+    return len == size ? size : AVERROR(ENOENT);
+}
+
+static int store_put(URLContext *h, uint64_t key, const uint8_t *buf, int size)
+{
+    CacheContext *c = h->priv_data;
+    StoreEntry *entry;
+    char path[1024], tmp[1100];
+    int fd, len = 0, ret = 0;
+
+    /* a block larger than the store would only evict all the others */
+    if (size > c->cache_max_size)
+        return 0;
+
+    /* write the block under a private name, so that it only becomes visible
+     * to other readers once it is complete */
+    store_path(c, key, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%d.%08"PRIx32".tmp", path, (int)getpid(),
+             av_get_random_seed());
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0)
+        return AVERROR(errno);
+    while (len < size) {
+        int r = write(fd, buf + len, size - len);
+        if (r < 0) {
+            ret = AVERROR(errno);
+            break;
+        }
+        len += r;
+    }
+    if (close(fd) < 0 && !ret)
+        ret = AVERROR(errno);
+    if (ret < 0) {
+        unlink(tmp);
+        return ret;
+    }
+
+    store_lock(c);
+    if (rename(tmp, path) < 0) {
+        ret = AVERROR(errno);
+        unlink(tmp);
+        goto end;
+    }
+
+    /* the block may have been added by another reader in the meantime */
+    entry = store_find(c->index, key, 0);
+    if (entry)
+        store_remove(c->index, entry);
+
+    store_evict(h, c->index, size);
+    entry = store_find(c->index, key, 1);
+    if (!entry) {
+        unlink(path);
+        goto end;
+    }
+    entry->key       = key;
+    entry->validator = c->validator;
+    entry->size      = size;
+    lru_append(c->index, entry);
+    c->index->total_size += size;
+    c->index->nb_used++;
+
+end:
+    store_unlock(c);
+    return ret;
+}
+
+/* Move the inner protocol forward to pos when it cannot seek */
+static int64_t store_skip(URLContext *h, int64_t pos)
+{
+    CacheContext *c = h->priv_data;
+
+    while (c->inner_pos < pos) {
+        int ret = ffurl_read(c->inner, c->block,
+                             FFMIN(c->block_size, pos - c->inner_pos));
+        if (!ret)
+            ret = AVERROR_EOF;
+        if (ret < 0)
+            return ret;
+        c->inner_pos += ret;
+    }
+    return c->inner_pos;
+}
+
+/* Make c->block hold the given block, fetching it if it is not stored */
+static int store_load_block(URLContext *h, int64_t block_no)
+{
+    CacheContext *c = h->priv_data;
+    const int64_t pos = block_no * c->block_size;
+    uint64_t key = store_key(c, block_no);
+    int len = 0, eof = 0, ret;
+
+    c->block_no = -1;
+
+    ret = key ? store_get(h, key) : AVERROR(ENOMEM);
+    if (ret >= 0) {
+        c->cache_hit++;
+        len = ret;
+        eof = len < c->block_size;
+    } else {
+        if (c->inner_pos != pos) {
+            int64_t r = AVERROR(ENOSYS);
+
+            if (!c->inner->is_streamed)
+                r = ffurl_seek(c->inner, pos, SEEK_SET);
+            if (r < 0 && pos > c->inner_pos)
+                r = store_skip(h, pos);
+            if (r == AVERROR_EOF)
+                return r;
+            if (r < 0) {
+                av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+                return r;
+            }
+            c->inner_pos = r;
+        }
+
+        while (len < c->block_size) {
+            ret = ffurl_read(c->inner, c->block + len, c->block_size - len);
+            if (ret == AVERROR_EOF || !ret) {
+                eof = 1;
+                break;
+            }
+            if (ret < 0)
+                return ret;
+            len          += ret;
+            c->inner_pos += ret;
+        }
+        c->cache_miss++;
+
+        /* the last block of the resource is stored even if it is short, its
+         * size tells where the resource ends */
+        if (key) {
+            ret = store_put(h, key, c->block, len);
+            if (ret < 0)
+                av_log(h, AV_LOG_WARNING, "Could not store block %"PRId64": %s\n",
+                       block_no, av_err2str(ret));
+        }
+    }
+
+    if (eof) {
+        c->is_true_eof = 1;
+        c->end = pos + len;
+    }
+    c->block_no  = block_no;
+    c->block_len = len;
+    return 0;
+}
+
+static int store_read(URLContext *h, unsigned char *buf, int size)
+{
+    CacheContext *c = h->priv_data;
+    const int64_t block_no = c->logical_pos / c->block_size;
+    const int offset = c->logical_pos % c->block_size;
+    int ret;
+
+    if (block_no != c->block_no) {
+        ret = store_load_block(h, block_no);
+        if (ret < 0)
+            return ret;
+    }
+    if (offset >= c->block_len)
+        return AVERROR_EOF;
+
+    size = FFMIN(size, c->block_len - offset);
+    memcpy(buf, c->block + offset, size);
+    c->logical_pos += size;
+    return size;
+}
+#endif
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     CacheContext *c = h->priv_data;
@@ -80,6 +629,31 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    c->fd       = -1;
+    c->index_fd = -1;
+    c->block_no = -1;
+
+    if (c->cache_dir) {
+#if CACHE_STORE
+        c->url = arg;
+        ret = store_open(h);
+        if (ret < 0)
+            return ret;
+        c->block = av_malloc(c->block_size);
+        if (!c->block)
+            return AVERROR(ENOMEM);
+        ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                                   options, h->protocol_whitelist, h->protocol_blacklist, h);
+        if (ret < 0)
+            return ret;
+        c->validator = store_validator(c);
+        return 0;
+#else
+        av_log(h, AV_LOG_ERROR, "Persistent caching is not supported on this platform\n");
+        return AVERROR(ENOSYS);
+#endif
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -166,6 +740,11 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
     CacheEntry *entry, *next[2] = {NULL, NULL};
     int64_t r;
 
+#if CACHE_STORE
+    if (c->index)
+        return store_read(h, buf, size);
+#endif
+
     entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
 
     if (!entry)
@@ -243,6 +822,24 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
         return pos;
     }
 
+    if (c->index) {
+        /* blocks are fetched on demand, seeking only moves the position */
+        if (whence == SEEK_CUR) {
+            pos += c->logical_pos;
+        } else if (whence == SEEK_END) {
+            int64_t size = c->is_true_eof ? c->end : ffurl_seek(c->inner, 0, AVSEEK_SIZE);
+            if (size < 0)
+                return size;
+            pos += size;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        c->logical_pos = pos;
+        return pos;
+    }
+
     if (whence == SEEK_CUR) {
         whence = SEEK_SET;
         pos += c->logical_pos;
@@ -304,7 +901,12 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
+    if (c->fd >= 0)
+        close(c->fd);
+#if CACHE_STORE
+    store_close(c);
+#endif
+    av_freep(&c->block);
     if (c->filename) {
         ret = unlink(c->filename);
         if (ret < 0)
@@ -323,6 +925,9 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory of a persistent cache shared with other readers", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_max_size", "Maximum size in bytes of the persistent cache", OFFSET(cache_max_size), AV_OPT_TYPE_INT64, { .i64 = 1LL << 30 }, 0, INT64_MAX, D },
+    { "cache_block_size", "Size in bytes of the blocks of a new persistent cache", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 26, D },
     {NULL},
 };
 
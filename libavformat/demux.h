@@ -238,6 +238,14 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
 
 void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance);
 
+/**
+ * Store the index of the stream in a compact form, which typically uses a
+ * third of the memory. Entries are then only accessible through
+ * avformat_index_get_entry() and av_index_search_timestamp(), and not
+ * through FFStream.index_entries. Must be called before adding entries.
+ */
+int ff_stream_pack_index(AVStream *st);
+
 /**
  * Ensure the index uses less memory than the maximum specified in
  * AVFormatContext.max_index_size by discarding entries if it grows
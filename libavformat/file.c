@@ -19,9 +19,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE // needed for madvise
+#define _DARWIN_C_SOURCE // needed for madvise
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
@@ -39,6 +42,10 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include "libavcodec/defs.h"
 #include "os_support.h"
 #include "url.h"
 
@@ -89,6 +96,14 @@
 
 /* standard file protocol */
 
+/* Amount of data ahead of the referenced data for which the kernel is asked
+ * to start reading in mmap mode */
+#define MMAP_READAHEAD (1 << 22)
+
+/* Smallest reads that are referenced instead of copied in zero_copy mode,
+ * below which checking the file size costs more than copying */
+#define ZERO_COPY_MIN_SIZE (1 << 14)
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -96,9 +111,17 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
+    int zero_copy;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_MMAP
+    AVBufferRef *map;
+    int64_t map_size;
+    int64_t readahead_pos;
+    int64_t page_size;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -106,6 +129,8 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file into memory to reference its data", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "zero_copy", "Let demuxers reference the mapped file in packets", offsetof(FileContext, zero_copy), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -136,6 +161,118 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+/* Map the whole file. The previous mapping is kept until the last data
+ * referencing it is freed. */
+static int file_map(URLContext *h, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    AVBufferRef *map;
+    void *data;
+
+    if (size > SIZE_MAX)
+        return AVERROR(ENOSYS);
+
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (data == MAP_FAILED) {
+        av_log(h, AV_LOG_WARNING, "Cannot map file: %s, copying its data\n",
+               av_err2str(AVERROR(errno)));
+        c->use_mmap = 0;
+        return AVERROR(ENOSYS);
+    }
+
+    map = av_buffer_create(data, size, file_unmap,
+                           (void *)(uintptr_t)size, AV_BUFFER_FLAG_READONLY);
+    if (!map) {
+        munmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+#if HAVE_MADVISE && defined(MADV_SEQUENTIAL)
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+    av_buffer_unref(&c->map);
+    c->map           = map;
+    c->map_size      = size;
+    c->readahead_pos = 0;
+
+    return 0;
+}
+
+static void file_map_readahead(FileContext *c, int64_t pos)
+{
+#if HAVE_MADVISE && defined(MADV_WILLNEED)
+    /* advise in aligned windows, so that they start on a page boundary */
+    if (pos > c->readahead_pos ||
+        pos < c->readahead_pos - 2 * MMAP_READAHEAD)
+        c->readahead_pos = pos & ~(int64_t)(MMAP_READAHEAD - 1);
+
+    if (pos + MMAP_READAHEAD > c->readahead_pos &&
+        c->readahead_pos < c->map_size) {
+        madvise(c->map->data + c->readahead_pos,
+                FFMIN(MMAP_READAHEAD, c->map_size - c->readahead_pos),
+                MADV_WILLNEED);
+        c->readahead_pos += MMAP_READAHEAD;
+    }
+#endif
+}
+
+static void file_unref_map(void *opaque, uint8_t *data)
+{
+    AVBufferRef *map = opaque;
+    av_buffer_unref(&map);
+}
+
+static int file_read_buffer(URLContext *h, int64_t pos, int size,
+                            AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    AVBufferRef *map;
+    struct stat st;
+    int64_t end;
+
+    if (!c->use_mmap || !c->zero_copy || pos < 0 || size < ZERO_COPY_MIN_SIZE)
+        return AVERROR(ENOSYS);
+
+    /* Accessing pages past the end of the file raises SIGBUS, so the data
+     * is only referenced if the file still contains it. It is followed by
+     * the next bytes of the file, or the zeroed end of its last page, as
+     * padding. */
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(ENOSYS);
+    end = pos + size + AV_INPUT_BUFFER_PADDING_SIZE;
+    if (pos + size > st.st_size || end > FFALIGN(st.st_size, c->page_size))
+        return AVERROR(ENOSYS);
+
+    /* the file is only mapped again when it has grown */
+    if (!c->map || end > FFALIGN(c->map_size, c->page_size)) {
+        int ret = file_map(h, st.st_size);
+        if (ret < 0)
+            return ret;
+    }
+
+    map = av_buffer_ref(c->map);
+    if (!map)
+        return AVERROR(ENOMEM);
+    *buf = av_buffer_create(map->data + pos, size, file_unref_map, map,
+                            AV_BUFFER_FLAG_READONLY);
+    if (!*buf) {
+        av_buffer_unref(&map);
+        return AVERROR(ENOMEM);
+    }
+
+    /* the read position of the protocol is not changed */
+    file_map_readahead(c, pos + size);
+
+    return size;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
@@ -221,7 +358,12 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
+    int ret;
+#if HAVE_MMAP
+    /* the mapping stays valid while packets still reference it */
+    av_buffer_unref(&c->map);
+#endif
+    ret = close(c->fd);
     return (ret == -1) ? AVERROR(errno) : 0;
 }
 
@@ -318,6 +460,20 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE)) {
+#if HAVE_MMAP
+        if (!h->is_streamed && !c->follow && S_ISREG(st.st_mode)) {
+            c->page_size = sysconf(_SC_PAGESIZE);
+        } else {
+            av_log(h, AV_LOG_WARNING, "Only regular files can be mapped\n");
+            c->use_mmap = 0;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "mmap is not supported on this system\n");
+        c->use_mmap = 0;
+#endif
+    }
+
     return 0;
 }
 
@@ -416,6 +572,9 @@ const URLProtocol ff_file_protocol = {
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
+#if HAVE_MMAP
+    .url_read_buffer     = file_read_buffer,
+#endif
     .priv_data_size      = sizeof(FileContext),
     .priv_data_class     = &file_class,
     .url_open_dir        = file_open_dir,
@@ -38,6 +38,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "demux.h"
@@ -88,6 +89,36 @@ struct segment {
 
 struct rendition;
 
+/*
+ * A segment downloaded ahead of time by a prefetch thread. The data is
+ * kept in memory until the segment has been read by the demuxer.
+ */
+typedef struct PrefetchSlot {
+    struct playlist *pls;
+    int64_t seq_no;
+    char *url;
+    int64_t url_offset;
+    int64_t size;
+    AVDictionary *avio_opts;
+
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    int active;     /* set while the slot holds a segment */
+    int opened;     /* 1 once the segment is opened, negative on failure */
+    int done;       /* set once the download ended */
+    int error;      /* download error, if any */
+    int abort;
+    int reading;    /* set while the demuxer reads from the slot */
+
+    uint8_t *data;
+    unsigned int data_alloc;
+    int64_t data_len;
+    int64_t read_pos;
+
+    int64_t start_time, end_time;
+} PrefetchSlot;
+
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
     PLS_TYPE_EVENT,
@@ -173,6 +204,17 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments downloaded ahead of time, indexed by sequence number
+     * modulo the prefetch depth. */
+    PrefetchSlot *prefetch;
+    PrefetchSlot *prefetch_cur; /* slot the current segment is read from */
+    AVMutex prefetch_lock;
+    AVCond prefetch_cond;
+    int64_t prefetch_buffered;  /* bytes held by all slots */
+    int64_t prefetch_bytes;     /* bytes of all completed downloads */
+    int64_t prefetch_time;      /* time spent on all completed downloads */
+    int prefetch_segments;      /* number of completed downloads */
 };
 
 /*
@@ -229,6 +271,8 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     int seg_max_retry;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
 } HLSContext;
@@ -262,11 +306,14 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void prefetch_free(struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_free(pls);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -1112,11 +1159,310 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+static void prefetch_stop(PrefetchSlot *slot)
+{
+    struct playlist *pls = slot->pls;
+
+    if (!slot->active)
+        return;
+
+    ff_mutex_lock(&pls->prefetch_lock);
+    slot->abort = 1;
+    ff_cond_broadcast(&pls->prefetch_cond);
+    ff_mutex_unlock(&pls->prefetch_lock);
+
+#if HAVE_THREADS
+    pthread_join(slot->thread, NULL);
+#endif
+
+    /* let the other downloads use the memory */
+    ff_mutex_lock(&pls->prefetch_lock);
+    pls->prefetch_buffered -= slot->data_len;
+    ff_cond_broadcast(&pls->prefetch_cond);
+    ff_mutex_unlock(&pls->prefetch_lock);
+
+    if (pls->prefetch_cur == slot)
+        pls->prefetch_cur = NULL;
+    av_freep(&slot->url);
+    av_dict_free(&slot->avio_opts);
+    slot->active = 0;
+}
+
+/* Stop all downloads of the playlist and drop the downloaded data */
+static void prefetch_reset(struct playlist *pls)
+{
+    HLSContext *c = pls->parent->priv_data;
+
+    if (!pls->prefetch)
+        return;
+    for (int i = 0; i < c->prefetch_segments; i++)
+        prefetch_stop(&pls->prefetch[i]);
+}
+
+static void prefetch_free(struct playlist *pls)
+{
+    HLSContext *c = pls->parent->priv_data;
+
+    if (!pls->prefetch)
+        return;
+
+    prefetch_reset(pls);
+    for (int i = 0; i < c->prefetch_segments; i++)
+        av_freep(&pls->prefetch[i].data);
+    av_freep(&pls->prefetch);
+    ff_cond_destroy(&pls->prefetch_cond);
+    ff_mutex_destroy(&pls->prefetch_lock);
+
+    if (pls->prefetch_segments)
+        av_log(pls->parent, AV_LOG_INFO,
+               "Prefetched %d segments of playlist %d, %"PRId64" bytes at %"PRId64" kbit/s\n",
+               pls->prefetch_segments, pls->index, pls->prefetch_bytes,
+               pls->prefetch_bytes * 8000 / FFMAX(pls->prefetch_time, 1));
+}
+
+/* Wait for a prefetch thread, returning regularly to check for interrupts */
+static void prefetch_wait(struct playlist *pls)
+{
+    int64_t t = av_gettime() + 100000;
+    struct timespec tv = { .tv_sec  =  t / 1000000,
+                           .tv_nsec = (t % 1000000) * 1000 };
+    ff_cond_timedwait(&pls->prefetch_cond, &pls->prefetch_lock, &tv);
+}
+
+static int prefetch_can_buffer(HLSContext *c, PrefetchSlot *slot)
+{
+    return slot->reading || slot->pls->prefetch_buffered < c->prefetch_max_size;
+}
+
+#if HAVE_THREADS
+/*
+ * Download a segment. This runs on its own thread, so the io_open() and
+ * io_close2() callbacks of the demuxer and its interrupt callback are called
+ * from there, concurrently with the demuxer thread and the other downloads.
+ */
+static void *prefetch_thread(void *arg)
+{
+    PrefetchSlot *slot = arg;
+    struct playlist *pls = slot->pls;
+    HLSContext *c = pls->parent->priv_data;
+    AVDictionary *opts = NULL;
+    AVIOContext *in = NULL;
+    uint8_t buf[16384];
+    int64_t remaining = slot->size;
+    int is_http = 0, ret;
+
+    if (slot->size >= 0) {
+        av_dict_set_int(&opts, "offset", slot->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", slot->url_offset + slot->size, 0);
+    }
+    ret = open_url(pls->parent, &in, slot->url, &slot->avio_opts, opts, &is_http);
+    av_dict_free(&opts);
+    if (ret >= 0 && !is_http && slot->url_offset) {
+        int64_t seekret = avio_seek(in, slot->url_offset, SEEK_SET);
+        if (seekret < 0)
+            ret = seekret;
+    }
+
+    ff_mutex_lock(&pls->prefetch_lock);
+    slot->opened = ret < 0 ? ret : 1;
+    ff_cond_broadcast(&pls->prefetch_cond);
+
+    while (ret >= 0 && remaining) {
+        while (!slot->abort && !prefetch_can_buffer(c, slot))
+            ff_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+        if (slot->abort)
+            break;
+        ff_mutex_unlock(&pls->prefetch_lock);
+
+        ret = avio_read(in, buf, remaining >= 0 ? FFMIN(remaining, sizeof(buf)) : sizeof(buf));
+
+        ff_mutex_lock(&pls->prefetch_lock);
+        if (ret <= 0)
+            break;
+        if (slot->data_len + ret > slot->data_alloc) {
+            int64_t alloc = FFMAX3(slot->data_len + ret, 2 * slot->data_alloc, slot->size);
+            uint8_t *data = alloc <= UINT_MAX ? av_realloc(slot->data, alloc) : NULL;
+            if (!data) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            slot->data       = data;
+            slot->data_alloc = alloc;
+        }
+        memcpy(slot->data + slot->data_len, buf, ret);
+        slot->data_len          += ret;
+        pls->prefetch_buffered  += ret;
+        if (remaining > 0)
+            remaining -= ret;
+        ff_cond_broadcast(&pls->prefetch_cond);
+    }
+
+    slot->error    = ret < 0 && ret != AVERROR_EOF ? ret : 0;
+    slot->end_time = av_gettime_relative();
+    slot->done     = 1;
+    ff_cond_broadcast(&pls->prefetch_cond);
+    ff_mutex_unlock(&pls->prefetch_lock);
+
+    ff_format_io_close(pls->parent, &in);
+    return NULL;
+}
+#endif
+
+/* Start downloading the segments following the current one */
+static void prefetch_fill(HLSContext *c, struct playlist *pls)
+{
+    int ret;
+
+    if (!pls->prefetch) {
+        pls->prefetch = av_calloc(c->prefetch_segments, sizeof(*pls->prefetch));
+        if (!pls->prefetch)
+            return;
+        if (ff_mutex_init(&pls->prefetch_lock, NULL)) {
+            av_freep(&pls->prefetch);
+            return;
+        }
+        if (ff_cond_init(&pls->prefetch_cond, NULL)) {
+            ff_mutex_destroy(&pls->prefetch_lock);
+            av_freep(&pls->prefetch);
+            return;
+        }
+    }
+
+    /* drop segments which were skipped */
+    for (int i = 0; i < c->prefetch_segments; i++) {
+        if (pls->prefetch[i].seq_no < pls->cur_seq_no)
+            prefetch_stop(&pls->prefetch[i]);
+    }
+
+    for (int i = 0; i < c->prefetch_segments; i++) {
+        int64_t seq_no = pls->cur_seq_no + i;
+        PrefetchSlot *slot = &pls->prefetch[seq_no % c->prefetch_segments];
+        struct segment *seg;
+
+        if (seq_no - pls->start_seq_no >= pls->n_segments)
+            break;
+        if (slot->active)
+            continue;
+
+        /* encrypted segments need the key state of the playlist, which is
+         * only accessed by the demuxer thread */
+        seg = pls->segments[seq_no - pls->start_seq_no];
+        if (seg->key_type != KEY_NONE)
+            continue;
+
+        slot->url = av_strdup(seg->url);
+        if (!slot->url || av_dict_copy(&slot->avio_opts, c->avio_opts, 0) < 0) {
+            av_freep(&slot->url);
+            av_dict_free(&slot->avio_opts);
+            return;
+        }
+        slot->pls        = pls;
+        slot->seq_no     = seq_no;
+        slot->url_offset = seg->url_offset;
+        slot->size       = seg->size;
+        slot->opened     = 0;
+        slot->done       = 0;
+        slot->error      = 0;
+        slot->abort      = 0;
+        slot->reading    = 0;
+        slot->data_len   = 0;
+        slot->read_pos   = 0;
+        slot->start_time = av_gettime_relative();
+
+#if HAVE_THREADS
+        ret = pthread_create(&slot->thread, NULL, prefetch_thread, slot);
+#else
+        ret = ENOSYS;
+#endif
+        if (ret) {
+            av_freep(&slot->url);
+            av_dict_free(&slot->avio_opts);
+            return;
+        }
+        slot->active = 1;
+    }
+}
+
+/**
+ * Start reading the current segment from its prefetch slot.
+ * @return 0 on success, a negative error code if the segment has to be
+ *         opened directly instead
+ */
+static int prefetch_open(HLSContext *c, struct playlist *pls)
+{
+    const AVDictionaryEntry *cookies;
+    PrefetchSlot *slot;
+    int ret;
+
+    prefetch_fill(c, pls);
+    if (!pls->prefetch)
+        return AVERROR(ENOMEM);
+
+    slot = &pls->prefetch[pls->cur_seq_no % c->prefetch_segments];
+    if (!slot->active || slot->seq_no != pls->cur_seq_no)
+        return AVERROR(EAGAIN);
+
+    ff_mutex_lock(&pls->prefetch_lock);
+    slot->reading = 1;
+    ff_cond_broadcast(&pls->prefetch_cond);
+    while (!slot->opened && !ff_check_interrupt(c->interrupt_callback))
+        prefetch_wait(pls);
+    ret = slot->opened;
+    ff_mutex_unlock(&pls->prefetch_lock);
+
+    if (ret <= 0) {
+        /* let the regular code path retry and report the failure */
+        prefetch_stop(slot);
+        return ret < 0 ? ret : AVERROR_EXIT;
+    }
+
+    /* keep the cookies set by the server, as open_url() does */
+    cookies = av_dict_get(slot->avio_opts, "cookies", NULL, 0);
+    if (cookies)
+        av_dict_set(&c->avio_opts, "cookies", cookies->value, 0);
+
+    pls->prefetch_cur    = slot;
+    pls->cur_seg_offset  = 0;
+    return 0;
+}
+
+static int read_prefetched(HLSContext *c, struct playlist *pls,
+                           uint8_t *buf, int buf_size)
+{
+    PrefetchSlot *slot = pls->prefetch_cur;
+    int ret;
+
+    ff_mutex_lock(&pls->prefetch_lock);
+    while (!slot->done && slot->read_pos >= slot->data_len) {
+        if (ff_check_interrupt(c->interrupt_callback)) {
+            ff_mutex_unlock(&pls->prefetch_lock);
+            return AVERROR_EXIT;
+        }
+        prefetch_wait(pls);
+    }
+    if (slot->read_pos < slot->data_len) {
+        ret = FFMIN(buf_size, slot->data_len - slot->read_pos);
+        memcpy(buf, slot->data + slot->read_pos, ret);
+        slot->read_pos += ret;
+    } else {
+        ret = slot->error ? slot->error : AVERROR_EOF;
+    }
+    ff_mutex_unlock(&pls->prefetch_lock);
+
+    if (ret > 0)
+        pls->cur_seg_offset += ret;
+    return ret;
+}
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
     int ret;
 
+    /* the prefetch thread already limited the download to the segment */
+    if (pls->prefetch_cur)
+        return read_prefetched(pls->parent->priv_data, pls, buf, buf_size);
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -1128,6 +1474,32 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     return ret;
 }
 
+/* Release the slot of the segment which has been read completely */
+static void prefetch_release(struct playlist *pls)
+{
+    PrefetchSlot *slot = pls->prefetch_cur;
+    int64_t time = slot->end_time - slot->start_time;
+
+    if (!slot->error) {
+        pls->prefetch_bytes += slot->data_len;
+        pls->prefetch_time  += time;
+        pls->prefetch_segments++;
+        av_log(pls->parent, AV_LOG_VERBOSE,
+               "Prefetched segment %"PRId64" of playlist %d: %"PRId64" bytes "
+               "in %"PRId64" ms, %"PRId64" kbit/s\n", slot->seq_no, pls->index,
+               slot->data_len, time / 1000, slot->data_len * 8000 / FFMAX(time, 1));
+
+        for (int i = 0; i < pls->n_main_streams; i++) {
+            AVStream *st = pls->main_streams[i];
+            av_dict_set_int(&st->metadata, "prefetch_bandwidth",
+                            pls->prefetch_bytes * 8000000 / FFMAX(pls->prefetch_time, 1), 0);
+            st->event_flags |= AVSTREAM_EVENT_FLAG_METADATA_UPDATED;
+        }
+    }
+
+    prefetch_stop(slot);
+}
+
 /* Parse the raw ID3 data and pass contents to caller */
 static void parse_id3(AVFormatContext *s, AVIOContext *pb,
                       AVDictionary **metadata, int64_t *dts, HLSAudioSetupInfo *audio_setup_info,
@@ -1536,7 +1908,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch_cur) || (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1607,7 +1979,16 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        ret = AVERROR(EAGAIN);
+        if (c->prefetch_segments > 0) {
+            ret = prefetch_open(c, v);
+            if (ret == AVERROR_EXIT)
+                return ret;
+        }
+        if (ret >= 0) {
+            /* drop the connection kept alive for the previous segment */
+            ff_format_io_close(v->parent, &v->input);
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1636,7 +2017,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1646,7 +2027,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->prefetch_segments &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1670,6 +2051,8 @@ reload:
 
     seg = current_segment(v);
     ret = read_from_url(v, seg, buf, buf_size);
+    if (ret == AVERROR_EXIT && v->prefetch_cur)
+        return ret;
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
             /* Intercept ID3 tags here, elementary audio streams are required
@@ -1679,7 +2062,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch_cur) {
+        prefetch_release(v);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1989,6 +2374,11 @@ static int hls_read_header(AVFormatContext *s)
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
+    if (!HAVE_THREADS && c->prefetch_segments) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching requires thread support\n");
+        c->prefetch_segments = 0;
+    }
+
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
@@ -2134,6 +2524,7 @@ static int hls_read_header(AVFormatContext *s)
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next = NULL;
             pls->input_next_requested = 0;
+            prefetch_reset(pls);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2296,6 +2687,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            prefetch_reset(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2552,6 +2944,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        prefetch_reset(pls);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2646,6 +3039,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments of each playlist to download concurrently ahead of time",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Maximum size of the data prefetched for each playlist",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 * 1024 * 1024}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -42,6 +42,7 @@
 
 #include "libavcodec/defs.h"
 
+#include "asyncwriter.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "avc.h"
@@ -74,6 +75,11 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -90,6 +96,9 @@ typedef struct HLSSegment {
 
     struct HLSSegment *next;
     double discont_program_date_time;
+
+    HLSPart *parts;
+    int nb_parts;
 } HLSSegment;
 
 typedef enum HLSFlags {
@@ -146,6 +155,14 @@ typedef struct VariantStream {
     int64_t start_pos;    // last segment starting position
     int64_t size;         // last segment size
     int nb_entries;
+
+    HLSPart *parts;       // parts of the segment being written
+    int nb_parts;
+    double parts_duration;
+    int64_t part_start_pts;
+    int part_independent;
+    int part_start_offset; // part starting position in the segment buffer
+
     int discontinuity_set;
     int discontinuity;
     int reference_stream_index;
@@ -205,6 +222,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
     uint32_t flags;        // enum HLSFlags
@@ -263,6 +281,8 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+    int async_io;
+    FFAsyncWriter *writer;
 } HLSContext;
 
 static int strftime_expand(const char *fmt, char **dest)
@@ -288,8 +308,10 @@ static int strftime_expand(const char *fmt, char **dest)
     return r;
 }
 
-static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *filename,
-                          AVDictionary **options)
+/* With async_io, these are called on the writer thread, and must only read
+ * the options of the context. */
+static int hlsenc_io_open_direct(AVFormatContext *s, AVIOContext **pb, const char *filename,
+                                 AVDictionary **options)
 {
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
@@ -309,7 +331,7 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *file
     return err;
 }
 
-static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
+static int hlsenc_io_close_direct(AVFormatContext *s, AVIOContext **pb, const char *filename)
 {
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
@@ -329,6 +351,43 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, const char *filename,
+                          AVDictionary **options)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer)
+        return ff_async_writer_open(hls->writer, pb, filename, options);
+    return hlsenc_io_open_direct(s, pb, filename, options);
+}
+
+static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, const char *filename)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer)
+        return ff_async_writer_close(hls->writer, pb);
+    return hlsenc_io_close_direct(s, pb, filename);
+}
+
+/* close pb, also when the connection is persistent */
+static int hlsenc_io_close_final(AVFormatContext *s, AVIOContext **pb)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (hls->writer)
+        return ff_async_writer_close(hls->writer, pb);
+    return ff_format_io_close(s, pb);
+}
+
+static int hlsenc_rename(HLSContext *hls, const char *url_src, const char *url_dst,
+                         void *logctx)
+{
+    if (hls->writer)
+        return ff_async_writer_rename(hls->writer, url_src, url_dst);
+    return ff_rename(url_src, url_dst, logctx);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -609,6 +668,29 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+/* the name of a part of a segment, e.g. "seg3.part1.m4s" for "seg3.m4s" */
+static void get_part_filename(char *buf, int size, const char *segment, int part)
+{
+    const char *ext = strrchr(av_basename(segment), '.');
+    int len = ext ? ext - segment : strlen(segment);
+
+    snprintf(buf, size, "%.*s.part%d%s", len, segment, part, ext ? ext : "");
+}
+
+/* the final name of the segment being written, as listed in the playlist
+ * if relative is set */
+static void get_segment_filename(HLSContext *hls, VariantStream *vs,
+                                 char *buf, int size, int relative)
+{
+    const char *url = vs->avf->url;
+    size_t len;
+
+    av_strlcpy(buf, relative && !hls->use_localtime_mkdir ? av_basename(url) : url, size);
+    len = strlen(buf);
+    if ((hls->flags & HLS_TEMP_FILE) && len > 4 && !strcmp(buf + len - 4, ".tmp"))
+        buf[len - 4] = '\0';
+}
+
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            char *path, const char *proto)
 {
@@ -626,6 +708,10 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
 
         //Nothing to write
         hlsenc_io_close(avf, &hls->http_delete, path);
+    } else if (hls->writer) {
+        int ret = ff_async_writer_delete(hls->writer, path, NULL);
+        if (ret < 0)
+            return hls->ignore_io_errors ? 1 : ret;
     } else if (unlink(path) < 0) {
         av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                path, strerror(errno));
@@ -713,6 +799,24 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         if (ret = hls_delete_file(hls, s, path.str, proto))
             goto fail;
 
+        for (int i = 0; i < segment->nb_parts; i++) {
+            char part[MAX_URL_SIZE];
+
+            get_part_filename(part, sizeof(part), segment->filename, i);
+            av_bprint_clear(&path);
+            if (!hls->use_localtime_mkdir)
+                av_bprintf(&path, "%s/", dirname);
+            av_bprintf(&path, "%s", part);
+
+            if (!av_bprint_is_complete(&path)) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+
+            if (ret = hls_delete_file(hls, s, path.str, proto))
+                goto fail;
+        }
+
         if ((segment->sub_filename[0] != '\0')) {
             vtt_dirname_r = av_strdup(vs->vtt_avf->url);
             vtt_dirname = av_dirname(vtt_dirname_r);
@@ -732,6 +836,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
+        av_freep(&previous_segment->parts);
         av_freep(&previous_segment);
     }
 
@@ -1088,7 +1193,7 @@ static int sls_flag_check_duration_size(HLSContext *hls, VariantStream *vs)
 static void sls_flag_file_rename(HLSContext *hls, VariantStream *vs, char *old_filename) {
     if ((hls->flags & (HLS_SECOND_LEVEL_SEGMENT_SIZE | HLS_SECOND_LEVEL_SEGMENT_DURATION)) &&
         strlen(vs->current_segment_final_filename_fmt)) {
-        ff_rename(old_filename, vs->avf->url, hls);
+        hlsenc_rename(hls, old_filename, vs->avf->url, hls);
     }
 }
 
@@ -1191,6 +1296,12 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
+    vs->parts_duration    = 0;
+    vs->part_start_offset = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1224,8 +1335,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             vs->old_segments = en;
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
-        } else
+        } else {
+            av_freep(&en->parts);
             av_freep(&en);
+        }
     } else
         vs->nb_entries++;
 
@@ -1387,6 +1500,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        av_freep(&en->parts);
         av_freep(&en);
     }
 }
@@ -1400,7 +1514,7 @@ static int hls_rename_temp_file(AVFormatContext *s, AVFormatContext *oc)
     if (!final_filename)
         return AVERROR(ENOMEM);
     final_filename[len-4] = '\0';
-    ret = ff_rename(oc->url, final_filename, s);
+    ret = hlsenc_rename(s->priv_data, oc->url, final_filename, s);
     oc->url[len-4] = '\0';
     av_freep(&final_filename);
     return ret;
@@ -1617,7 +1731,7 @@ fail:
         hls->master_m3u8_created = 1;
     hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
     if (use_temp_file)
-        ff_rename(temp_filename, hls->master_m3u8_url, s);
+        hlsenc_rename(hls, temp_filename, hls->master_m3u8_url, s);
 
     return ret;
 }
@@ -1627,6 +1741,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     HLSContext *hls = s->priv_data;
     HLSSegment *en;
     int target_duration = 0;
+    int nb_segments = 0, segment_idx = 0;
     int ret = 0;
     char temp_filename[MAX_URL_SIZE];
     char temp_vtt_filename[MAX_URL_SIZE];
@@ -1678,7 +1793,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     for (en = vs->segments; en; en = en->next) {
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
+        nb_segments++;
     }
+    /* the playlist may only have parts so far */
+    if (!nb_segments && hls->part_time > 0)
+        target_duration = lrint(ceil(hls->time / (double)AV_TIME_BASE));
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
@@ -1691,6 +1810,8 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
+    if (hls->part_time > 0)
+        ff_hls_write_part_info(vs->out, hls->part_time / (double)AV_TIME_BASE);
     for (en = vs->segments; en; en = en->next) {
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
@@ -1707,6 +1828,18 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        /* only the parts of the last two segments are listed, as they
+         * must not stay more than three target durations in the playlist */
+        if (segment_idx++ >= nb_segments - 2) {
+            for (int i = 0; i < en->nb_parts; i++) {
+                char part[MAX_URL_SIZE];
+
+                get_part_filename(part, sizeof(part), en->filename, i);
+                ff_hls_write_part(vs->out, en->parts[i].duration, hls->baseurl,
+                                  part, en->parts[i].independent);
+            }
+        }
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1720,6 +1853,21 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (!last && vs->nb_parts) {
+        char segment[MAX_URL_SIZE], part[MAX_URL_SIZE];
+
+        if (!vs->segments)
+            ff_hls_write_init_file(vs->out, vs->fmp4_init_filename, 0, 0, 0);
+        get_segment_filename(hls, vs, segment, sizeof(segment), 1);
+        for (int i = 0; i < vs->nb_parts; i++) {
+            get_part_filename(part, sizeof(part), segment, i);
+            ff_hls_write_part(vs->out, vs->parts[i].duration, hls->baseurl,
+                              part, vs->parts[i].independent);
+        }
+        get_part_filename(part, sizeof(part), segment, vs->nb_parts);
+        ff_hls_write_preload_hint(vs->out, hls->baseurl, part);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -1755,9 +1903,9 @@ fail:
     }
     hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
     if (use_temp_file) {
-        ff_rename(temp_filename, vs->m3u8_name, s);
+        hlsenc_rename(hls, temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
-            ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
+            hlsenc_rename(hls, temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs, last) < 0)
@@ -2501,6 +2649,86 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     return ret;
 }
+static int write_init_file(AVFormatContext *s, VariantStream *vs, int byterange_mode)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+/**
+ * Flush the samples buffered since the previous part as a fragment and
+ * write it out as a part of the current segment, without waiting for the
+ * end of the segment.
+ */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    char segment[MAX_URL_SIZE], filename[MAX_URL_SIZE];
+    uint8_t *buffer;
+    int size, ret;
+
+    if (!vs->init_range_length) {
+        av_write_frame(oc, NULL); /* Write the moov */
+        ret = write_init_file(s, vs, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    av_write_frame(oc, NULL); /* Flush any buffered data */
+    size = avio_get_dyn_buf(oc->pb, &buffer);
+    if (size <= vs->part_start_offset)
+        return 0;
+
+    ret = av_reallocp_array(&vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (ret < 0) {
+        vs->nb_parts = 0;
+        return ret;
+    }
+
+    get_segment_filename(hls, vs, segment, sizeof(segment), 0);
+    get_part_filename(filename, sizeof(filename), segment, vs->nb_parts);
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->out, filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", filename);
+        return hls->ignore_io_errors ? 0 : ret;
+    }
+    avio_write(vs->out, buffer + vs->part_start_offset, size - vs->part_start_offset);
+    ret = hlsenc_io_close(s, &vs->out, filename);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "upload part failed.\n");
+        ff_format_io_close(s, &vs->out);
+    }
+
+    vs->parts[vs->nb_parts].duration    = duration;
+    vs->parts[vs->nb_parts].independent = vs->part_independent;
+    vs->nb_parts++;
+    vs->parts_duration   += duration;
+    vs->part_start_offset = size;
+
+    return 0;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2604,19 +2832,14 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = write_init_file(s, vs, byterange_mode);
+                if (ret < 0)
+                    return ret;
+            }
+            if (hls->part_time > 0) {
+                ret = hls_write_part(s, vs, (pkt->pts - vs->part_start_pts) * av_q2d(st->time_base));
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2712,6 +2935,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         ret = hls_append_segment(s, hls, vs, cur_duration, vs->start_pos, vs->size);
         vs->end_pts = pkt->pts;
         vs->duration = 0;
+        vs->part_start_pts = pkt->pts;
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
         if (ret < 0) {
             av_freep(&old_filename);
             return ret;
@@ -2768,6 +2993,29 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
+    if (hls->part_time > 0 && is_ref_pkt && pkt->pts != AV_NOPTS_VALUE) {
+        if (vs->part_start_pts == AV_NOPTS_VALUE) {
+            vs->part_start_pts = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        } else if (pkt->pts > vs->part_start_pts &&
+                   av_compare_ts(pkt->pts + pkt->duration - vs->part_start_pts, st->time_base,
+                                 hls->part_time, AV_TIME_BASE_Q) > 0) {
+            /* end the part before it exceeds the part target duration */
+            ret = hls_write_part(s, vs, (pkt->pts - vs->part_start_pts) * av_q2d(st->time_base));
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0) {
+                av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
+                ff_format_io_close(s, &vs->out);
+                if ((ret = hls_window(s, 0, vs)) < 0)
+                    return ret;
+            }
+        }
+    }
+
     vs->packets_written++;
     if (oc->pb) {
         ret = ff_write_chained(oc, stream_index, pkt, s, 0);
@@ -2790,6 +3038,8 @@ static void hls_deinit(AVFormatContext *s)
     int i = 0;
     VariantStream *vs = NULL;
 
+    ff_async_writer_free(&hls->writer);
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2805,6 +3055,7 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        av_freep(&vs->parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2871,10 +3122,15 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    hlsenc_io_close_final(s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
+            if (hls->part_time > 0) {
+                ret = hls_write_part(s, vs, vs->duration + vs->dpp - vs->parts_duration);
+                if (ret < 0)
+                    goto failed;
+            }
         }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
@@ -2941,7 +3197,7 @@ failed:
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            hlsenc_io_close_final(s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
         if (ret < 0) {
@@ -2954,6 +3210,12 @@ failed:
         av_free(old_filename);
     }
 
+    if (hls->writer) {
+        ret = ff_async_writer_flush(hls->writer);
+        if (ret < 0 && !hls->ignore_io_errors)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -3054,6 +3316,39 @@ static int hls_init(AVFormatContext *s)
                "enabled together. Disabling 'independent_segments' flag\n");
     }
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires the fmp4 segment type\n");
+            return AVERROR(EINVAL);
+        }
+        if ((hls->flags & (HLS_SINGLE_FILE | HLS_SECOND_LEVEL_SEGMENT_DURATION |
+                           HLS_SECOND_LEVEL_SEGMENT_SIZE)) ||
+            hls->max_seg_size > 0 || hls->pl_type == PLAYLIST_TYPE_VOD) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time cannot be used with single_file, "
+                   "hls_segment_size, second_level_segment_duration, "
+                   "second_level_segment_size or the vod playlist type\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time >= hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must be shorter than hls_time\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
+    if (hls->async_io) {
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0) {
+            av_log(s, AV_LOG_ERROR, "async_io cannot be used with single_file or hls_segment_size\n");
+            return AVERROR(EINVAL);
+        }
+        ret = ff_async_writer_alloc(&hls->writer, s, hls->async_io,
+                                    hlsenc_io_open_direct, hlsenc_io_close_direct);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(s, AV_LOG_WARNING, "async_io requires threads, writing synchronously\n");
+        } else if (ret < 0) {
+            return ret;
+        }
+    }
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -3064,6 +3359,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3215,6 +3511,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length for low latency HLS", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_vtt_options","set hls vtt list of options for the container format used for hls", OFFSET(vtt_format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
@@ -3267,6 +3564,7 @@ static const AVOption options[] = {
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
     {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    {"async_io", "Write the output files on a background thread, with at most this many pending operations", OFFSET(async_io), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, INT_MAX, E },
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
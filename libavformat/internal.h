@@ -185,6 +185,12 @@ typedef struct FFStream {
                                     support seeking natively. */
     int nb_index_entries;
     unsigned int index_entries_allocated_size;
+    /**
+     * Compact storage of the index used instead of index_entries, see
+     * ff_stream_pack_index(). The entries must then be accessed through
+     * avformat_index_get_entry() and av_index_search_timestamp().
+     */
+    struct FFPackedIndex *packed_index;
 
     int64_t interleaver_chunk_size;
     int64_t interleaver_chunk_duration;
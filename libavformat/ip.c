@@ -18,11 +18,42 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE /* Needed for recvmmsg() */
+
+#include <inttypes.h>
 #include <string.h>
 #include "ip.h"
 #include "libavutil/avstring.h"
+#include "libavutil/log.h"
 #include "libavutil/mem.h"
 
+#if HAVE_RECVMMSG
+#include <netinet/udp.h>
+#endif
+
+#if HAVE_RECVMMSG && defined(UDP_GRO)
+#define CONTROL_SIZE CMSG_SPACE(sizeof(int))
+#else
+#define CONTROL_SIZE 0
+#endif
+
+struct IPRecvBatch {
+    uint8_t *buf;
+    int nb_datagrams, size;
+    int count, cur;
+    /* offset in the current datagram, when it is made of several */
+    int seg_pos;
+    int *lens, *seg_sizes;
+    struct sockaddr_storage *addrs;
+    socklen_t *addr_lens;
+#if HAVE_RECVMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    uint8_t *control;
+#endif
+    uint64_t nb_received, nb_calls, nb_truncated;
+};
+
 static int compare_addr(const struct sockaddr_storage *a,
                         const struct sockaddr_storage *b)
 {
@@ -159,3 +190,151 @@ void ff_ip_reset_filters(IPSourceFilters *filters)
     filters->nb_include_addrs = 0;
     filters->nb_exclude_addrs = 0;
 }
+
+int ff_ip_recv_batch_alloc(IPRecvBatch **batch, int nb_datagrams, int size)
+{
+    IPRecvBatch *b;
+
+#if !HAVE_RECVMMSG
+    nb_datagrams = 1;
+#endif
+    b = *batch = av_mallocz(sizeof(*b));
+    if (!b)
+        return AVERROR(ENOMEM);
+    b->nb_datagrams = nb_datagrams;
+    b->size         = size;
+    b->buf          = av_malloc_array(nb_datagrams, size);
+    b->lens         = av_calloc(nb_datagrams, sizeof(*b->lens));
+    b->seg_sizes    = av_calloc(nb_datagrams, sizeof(*b->seg_sizes));
+    b->addrs        = av_calloc(nb_datagrams, sizeof(*b->addrs));
+    b->addr_lens    = av_calloc(nb_datagrams, sizeof(*b->addr_lens));
+    if (!b->buf || !b->lens || !b->seg_sizes || !b->addrs || !b->addr_lens)
+        goto fail;
+#if HAVE_RECVMMSG
+    b->msgs = av_calloc(nb_datagrams, sizeof(*b->msgs));
+    b->iovs = av_calloc(nb_datagrams, sizeof(*b->iovs));
+    if (!b->msgs || !b->iovs)
+        goto fail;
+    if (CONTROL_SIZE) {
+        b->control = av_calloc(nb_datagrams, CONTROL_SIZE);
+        if (!b->control)
+            goto fail;
+    }
+    for (int i = 0; i < nb_datagrams; i++) {
+        b->iovs[i].iov_base           = b->buf + (size_t)i * size;
+        b->iovs[i].iov_len            = size;
+        b->msgs[i].msg_hdr.msg_name   = &b->addrs[i];
+        b->msgs[i].msg_hdr.msg_iov    = &b->iovs[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+    return 0;
+
+fail:
+    ff_ip_recv_batch_free(batch, NULL);
+    return AVERROR(ENOMEM);
+}
+
+void ff_ip_recv_batch_free(IPRecvBatch **batch, void *log_ctx)
+{
+    IPRecvBatch *b = *batch;
+
+    if (!b)
+        return;
+    if (b->nb_calls)
+        av_log(log_ctx, AV_LOG_VERBOSE,
+               "%"PRIu64" datagrams received in %"PRIu64" system calls (%.2f per call)\n",
+               b->nb_received, b->nb_calls, (double)b->nb_received / b->nb_calls);
+    if (b->nb_truncated)
+        av_log(log_ctx, AV_LOG_WARNING,
+               "%"PRIu64" datagrams were truncated to %d bytes, "
+               "increase the packet size\n", b->nb_truncated, b->size);
+    av_free(b->buf);
+    av_free(b->lens);
+    av_free(b->seg_sizes);
+    av_free(b->addrs);
+    av_free(b->addr_lens);
+#if HAVE_RECVMMSG
+    av_free(b->msgs);
+    av_free(b->iovs);
+    av_free(b->control);
+#endif
+    av_freep(batch);
+}
+
+int ff_ip_recv_batch_fill(IPRecvBatch *b, int fd)
+{
+    int ret;
+
+    b->count = b->cur = b->seg_pos = 0;
+#if HAVE_RECVMMSG
+    for (int i = 0; i < b->nb_datagrams; i++) {
+        struct msghdr *hdr  = &b->msgs[i].msg_hdr;
+        hdr->msg_namelen    = sizeof(b->addrs[i]);
+        hdr->msg_control    = CONTROL_SIZE ? b->control + i * CONTROL_SIZE : NULL;
+        hdr->msg_controllen = CONTROL_SIZE;
+        hdr->msg_flags      = 0;
+    }
+    /* only block until the first datagram */
+    ret = recvmmsg(fd, b->msgs, b->nb_datagrams, MSG_WAITFORONE, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+    for (int i = 0; i < ret; i++) {
+        struct msghdr *hdr = &b->msgs[i].msg_hdr;
+        b->lens[i]      = b->msgs[i].msg_len;
+        b->addr_lens[i] = hdr->msg_namelen;
+        b->seg_sizes[i] = 0;
+        if (hdr->msg_flags & MSG_TRUNC)
+            b->nb_truncated++;
+#ifdef UDP_GRO
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg;
+             cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
+                memcpy(&b->seg_sizes[i], CMSG_DATA(cmsg), sizeof(int));
+        }
+#endif
+    }
+#else
+    b->addr_lens[0] = sizeof(b->addrs[0]);
+    ret = recvfrom(fd, b->buf, b->size, 0,
+                   (struct sockaddr *)&b->addrs[0], &b->addr_lens[0]);
+    if (ret < 0)
+        return ff_neterrno();
+    b->lens[0]      = ret;
+    b->seg_sizes[0] = 0;
+    ret = 1;
+#endif
+    b->count = ret;
+    b->nb_calls++;
+    return ret;
+}
+
+int ff_ip_recv_batch_next(IPRecvBatch *b, uint8_t **data,
+                          struct sockaddr_storage **addr, socklen_t *addr_len)
+{
+    const int i = b->cur;
+    int len;
+
+    if (i >= b->count)
+        return AVERROR(EAGAIN);
+
+    *data = b->buf + (size_t)i * b->size + b->seg_pos;
+    *addr = &b->addrs[i];
+    if (addr_len)
+        *addr_len = b->addr_lens[i];
+    len = b->lens[i] - b->seg_pos;
+    if (b->seg_sizes[i] > 0 && len > b->seg_sizes[i]) {
+        len = b->seg_sizes[i];
+        b->seg_pos += len;
+    } else {
+        b->cur++;
+        b->seg_pos = 0;
+    }
+    b->nb_received++;
+    return len;
+}
+
+int ff_ip_recv_batch_pending(const IPRecvBatch *b)
+{
+    return b->cur < b->count;
+}
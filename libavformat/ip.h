@@ -69,4 +69,51 @@ int ff_ip_parse_blocks(void *log_ctx, const char *buf, IPSourceFilters *filters)
  */
 void ff_ip_reset_filters(IPSourceFilters *filters);
 
+/**
+ * Buffers for receiving UDP datagrams by batches, with a single system call
+ * where supported.
+ */
+typedef struct IPRecvBatch IPRecvBatch;
+
+/**
+ * Allocates a batch receiving up to nb_datagrams datagrams of up to size
+ * bytes each. Only one datagram per call is received on systems without
+ * recvmmsg().
+ * @return 0 on success, < 0 AVERROR code on error.
+ */
+int ff_ip_recv_batch_alloc(IPRecvBatch **batch, int nb_datagrams, int size);
+
+/**
+ * Frees the batch, logging the number of datagrams per system call and
+ * the number of datagrams truncated to the slot size.
+ */
+void ff_ip_recv_batch_free(IPRecvBatch **batch, void *log_ctx);
+
+/**
+ * Receives the datagrams available on the socket, or waits for one if the
+ * socket is blocking. The datagrams not yet returned by
+ * ff_ip_recv_batch_next() are discarded.
+ * @return the number of datagrams received, < 0 AVERROR code on error.
+ */
+int ff_ip_recv_batch_fill(IPRecvBatch *batch, int fd);
+
+/**
+ * Returns the next datagram of the batch. Datagrams coalesced by the
+ * kernel (UDP GRO) are split back into the original datagrams.
+ * @param data set to the datagram, which stays valid until the next call to
+ *             ff_ip_recv_batch_fill()
+ * @param addr set to the source address of the datagram
+ * @param addr_len if not NULL, set to the size of the source address
+ * @return the size of the datagram, AVERROR(EAGAIN) if all of them have
+ *         been returned.
+ */
+int ff_ip_recv_batch_next(IPRecvBatch *batch, uint8_t **data,
+                          struct sockaddr_storage **addr, socklen_t *addr_len);
+
+/**
+ * Checks whether some received datagrams have not been returned yet. Those
+ * are not signaled by poll() on the socket.
+ */
+int ff_ip_recv_batch_pending(const IPRecvBatch *batch);
+
 #endif /* AVFORMAT_IP_H */
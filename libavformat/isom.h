@@ -379,6 +379,8 @@ typedef struct MOVContext {
     int thmb_item_id;
     int64_t idat_offset;
     int interleaved_read;
+    char *index_file;       ///< side-car file caching the fragment index
+    int64_t moov_pos, moov_size;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
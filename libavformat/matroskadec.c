@@ -1084,10 +1084,31 @@ static int ebml_read_ascii(AVIOContext *pb, int size,
  * 0 is success, < 0 or NEEDS_CHECKING is failure.
  */
 static int ebml_read_binary(AVIOContext *pb, int length,
-                            int64_t pos, EbmlBin *bin)
+                            int64_t pos, EbmlBin *bin, int may_reference)
 {
     int ret;
 
+    /* Block data is only ever read, so it may reference the memory of the
+     * protocol instead of being copied. */
+    if (may_reference) {
+        AVBufferRef *buf;
+
+        ret = ffio_read_buffer(pb, &buf, length);
+        if (ret != AVERROR(ENOSYS)) {
+            av_buffer_unref(&bin->buf);
+            if (ret < 0) {
+                bin->data = NULL;
+                bin->size = 0;
+                return ret;
+            }
+            bin->buf  = buf;
+            bin->data = buf->data;
+            bin->size = length;
+            bin->pos  = pos;
+            return 0;
+        }
+    }
+
     ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
     if (ret < 0)
         return ret;
@@ -1485,7 +1506,9 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        res = ebml_read_binary(pb, length, pos_alt, data,
+                               id == MATROSKA_ID_SIMPLEBLOCK ||
+                               id == MATROSKA_ID_BLOCK);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
@@ -3194,7 +3217,7 @@ static int matroska_parse_tracks(AVFormatContext *s)
         }
 
         st = track->stream = avformat_new_stream(s, NULL);
-        if (!st) {
+        if (!st || ff_stream_pack_index(st) < 0) {
             av_free(key_id_base64);
             return AVERROR(ENOMEM);
         }
@@ -4319,6 +4342,7 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     MatroskaTrack *tracks = NULL;
     AVStream *st = s->streams[stream_index];
     FFStream *const sti = ffstream(st);
+    const AVIndexEntry *e;
     int i, index;
 
     /* Parse the CUES now since we need the index data to seek. */
@@ -4329,11 +4353,12 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
 
     if (!sti->nb_index_entries)
         goto err;
-    timestamp = FFMAX(timestamp, sti->index_entries[0].timestamp);
+    timestamp = FFMAX(timestamp, avformat_index_get_entry(st, 0)->timestamp);
 
     if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
          index == sti->nb_index_entries - 1) {
-        matroska_reset_status(matroska, 0, sti->index_entries[sti->nb_index_entries - 1].pos);
+        matroska_reset_status(matroska, 0,
+                              avformat_index_get_entry(st, sti->nb_index_entries - 1)->pos);
         while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0 ||
                index == sti->nb_index_entries - 1) {
             matroska_clear_queue(matroska);
@@ -4356,17 +4381,18 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     }
 
     /* We seek to a level 1 element, so set the appropriate status. */
-    matroska_reset_status(matroska, 0, sti->index_entries[index].pos);
+    e = avformat_index_get_entry(st, index);
+    matroska_reset_status(matroska, 0, e->pos);
     if (flags & AVSEEK_FLAG_ANY) {
         sti->skip_to_keyframe = 0;
         matroska->skip_to_timecode = timestamp;
     } else {
         sti->skip_to_keyframe = 1;
-        matroska->skip_to_timecode = sti->index_entries[index].timestamp;
+        matroska->skip_to_timecode = e->timestamp;
     }
     matroska->skip_to_keyframe = 1;
     matroska->done             = 0;
-    avpriv_update_cur_dts(s, st, sti->index_entries[index].timestamp);
+    avpriv_update_cur_dts(s, st, e->timestamp);
     return 0;
 err:
     // slightly hackish but allows proper fallback to
@@ -4411,28 +4437,32 @@ typedef struct {
  */
 static CueDesc get_cue_desc(AVFormatContext *s, int64_t ts, int64_t cues_start) {
     MatroskaDemuxContext *matroska = s->priv_data;
-    FFStream *const sti = ffstream(s->streams[0]);
-    AVIndexEntry *const index_entries = sti->index_entries;
-    int nb_index_entries = sti->nb_index_entries;
+    AVStream *const st = s->streams[0];
+    int nb_index_entries = ffstream(st)->nb_index_entries;
+    const AVIndexEntry *e;
     CueDesc cue_desc;
     int i;
 
     if (ts >= (int64_t)(matroska->duration * matroska->time_scale))
         return (CueDesc) {-1, -1, -1, -1};
+    /* The entries are possibly packed, so only one can be accessed at once. */
     for (i = 1; i < nb_index_entries; i++) {
-        if (index_entries[i - 1].timestamp * matroska->time_scale <= ts &&
-            index_entries[i].timestamp * matroska->time_scale > ts) {
+        int64_t prev_ts = avformat_index_get_entry(st, i - 1)->timestamp;
+        if (prev_ts * matroska->time_scale <= ts &&
+            avformat_index_get_entry(st, i)->timestamp * matroska->time_scale > ts) {
             break;
         }
     }
     --i;
-    if (index_entries[i].timestamp > matroska->duration)
+    e = avformat_index_get_entry(st, i);
+    if (e->timestamp > matroska->duration)
         return (CueDesc) {-1, -1, -1, -1};
-    cue_desc.start_time_ns = index_entries[i].timestamp * matroska->time_scale;
-    cue_desc.start_offset = index_entries[i].pos - matroska->segment_start;
+    cue_desc.start_time_ns = e->timestamp * matroska->time_scale;
+    cue_desc.start_offset = e->pos - matroska->segment_start;
     if (i != nb_index_entries - 1) {
-        cue_desc.end_time_ns = index_entries[i + 1].timestamp * matroska->time_scale;
-        cue_desc.end_offset = index_entries[i + 1].pos - matroska->segment_start;
+        e = avformat_index_get_entry(st, i + 1);
+        cue_desc.end_time_ns = e->timestamp * matroska->time_scale;
+        cue_desc.end_offset = e->pos - matroska->segment_start;
     } else {
         cue_desc.end_time_ns = matroska->duration * matroska->time_scale;
         // FIXME: this needs special handling for files where Cues appear
@@ -4459,7 +4489,7 @@ static int webm_clusters_start_with_keyframe(AVFormatContext *s)
     index = av_index_search_timestamp(st, 0, 0);
     if (index < 0)
         return 0;
-    cluster_pos = sti->index_entries[index].pos;
+    cluster_pos = avformat_index_get_entry(st, index)->pos;
     before_pos = avio_tell(s->pb);
     while (1) {
         uint64_t cluster_id, cluster_length;
@@ -4585,7 +4615,7 @@ static int64_t webm_dash_manifest_compute_bandwidth(AVFormatContext *s, int64_t
 
     for (int i = 0; i < sti->nb_index_entries; i++) {
         int64_t prebuffer_ns = 1000000000;
-        int64_t time_ns = sti->index_entries[i].timestamp * matroska->time_scale;
+        int64_t time_ns = avformat_index_get_entry(st, i)->timestamp * matroska->time_scale;
         double nano_seconds_per_second = 1000000000.0;
         int64_t prebuffered_ns;
         double prebuffer_bytes = 0.0;
@@ -4741,7 +4771,7 @@ static int webm_dash_manifest_cues(AVFormatContext *s, int64_t init_range)
     // for checking subsegment alignment in the muxer.
     av_bprint_init(&bprint, 0, AV_BPRINT_SIZE_UNLIMITED);
     for (int i = 0; i < sti->nb_index_entries; i++)
-        av_bprintf(&bprint, "%" PRId64",", sti->index_entries[i].timestamp);
+        av_bprintf(&bprint, "%" PRId64",", avformat_index_get_entry(s->streams[0], i)->timestamp);
     if (!av_bprint_is_complete(&bprint)) {
         av_bprint_finalize(&bprint, NULL);
         return AVERROR(ENOMEM);
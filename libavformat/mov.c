@@ -85,6 +85,7 @@ typedef struct MOVParseTableEntry {
 
 static int mov_read_default(MOVContext *c, AVIOContext *pb, MOVAtom atom);
 static int mov_read_mfra(MOVContext *c, AVIOContext *f);
+static int mov_read_index_file(MOVContext *c);
 static void mov_free_stream_context(AVFormatContext *s, AVStream *st);
 
 static int mov_metadata_track_or_disc_number(MOVContext *c, AVIOContext *pb,
@@ -1567,11 +1568,15 @@ static int mov_read_moov(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     }
 
+    c->moov_pos  = avio_tell(pb);
+    c->moov_size = atom.size;
     if ((ret = mov_read_default(c, pb, atom)) < 0)
         return ret;
     /* we parsed the 'moov' atom, we can terminate the parsing as soon as we find the 'mdat' */
     /* so we don't parse the whole file if over a network */
     c->found_moov=1;
+    if (c->index_file && (ret = mov_read_index_file(c)) < 0)
+        return ret;
     return 0; /* now go for mdat */
 }
 
@@ -10448,6 +10453,250 @@ static void fix_stream_ids(AVFormatContext *s)
     }
 }
 
+#define INDEX_FILE_TAG      MKBETAG('F', 'F', 'm', 'i')
+#define INDEX_FILE_VERSION  2
+#define INDEX_FILE_HASH_BITS 160
+/* largest part of a moof box hashed in the fingerprint */
+#define INDEX_FILE_MAX_MOOF (1 << 20)
+
+static int hash_input(AVIOContext *pb, struct AVSHA *sha, int64_t pos, int64_t size)
+{
+    uint8_t buf[4096];
+
+    if (avio_seek(pb, pos, SEEK_SET) != pos)
+        return AVERROR_INVALIDDATA;
+    while (size > 0) {
+        int len = avio_read(pb, buf, FFMIN(size, sizeof(buf)));
+        if (len <= 0)
+            return len < 0 ? len : AVERROR_INVALIDDATA;
+        av_sha_update(sha, buf, len);
+        size -= len;
+    }
+    return 0;
+}
+
+/**
+ * Fingerprint the input with its moov box and the moof boxes of its first
+ * and last fragments, so that an index file is not used for another file
+ * with the same size and moov position.
+ */
+static int mov_index_fingerprint(MOVContext *c, uint8_t *digest)
+{
+    AVIOContext *pb = c->fc->pb;
+    const MOVFragmentIndex *frag_index = &c->frag_index;
+    int64_t pos = avio_tell(pb);
+    struct AVSHA *sha = av_sha_alloc();
+    int ret;
+
+    if (!sha)
+        return AVERROR(ENOMEM);
+    av_sha_init(sha, INDEX_FILE_HASH_BITS);
+
+    ret = hash_input(pb, sha, c->moov_pos, c->moov_size);
+    for (int i = 0; i < 2 && ret >= 0; i++) {
+        int64_t offset = frag_index->item[i ? frag_index->nb_items - 1 : 0].moof_offset;
+        int64_t size;
+
+        if (avio_seek(pb, offset, SEEK_SET) != offset) {
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        size = avio_rb32(pb);
+        if (avio_rl32(pb) != MKTAG('m','o','o','f')) {
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        if (size == 1)
+            size = avio_rb64(pb);
+        ret = hash_input(pb, sha, offset, av_clip64(size, 8, INDEX_FILE_MAX_MOOF));
+    }
+    av_sha_final(sha, digest);
+    av_free(sha);
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR_INVALIDDATA;
+    return ret;
+}
+
+/**
+ * Load the fragment index saved by mov_write_index_file(), as if it came
+ * from a sidx covering the whole file. The header parsing then stops at the
+ * first fragment, and the other fragments are read when reached or sought
+ * to, instead of all being parsed on open.
+ */
+static int mov_read_index_file(MOVContext *c)
+{
+    AVFormatContext *s = c->fc;
+    AVIOContext *in = NULL;
+    int64_t file_size = avio_size(s->pb);
+    int64_t *durations = NULL;
+    uint8_t *has_sidx = NULL;
+    uint8_t digest[INDEX_FILE_HASH_BITS / 8], fingerprint[INDEX_FILE_HASH_BITS / 8];
+    unsigned nb_items;
+    int ret;
+
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) || s->flags & AVFMT_FLAG_IGNIDX ||
+        c->frag_index.nb_items || file_size <= 0)
+        return 0;
+
+    /* a missing index file is created once the whole file has been parsed */
+    if (s->io_open(s, &in, c->index_file, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    if (avio_rb32(in) != INDEX_FILE_TAG || avio_rb32(in) != INDEX_FILE_VERSION ||
+        avio_rb64(in) != file_size || avio_rb64(in) != c->moov_pos ||
+        avio_rb64(in) != c->moov_size || avio_rb32(in) != s->nb_streams) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring index file %s, it does not match the input\n",
+               c->index_file);
+        ff_format_io_close(s, &in);
+        return 0;
+    }
+
+    durations = av_malloc_array(s->nb_streams, sizeof(*durations));
+    has_sidx  = av_malloc(s->nb_streams);
+    if (!durations || !has_sidx) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < s->nb_streams; i++) {
+        MOVStreamContext *sc = s->streams[i]->priv_data;
+        if (avio_rb32(in) != sc->id)
+            goto invalid;
+        has_sidx[i]  = avio_r8(in);
+        durations[i] = avio_rb64(in);
+    }
+
+    nb_items = avio_rb32(in);
+    for (unsigned i = 0; i < nb_items; i++) {
+        int64_t offset = avio_rb64(in);
+        int index;
+
+        if (offset < c->moov_pos + c->moov_size || offset >= file_size || in->eof_reached)
+            goto invalid;
+        index = update_frag_index(c, offset);
+        if (index < 0) {
+            ret = index == -1 ? AVERROR(ENOMEM) : index;
+            goto fail;
+        }
+        for (int j = 0; j < s->nb_streams; j++) {
+            MOVFragmentStreamInfo *info = &c->frag_index.item[index].stream_info[j];
+            info->sidx_pts       = avio_rb64(in);
+            info->first_tfra_pts = avio_rb64(in);
+            info->tfdt_dts       = avio_rb64(in);
+        }
+    }
+    avio_read(in, digest, sizeof(digest));
+    if (!nb_items || in->eof_reached || in->error)
+        goto invalid;
+
+    /* the fragments may not even be at the same positions anymore */
+    ret = mov_index_fingerprint(c, fingerprint);
+    if (ret < 0 && ret != AVERROR_INVALIDDATA)
+        goto fail;
+    if (ret < 0 || memcmp(digest, fingerprint, sizeof(digest))) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring index file %s, it does not match the input\n",
+               c->index_file);
+        ret = 0;
+        goto fail;
+    }
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        MOVStreamContext *sc = s->streams[i]->priv_data;
+        sc->has_sidx = has_sidx[i];
+        s->streams[i]->duration = sc->track_end = durations[i];
+    }
+    av_log(s, AV_LOG_VERBOSE, "Loaded %u fragments from index file %s\n",
+           nb_items, c->index_file);
+    c->frag_index.complete = 1;
+    av_free(durations);
+    av_free(has_sidx);
+    ff_format_io_close(s, &in);
+    return 0;
+
+invalid:
+    av_log(s, AV_LOG_WARNING, "Invalid index file %s, ignoring it\n", c->index_file);
+    ret = 0;
+fail:
+    for (int i = 0; i < c->frag_index.nb_items; i++)
+        av_freep(&c->frag_index.item[i].stream_info);
+    c->frag_index.nb_items = 0;
+    av_free(durations);
+    av_free(has_sidx);
+    ff_format_io_close(s, &in);
+    return ret;
+}
+
+/**
+ * Save the fragment index built by parsing all the fragments on open, so
+ * that mov_read_index_file() can skip it next time.
+ */
+static void mov_write_index_file(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    MOVFragmentIndex *frag_index = &mov->frag_index;
+    uint8_t digest[INDEX_FILE_HASH_BITS / 8];
+    AVIOContext *out = NULL;
+    int ret;
+
+    /* seeking needs the time of every fragment */
+    for (int i = 0; i < frag_index->nb_items; i++) {
+        MOVFragmentIndexItem *item = &frag_index->item[i];
+        int j;
+        for (j = 0; j < item->nb_stream_info; j++) {
+            if (get_stream_info_time(&item->stream_info[j]) != AV_NOPTS_VALUE)
+                break;
+        }
+        if (item->nb_stream_info != s->nb_streams || j == item->nb_stream_info) {
+            av_log(s, AV_LOG_VERBOSE, "Fragment times missing, not writing an index file\n");
+            return;
+        }
+    }
+
+    ret = mov_index_fingerprint(mov, digest);
+    if (ret < 0) {
+        av_log(s, AV_LOG_VERBOSE, "Could not fingerprint the input, not writing an index file\n");
+        return;
+    }
+
+    ret = s->io_open(s, &out, mov->index_file, AVIO_FLAG_WRITE, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not open index file %s for writing: %s\n",
+               mov->index_file, av_err2str(ret));
+        return;
+    }
+
+    avio_wb32(out, INDEX_FILE_TAG);
+    avio_wb32(out, INDEX_FILE_VERSION);
+    avio_wb64(out, avio_size(s->pb));
+    avio_wb64(out, mov->moov_pos);
+    avio_wb64(out, mov->moov_size);
+    avio_wb32(out, s->nb_streams);
+    for (int i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        MOVStreamContext *sc = st->priv_data;
+        avio_wb32(out, sc->id);
+        avio_w8(out, sc->has_sidx);
+        avio_wb64(out, FFMAX(st->duration, sc->track_end));
+    }
+    avio_wb32(out, frag_index->nb_items);
+    for (int i = 0; i < frag_index->nb_items; i++) {
+        MOVFragmentIndexItem *item = &frag_index->item[i];
+        avio_wb64(out, item->moof_offset);
+        for (int j = 0; j < item->nb_stream_info; j++) {
+            avio_wb64(out, item->stream_info[j].sidx_pts);
+            avio_wb64(out, item->stream_info[j].first_tfra_pts);
+            avio_wb64(out, item->stream_info[j].tfdt_dts);
+        }
+    }
+    avio_write(out, digest, sizeof(digest));
+    avio_flush(out);
+    ret = out->error;
+    ff_format_io_close(s, &out);
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Error writing index file %s: %s\n",
+               mov->index_file, av_err2str(ret));
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -10494,6 +10743,10 @@ static int mov_read_header(AVFormatContext *s)
         if (err < 0)
             return err;
     }
+    if (mov->index_file && mov->frag_index.nb_items && !mov->frag_index.complete &&
+        (pb->seekable & AVIO_SEEKABLE_NORMAL) && !(s->flags & AVFMT_FLAG_IGNIDX))
+        mov_write_index_file(s);
+
     // prevent iloc and iinf boxes from being parsed while reading packets.
     // this is needed because an iinf box may have been parsed but ignored
     // for having old infe boxes which create no streams.
@@ -10913,6 +11166,29 @@ static int mov_finalize_packet(AVFormatContext *s, AVStream *st, AVIndexEntry *s
     return 0;
 }
 
+/* Read a sample, referencing the memory of the protocol instead of copying
+ * it when possible; samples modified in place afterwards are always copied. */
+static int mov_get_packet(MOVContext *mov, MOVStreamContext *sc, AVPacket *pkt,
+                          int size)
+{
+    if (!mov->aax_mode && !mov->decryption_key) {
+        AVBufferRef *buf;
+        int64_t pos = avio_tell(sc->pb);
+        int ret = ffio_read_buffer(sc->pb, &buf, size);
+        if (ret != AVERROR(ENOSYS)) {
+            if (ret < 0)
+                return ret;
+            av_packet_unref(pkt);
+            pkt->buf  = buf;
+            pkt->data = buf->data;
+            pkt->size = ret;
+            pkt->pos  = pos;
+            return ret;
+        }
+    }
+    return av_get_packet(sc->pb, pkt, size);
+}
+
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
@@ -11023,7 +11299,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #endif
         else
-            ret = av_get_packet(sc->pb, pkt, sample->size);
+            ret = mov_get_packet(mov, sc, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -11334,6 +11610,7 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "index_file", "Side-car file caching the fragment index", OFFSET(index_file), AV_OPT_TYPE_STRING, {.str = NULL}, .flags = AV_OPT_FLAG_DECODING_PARAM },
 
     { NULL },
 };
@@ -32,6 +32,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
 #include "libavutil/dovi_meta.h"
+#include "libavutil/slicethread.h"
 #include "libavcodec/bytestream.h"
 #include "libavcodec/defs.h"
 #include "libavcodec/get_bits.h"
@@ -63,6 +64,10 @@
 #define PROBE_PACKET_MAX_BUF 8192
 #define PROBE_PACKET_MARGIN 5
 
+/* number of TS packets classified before their PES data is processed
+ * in parallel, see handle_packets_batched() */
+#define BATCH_PACKETS 512
+
 enum MpegTSFilterType {
     MPEGTS_PES,
     MPEGTS_SECTION,
@@ -114,6 +119,37 @@ struct Stream {
     int stream_identifier;
 };
 
+typedef struct BatchPacket {
+    int64_t pos;        ///< position passed to the PES callback
+    int next;           ///< next packet of the same PID in the batch, or -1
+    int ret;            ///< error returned by the processing of the packet
+    uint8_t offset;     ///< offset of the payload, TS_PACKET_SIZE if none
+    uint8_t is_start;
+    uint8_t corrupt;
+} BatchPacket;
+
+typedef struct BatchPID {
+    MpegTSFilter *filter;
+    int first, last;
+} BatchPID;
+
+typedef struct MpegTSBatch {
+    AVSliceThread *slicethread;
+
+    uint8_t *data;      ///< BATCH_PACKETS TS packets
+    BatchPacket packets[BATCH_PACKETS];
+    /** packet output by each TS packet, with size < 0 if none */
+    AVPacket *out[BATCH_PACKETS];
+    int nb_packets;
+    /** next packet to output */
+    int cur;
+
+    /** PIDs whose processing is pending, one slice job each */
+    BatchPID pids[BATCH_PACKETS];
+    int nb_pids;
+    int16_t pid_slot[NB_PID_MAX];
+} MpegTSBatch;
+
 #define MAX_STREAMS_PER_PROGRAM 128
 #define MAX_PIDS_PER_PROGRAM (MAX_STREAMS_PER_PROGRAM + 2)
 struct Program {
@@ -182,6 +218,10 @@ struct MpegTSContext {
 
     AVStream *epg_stream;
     AVBufferPool* pools[32];
+
+    int pes_threads;
+    /** batched parallel PES processing, NULL if disabled */
+    MpegTSBatch *batch;
 };
 
 #define MPEGTS_OPTIONS \
@@ -211,6 +251,8 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"max_packet_size", "maximum size of emitted packet", offsetof(MpegTSContext, max_packet_size), AV_OPT_TYPE_INT,
      {.i64 = 204800}, 1, INT_MAX/2, AV_OPT_FLAG_DECODING_PARAM },
+    {"pes_threads", "number of threads reassembling PES packets, 0 or 1 to disable", offsetof(MpegTSContext, pes_threads), AV_OPT_TYPE_INT,
+     {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -417,6 +459,8 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static void run_batch(MpegTSContext *ts);
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -472,6 +516,9 @@ static void write_section_data(MpegTSContext *ts, MpegTSFilter *tss1,
                     crc_valid = 2;
             }
             if (crc_valid) {
+                /* the callbacks can change the PID filters and streams */
+                if (ts->batch && ts->batch->nb_pids)
+                    run_batch(ts);
                 tss->section_cb(tss1, cur_section_buf, tss->section_h_size);
                 if (crc_valid != 1)
                     tss->last_ver = -1;
@@ -1128,37 +1175,40 @@ static int read_sl_header(PESContext *pes, SLConfigDescr *sl,
     return (get_bits_count(&gb) + 7) >> 3;
 }
 
-static AVBufferRef *buffer_pool_get(MpegTSContext *ts, int size)
+static int init_buffer_pool(MpegTSContext *ts, int index)
 {
-    int index = av_log2(size + AV_INPUT_BUFFER_PADDING_SIZE);
     if (!ts->pools[index]) {
         int pool_size = FFMIN(ts->max_packet_size + AV_INPUT_BUFFER_PADDING_SIZE, 2 << index);
         ts->pools[index] = av_buffer_pool_init(pool_size, NULL);
         if (!ts->pools[index])
-            return NULL;
+            return AVERROR(ENOMEM);
     }
+    return 0;
+}
+
+static AVBufferRef *buffer_pool_get(MpegTSContext *ts, int size)
+{
+    int index = av_log2(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (init_buffer_pool(ts, index) < 0)
+        return NULL;
     return av_buffer_pool_get(ts->pools[index]);
 }
 
 /* return non zero if a packet could be constructed */
-static int mpegts_push_data(MpegTSFilter *filter,
-                            const uint8_t *buf, int buf_size, int is_start,
-                            int64_t pos)
+static int push_pes_data(PESContext *pes, AVPacket *pkt, int *stop_parse,
+                         const uint8_t *buf, int buf_size, int is_start,
+                         int64_t pos)
 {
-    PESContext *pes   = filter->u.pes_filter.opaque;
     MpegTSContext *ts = pes->ts;
     const uint8_t *p;
     int ret, len;
 
-    if (!ts->pkt)
-        return 0;
-
     if (is_start) {
         if (pes->state == MPEGTS_PAYLOAD && pes->data_index > 0) {
-            ret = new_pes_packet(pes, ts->pkt);
+            ret = new_pes_packet(pes, pkt);
             if (ret < 0)
                 return ret;
-            ts->stop_parse = 1;
+            *stop_parse = 1;
         } else {
             reset_pes_packet_state(pes);
         }
@@ -1388,12 +1438,12 @@ skip:
 
                 if (pes->data_index > 0 &&
                     pes->data_index + buf_size > max_packet_size) {
-                    ret = new_pes_packet(pes, ts->pkt);
+                    ret = new_pes_packet(pes, pkt);
                     if (ret < 0)
                         return ret;
                     pes->PES_packet_length = 0;
                     max_packet_size = ts->max_packet_size;
-                    ts->stop_parse = 1;
+                    *stop_parse = 1;
                 } else if (pes->data_index == 0 &&
                            buf_size > max_packet_size) {
                     // pes packet size is < ts size packet and pes data is padded with STUFFING_BYTE
@@ -1412,10 +1462,10 @@ skip:
                 /* emit complete packets with known packet size
                  * decreases demuxer delay for infrequent packets like subtitles from
                  * a couple of seconds to milliseconds for properly muxed files. */
-                if (!ts->stop_parse && pes->PES_packet_length &&
+                if (!*stop_parse && pes->PES_packet_length &&
                     pes->pes_header_size + pes->data_index == pes->PES_packet_length + PES_START_SIZE) {
-                    ts->stop_parse = 1;
-                    ret = new_pes_packet(pes, ts->pkt);
+                    *stop_parse = 1;
+                    ret = new_pes_packet(pes, pkt);
                     pes->state = MPEGTS_SKIP;
                     if (ret < 0)
                         return ret;
@@ -1432,6 +1482,20 @@ skip:
     return 0;
 }
 
+static int mpegts_push_data(MpegTSFilter *filter,
+                            const uint8_t *buf, int buf_size, int is_start,
+                            int64_t pos)
+{
+    PESContext *pes   = filter->u.pes_filter.opaque;
+    MpegTSContext *ts = pes->ts;
+
+    if (!ts->pkt)
+        return 0;
+
+    return push_pes_data(pes, ts->pkt, &ts->stop_parse,
+                         buf, buf_size, is_start, pos);
+}
+
 static PESContext *add_pes_stream(MpegTSContext *ts, int pid, int pcr_pid)
 {
     MpegTSFilter *tss;
@@ -2782,10 +2846,56 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 static int parse_pcr(int64_t *ppcr_high, int *ppcr_low,
                      const uint8_t *packet);
 
+/* The PES callback of these PIDs can access state shared with other PIDs,
+ * so their TS packets are processed as soon as they are classified. */
+static int pes_deferrable(const MpegTSContext *ts, const PESContext *pes)
+{
+    const MpegTSBatch *b = ts->batch;
+    const AVStream *st   = pes->st;
+
+    /* streams are created and probing is requested by the callback */
+    if (!st || st->codecpar->codec_id == AV_CODEC_ID_NONE)
+        return 0;
+    /* timestamps are fixed up with the PCR of another PID */
+    if (ts->fix_teletext_pts &&
+        (st->codecpar->codec_id == AV_CODEC_ID_DVB_TELETEXT ||
+         st->codecpar->codec_id == AV_CODEC_ID_DVB_SUBTITLE))
+        return 0;
+    for (int i = 0; i < b->nb_pids; i++) {
+        const PESContext *other = b->pids[i].filter->u.pes_filter.opaque;
+        if (other->st == st)
+            return 0;
+    }
+    return 1;
+}
+
+/* Queue the current TS packet of a PES PID for run_batch(), or return NULL
+ * if it must be processed now. */
+static BatchPacket *batch_add_packet(MpegTSContext *ts, MpegTSFilter *filter)
+{
+    MpegTSBatch *b = ts->batch;
+    const int n    = b->nb_packets;
+    int slot       = b->pid_slot[filter->pid];
+
+    if (slot < 0) {
+        if (!pes_deferrable(ts, filter->u.pes_filter.opaque))
+            return NULL;
+        slot = b->nb_pids++;
+        b->pid_slot[filter->pid] = slot;
+        b->pids[slot].filter     = filter;
+        b->pids[slot].first      = n;
+    } else {
+        b->packets[b->pids[slot].last].next = n;
+    }
+    b->pids[slot].last = n;
+    return &b->packets[n];
+}
+
 /* handle one TS packet */
 static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
 {
     MpegTSFilter *tss;
+    BatchPacket *bpkt = NULL;
     int len, pid, cc, expected_cc, cc_ok, afc, is_start, is_discontinuity,
         has_adaptation, has_payload;
     const uint8_t *p, *p_end;
@@ -2822,12 +2932,17 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
             tss->last_cc < 0 ||
             expected_cc == cc;
 
+    if (ts->batch && tss->type == MPEGTS_PES)
+        bpkt = batch_add_packet(ts, tss);
+
     tss->last_cc = cc;
     if (!cc_ok) {
         av_log(ts->stream, AV_LOG_DEBUG,
                "Continuity check failed for pid %d expected %d got %d\n",
                pid, expected_cc, cc);
-        if (tss->type == MPEGTS_PES) {
+        if (bpkt) {
+            bpkt->corrupt = 1;
+        } else if (tss->type == MPEGTS_PES) {
             PESContext *pc = tss->u.pes_filter.opaque;
             pc->flags |= AV_PKT_FLAG_CORRUPT;
         }
@@ -2835,7 +2950,9 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
 
     if (packet[1] & 0x80) {
         av_log(ts->stream, AV_LOG_DEBUG, "Packet had TEI flag set; marking as corrupt\n");
-        if (tss->type == MPEGTS_PES) {
+        if (bpkt) {
+            bpkt->corrupt = 1;
+        } else if (tss->type == MPEGTS_PES) {
             PESContext *pc = tss->u.pes_filter.opaque;
             pc->flags |= AV_PKT_FLAG_CORRUPT;
         }
@@ -2903,7 +3020,11 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
     } else {
         int ret;
         // Note: The position here points actually behind the current packet.
-        if (tss->type == MPEGTS_PES) {
+        if (bpkt) {
+            bpkt->offset   = p - packet;
+            bpkt->is_start = !!is_start;
+            bpkt->pos      = pos - ts->raw_packet_size;
+        } else if (tss->type == MPEGTS_PES) {
             if ((ret = tss->u.pes_filter.pes_cb(tss, p, p_end - p, is_start,
                                                 pos - ts->raw_packet_size)) < 0)
                 return ret;
@@ -2930,6 +3051,18 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
     avio_seek(pb, -back, SEEK_CUR);
 
     for (i = 0; i < ts->resync_size; i++) {
+        int len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        if (len > 1) {
+            /* skip the buffered bytes preceding the next sync byte at once */
+            const uint8_t *sync = memchr(pb->buf_ptr, SYNC_BYTE, len);
+            int skip = sync ? sync - pb->buf_ptr : len;
+            if (skip) {
+                avio_skip(pb, skip);
+                i += skip;
+                if (i >= ts->resync_size)
+                    break;
+            }
+        }
         c = avio_r8(pb);
         if (avio_feof(pb))
             return AVERROR_EOF;
@@ -2999,33 +3132,76 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+static void flush_after_seek(MpegTSContext *ts)
+{
+    int i;
+    av_log(ts->stream, AV_LOG_TRACE, "Skipping after seek\n");
+    /* seek detected, flush pes buffer */
+    for (i = 0; i < NB_PID_MAX; i++) {
+        if (ts->pids[i]) {
+            if (ts->pids[i]->type == MPEGTS_PES) {
+                PESContext *pes = ts->pids[i]->u.pes_filter.opaque;
+                av_buffer_unref(&pes->buffer);
+                pes->data_index = 0;
+                pes->state = MPEGTS_SKIP; /* skip until pes header */
+            } else if (ts->pids[i]->type == MPEGTS_SECTION) {
+                ts->pids[i]->u.section_filter.last_ver = -1;
+            }
+            ts->pids[i]->last_cc = -1;
+            ts->pids[i]->last_pcr = -1;
+        }
+    }
+}
+
+/**
+ * Handle the run of TS packets that are entirely in the I/O buffer and
+ * start with a sync byte, without going through read_packet() for each of
+ * them. The packet which ends the run is left to read_packet(), to refill
+ * the buffer or resync.
+ *
+ * @return the number of packets handled; *ret is set if one of them failed
+ */
+static int handle_buffered_packets(MpegTSContext *ts, int max_packets, int *ret)
+{
+    AVIOContext *pb    = ts->stream->pb;
+    const int raw_size = ts->raw_packet_size;
+    /* the sync byte of 192 bytes packets follows a 4 bytes TP_extra_header */
+    const int offset   = raw_size == TS_DVHS_PACKET_SIZE ? 4 : 0;
+    const uint8_t *buf = pb->buf_ptr + offset;
+    int64_t pos;
+    int i, n;
+
+    n = FFMIN((pb->buf_end - pb->buf_ptr) / raw_size, max_packets);
+    for (i = 0; i < n; i++)
+        if (buf[i * raw_size] != SYNC_BYTE)
+            break;
+    n = i;
+    if (!n)
+        return 0;
+
+    /* the position passed on is the one after the 188 bytes of the packet,
+     * as read_packet() leaves it */
+    pos = avio_tell(pb) + offset + TS_PACKET_SIZE;
+    for (i = 0; i < n; ) {
+        *ret = handle_packet(ts, buf + i * raw_size, pos + i * raw_size);
+        i++;
+        if (*ret != 0 || ts->stop_parse > 0)
+            break;
+    }
+    avio_skip(pb, i * raw_size);
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
     int64_t packet_num;
-    int ret = 0;
+    int n, ret = 0;
 
-    if (avio_tell(s->pb) != ts->last_pos) {
-        int i;
-        av_log(ts->stream, AV_LOG_TRACE, "Skipping after seek\n");
-        /* seek detected, flush pes buffer */
-        for (i = 0; i < NB_PID_MAX; i++) {
-            if (ts->pids[i]) {
-                if (ts->pids[i]->type == MPEGTS_PES) {
-                    PESContext *pes = ts->pids[i]->u.pes_filter.opaque;
-                    av_buffer_unref(&pes->buffer);
-                    pes->data_index = 0;
-                    pes->state = MPEGTS_SKIP; /* skip until pes header */
-                } else if (ts->pids[i]->type == MPEGTS_SECTION) {
-                    ts->pids[i]->u.section_filter.last_ver = -1;
-                }
-                ts->pids[i]->last_cc = -1;
-                ts->pids[i]->last_pcr = -1;
-            }
-        }
-    }
+    if (avio_tell(s->pb) != ts->last_pos)
+        flush_after_seek(ts);
 
     ts->stop_parse = 0;
     packet_num = 0;
@@ -3040,6 +3216,16 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        n = handle_buffered_packets(ts, nb_packets ?
+                                    FFMIN(nb_packets - packet_num, INT_MAX) :
+                                    INT_MAX, &ret);
+        if (n > 0) {
+            packet_num += n - 1;
+            if (ret != 0)
+                break;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3052,6 +3238,167 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
     return ret;
 }
 
+static void batch_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    MpegTSContext *ts = priv;
+    MpegTSBatch *b    = ts->batch;
+    PESContext *pes   = b->pids[jobnr].filter->u.pes_filter.opaque;
+
+    for (int n = b->pids[jobnr].first; n >= 0; n = b->packets[n].next) {
+        BatchPacket *bpkt     = &b->packets[n];
+        const uint8_t *packet = b->data + n * TS_PACKET_SIZE;
+        int stop_parse        = 0;
+
+        if (bpkt->corrupt)
+            pes->flags |= AV_PKT_FLAG_CORRUPT;
+        if (bpkt->offset < TS_PACKET_SIZE)
+            bpkt->ret = push_pes_data(pes, b->out[n], &stop_parse,
+                                      packet + bpkt->offset,
+                                      TS_PACKET_SIZE - bpkt->offset,
+                                      bpkt->is_start, bpkt->pos);
+    }
+}
+
+/* Process the queued TS packets, each PID being a slice job. */
+static void run_batch(MpegTSContext *ts)
+{
+    MpegTSBatch *b = ts->batch;
+
+    if (!b->nb_pids)
+        return;
+    avpriv_slicethread_execute(b->slicethread, b->nb_pids, 0);
+    for (int i = 0; i < b->nb_pids; i++)
+        b->pid_slot[b->pids[i].filter->pid] = -1;
+    b->nb_pids = 0;
+}
+
+/**
+ * Read TS packets by batches. The PID classification, PSI and the PES
+ * whose processing depends on other PIDs are handled sequentially as the
+ * packets are read, while the PES reassembly of the other PIDs runs in
+ * parallel once the batch is full. The output packets are indexed by the
+ * TS packet which completed them, so they are returned in the same order
+ * as by handle_packets().
+ */
+static int handle_packets_batched(MpegTSContext *ts, AVPacket *pkt)
+{
+    AVFormatContext *s = ts->stream;
+    MpegTSBatch *b     = ts->batch;
+    const uint8_t *data;
+    int ret = 0;
+
+    if (avio_tell(s->pb) != ts->last_pos) {
+        for (int n = b->cur; n < b->nb_packets; n++)
+            av_packet_unref(b->out[n]);
+        b->cur = b->nb_packets = 0;
+        flush_after_seek(ts);
+    }
+
+    for (;;) {
+        while (b->cur < b->nb_packets) {
+            const int n = b->cur++;
+            if (b->packets[n].ret < 0) {
+                ret = b->packets[n].ret;
+                goto end;
+            }
+            if (b->out[n]->size >= 0) {
+                av_packet_move_ref(pkt, b->out[n]);
+                ret = 0;
+                goto end;
+            }
+        }
+        /* the read error is returned again on the next read */
+        if (ret < 0)
+            break;
+
+        b->cur = b->nb_packets = 0;
+        while (b->nb_packets < BATCH_PACKETS) {
+            const int n     = b->nb_packets;
+            uint8_t *packet = b->data + n * TS_PACKET_SIZE;
+
+            ret = read_packet(s, packet, ts->raw_packet_size, &data);
+            if (ret != 0)
+                break;
+            if (data != packet)
+                memcpy(packet, data, TS_PACKET_SIZE);
+
+            b->packets[n]   = (BatchPacket){ .next = -1, .offset = TS_PACKET_SIZE };
+            b->out[n]->size = -1;
+            ts->pkt         = b->out[n];
+            ts->stop_parse  = 0;
+            b->packets[n].ret = handle_packet(ts, packet, avio_tell(s->pb));
+            finished_reading_packet(s, ts->raw_packet_size);
+            b->nb_packets++;
+
+            /* packets made of sections point to the section buffer */
+            if (b->out[n]->size >= 0 && !b->out[n]->buf &&
+                b->packets[n].ret >= 0)
+                b->packets[n].ret = av_packet_make_refcounted(b->out[n]);
+            if (b->packets[n].ret < 0)
+                break;
+        }
+        run_batch(ts);
+        if (!b->nb_packets)
+            break;
+    }
+
+end:
+    ts->pkt      = pkt;
+    ts->last_pos = avio_tell(s->pb);
+    return ret;
+}
+
+static void free_batch(MpegTSContext *ts)
+{
+    MpegTSBatch *b = ts->batch;
+
+    if (!b)
+        return;
+    avpriv_slicethread_free(&b->slicethread);
+    for (int i = 0; i < BATCH_PACKETS; i++)
+        av_packet_free(&b->out[i]);
+    av_free(b->data);
+    av_freep(&ts->batch);
+}
+
+static int init_batch(MpegTSContext *ts)
+{
+    MpegTSBatch *b;
+    int ret, max_size;
+
+    b = ts->batch = av_mallocz(sizeof(*ts->batch));
+    if (!b)
+        return AVERROR(ENOMEM);
+    b->data = av_mallocz(BATCH_PACKETS * TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!b->data)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < BATCH_PACKETS; i++) {
+        b->out[i] = av_packet_alloc();
+        if (!b->out[i])
+            return AVERROR(ENOMEM);
+    }
+    memset(b->pid_slot, -1, sizeof(b->pid_slot));
+
+    /* the buffer pools are created on first use, which is not thread safe */
+    max_size = FFMAX(ts->max_packet_size, 0xFFFF + PES_START_SIZE);
+    for (int i = 0; i <= av_log2(max_size + AV_INPUT_BUFFER_PADDING_SIZE); i++) {
+        ret = init_buffer_pool(ts, i);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = avpriv_slicethread_create(&b->slicethread, ts, batch_worker, NULL,
+                                    ts->pes_threads);
+    if (ret == AVERROR(ENOSYS)) {
+        av_log(ts->stream, AV_LOG_WARNING,
+               "Threads are not supported, reassembling PES packets sequentially\n");
+        free_batch(ts);
+        return 0;
+    }
+    return FFMIN(ret, 0);
+}
+
 static int mpegts_probe(const AVProbeData *p)
 {
     const int size = p->buf_size;
@@ -3167,6 +3514,12 @@ static int mpegts_read_header(AVFormatContext *s)
         av_log(ts->stream, AV_LOG_TRACE, "tuning done\n");
 
         s->ctx_flags |= AVFMTCTX_NOHEADER;
+
+        if (ts->pes_threads > 1) {
+            int ret = init_batch(ts);
+            if (ret < 0)
+                return ret;
+        }
     } else {
         AVStream *st;
         int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
@@ -3285,7 +3638,10 @@ static int mpegts_read_packet(AVFormatContext *s, AVPacket *pkt)
 
     pkt->size = -1;
     ts->pkt = pkt;
-    ret = handle_packets(ts, 0);
+    if (ts->batch)
+        ret = handle_packets_batched(ts, pkt);
+    else
+        ret = handle_packets(ts, 0);
     if (ret < 0) {
         av_packet_unref(ts->pkt);
         /* flush pes data left */
@@ -3312,6 +3668,7 @@ static void mpegts_free(MpegTSContext *ts)
 {
     int i;
 
+    free_batch(ts);
     clear_programs(ts);
 
     for (i = 0; i < FF_ARRAY_ELEMS(ts->pools); i++)
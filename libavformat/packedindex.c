@@ -0,0 +1,425 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <limits.h>
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+
+#include "avformat_internal.h"
+#include "packedindex.h"
+
+#define BLOCK_SIZE      64
+/* zigzag varints of the timestamp, position and distance, and the size */
+#define MAX_ENTRY_BYTES (10 + 10 + 5 + 5)
+
+typedef struct PackedBlock {
+    uint8_t *data;
+    unsigned allocated;
+    int      size;
+    int      first;     ///< index of the first entry of the block
+    int      nb;
+    int64_t  first_ts;
+    int64_t  last_ts, last_pos;
+} PackedBlock;
+
+struct FFPackedIndex {
+    PackedBlock *blocks;
+    unsigned     blocks_allocated;
+    int          nb_blocks;
+    int          nb_entries;
+
+    /* last decoded block */
+    int          cached_block;
+    AVIndexEntry cache[BLOCK_SIZE + 1];
+};
+
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, uint64_t *v)
+{
+    uint64_t val = 0;
+    int shift = 0;
+
+    do {
+        val |= (uint64_t)(*p & 0x7F) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+    *v = val;
+    return p;
+}
+
+/* the first entry of a block is stored relative to zero */
+static uint8_t *put_entry(uint8_t *p, const AVIndexEntry *e,
+                          int64_t prev_ts, int64_t prev_pos)
+{
+    p = put_varint(p, zigzag(e->timestamp - (uint64_t)prev_ts));
+    p = put_varint(p, zigzag(e->pos - (uint64_t)prev_pos));
+    p = put_varint(p, (uint64_t)e->size << 2 | (e->flags & 3));
+    return put_varint(p, zigzag(e->min_distance));
+}
+
+static int encode_block(PackedBlock *b, const AVIndexEntry *entries, int nb)
+{
+    uint8_t *p;
+
+    av_assert1(nb > 0 && nb <= BLOCK_SIZE);
+    p = av_fast_realloc(b->data, &b->allocated, nb * MAX_ENTRY_BYTES);
+    if (!p)
+        return AVERROR(ENOMEM);
+    b->data = p;
+
+    for (int i = 0; i < nb; i++)
+        p = put_entry(p, &entries[i], i ? entries[i - 1].timestamp : 0,
+                                      i ? entries[i - 1].pos       : 0);
+
+    b->size     = p - b->data;
+    b->nb       = nb;
+    b->first_ts = entries[0].timestamp;
+    b->last_ts  = entries[nb - 1].timestamp;
+    b->last_pos = entries[nb - 1].pos;
+    return 0;
+}
+
+static void decode_block(FFPackedIndex *idx, int n)
+{
+    const PackedBlock *b = &idx->blocks[n];
+    const uint8_t *p = b->data;
+    int64_t ts = 0, pos = 0;
+
+    if (idx->cached_block == n)
+        return;
+
+    for (int i = 0; i < b->nb; i++) {
+        AVIndexEntry *e = &idx->cache[i];
+        uint64_t v;
+
+        p = get_varint(p, &v);
+        ts += (uint64_t)unzigzag(v);
+        p = get_varint(p, &v);
+        pos += (uint64_t)unzigzag(v);
+        e->timestamp = ts;
+        e->pos       = pos;
+        p = get_varint(p, &v);
+        e->size  = v >> 2;
+        e->flags = v & 3;
+        p = get_varint(p, &v);
+        e->min_distance = unzigzag(v);
+    }
+    idx->cached_block = n;
+}
+
+FFPackedIndex *ff_packed_index_alloc(void)
+{
+    FFPackedIndex *idx = av_mallocz(sizeof(*idx));
+    if (idx)
+        idx->cached_block = -1;
+    return idx;
+}
+
+void ff_packed_index_free(FFPackedIndex **pidx)
+{
+    FFPackedIndex *idx = *pidx;
+
+    if (!idx)
+        return;
+    for (int i = 0; i < idx->nb_blocks; i++)
+        av_free(idx->blocks[i].data);
+    av_free(idx->blocks);
+    av_freep(pidx);
+}
+
+int ff_packed_index_count(const FFPackedIndex *idx)
+{
+    return idx->nb_entries;
+}
+
+size_t ff_packed_index_size(const FFPackedIndex *idx)
+{
+    size_t size = sizeof(*idx) + idx->blocks_allocated;
+
+    for (int i = 0; i < idx->nb_blocks; i++)
+        size += idx->blocks[i].allocated;
+    return size;
+}
+
+/* Find the block holding entry n */
+static int find_block(const FFPackedIndex *idx, int n)
+{
+    int a = 0, b = idx->nb_blocks - 1;
+
+    while (a < b) {
+        int m = (a + b + 1) >> 1;
+        if (idx->blocks[m].first <= n)
+            a = m;
+        else
+            b = m - 1;
+    }
+    return a;
+}
+
+const AVIndexEntry *ff_packed_index_get(FFPackedIndex *idx, int n)
+{
+    int b;
+
+    if (n < 0 || n >= idx->nb_entries)
+        return NULL;
+
+    b = find_block(idx, n);
+    decode_block(idx, b);
+    return &idx->cache[n - idx->blocks[b].first];
+}
+
+/* Same algorithm as ff_index_search_timestamp() */
+int ff_packed_index_search(FFPackedIndex *idx, int64_t wanted_timestamp, int flags)
+{
+    const int nb_entries = idx->nb_entries;
+    int a, b, m;
+    int64_t timestamp;
+
+    a = -1;
+    b = nb_entries;
+
+    // Optimize appending index entries at the end.
+    if (b && idx->blocks[idx->nb_blocks - 1].last_ts < wanted_timestamp)
+        a = b - 1;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+
+        // Search for the next non-discarded packet.
+        while ((ff_packed_index_get(idx, m)->flags & AVINDEX_DISCARD_FRAME) &&
+               m < b && m < nb_entries - 1) {
+            m++;
+            if (m == b && ff_packed_index_get(idx, m)->timestamp >= wanted_timestamp) {
+                m = b - 1;
+                break;
+            }
+        }
+
+        timestamp = ff_packed_index_get(idx, m)->timestamp;
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb_entries &&
+               !(ff_packed_index_get(idx, m)->flags & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
+static int insert_block(FFPackedIndex *idx, int n)
+{
+    PackedBlock *blocks;
+
+    if (idx->nb_blocks >= INT_MAX / sizeof(*blocks) - 1)
+        return AVERROR(ENOMEM);
+    blocks = av_fast_realloc(idx->blocks, &idx->blocks_allocated,
+                             (idx->nb_blocks + 1) * sizeof(*blocks));
+    if (!blocks)
+        return AVERROR(ENOMEM);
+    idx->blocks = blocks;
+
+    memmove(&blocks[n + 1], &blocks[n], (idx->nb_blocks - n) * sizeof(*blocks));
+    memset(&blocks[n], 0, sizeof(*blocks));
+    idx->nb_blocks++;
+    if (idx->cached_block >= n)
+        idx->cached_block++;
+    return 0;
+}
+
+static int append_entry(FFPackedIndex *idx, const AVIndexEntry *e)
+{
+    PackedBlock *b = idx->nb_blocks ? &idx->blocks[idx->nb_blocks - 1] : NULL;
+    uint8_t *p;
+    int ret;
+
+    if (!b || b->nb == BLOCK_SIZE) {
+        /* trim the full block to what it uses */
+        if (b && b->allocated > b->size) {
+            p = av_realloc(b->data, b->size);
+            if (p) {
+                b->data      = p;
+                b->allocated = b->size;
+            }
+        }
+        ret = insert_block(idx, idx->nb_blocks);
+        if (ret < 0)
+            return ret;
+        b = &idx->blocks[idx->nb_blocks - 1];
+        b->first = idx->nb_entries;
+        ret = encode_block(b, e, 1);
+        if (ret < 0) {
+            idx->nb_blocks--;
+            return ret;
+        }
+    } else {
+        p = av_fast_realloc(b->data, &b->allocated, b->size + MAX_ENTRY_BYTES);
+        if (!p)
+            return AVERROR(ENOMEM);
+        b->data = p;
+        b->size = put_entry(p + b->size, e, b->last_ts, b->last_pos) - p;
+        b->last_ts  = e->timestamp;
+        b->last_pos = e->pos;
+        b->nb++;
+        if (idx->cached_block == idx->nb_blocks - 1)
+            idx->cached_block = -1;
+    }
+    return idx->nb_entries++;
+}
+
+/* Replace (insert = 0) or insert an entry at position n */
+static int update_entry(FFPackedIndex *idx, int n, const AVIndexEntry *e, int insert)
+{
+    int nb, bn = find_block(idx, n), ret;
+    PackedBlock *b = &idx->blocks[bn];
+    const int offset = n - b->first;
+
+    decode_block(idx, bn);
+    nb = b->nb;
+    idx->cached_block = -1;
+
+    if (insert) {
+        memmove(&idx->cache[offset + 1], &idx->cache[offset],
+                (nb - offset) * sizeof(*idx->cache));
+        nb++;
+    }
+    idx->cache[offset] = *e;
+
+    if (nb > BLOCK_SIZE) {
+        /* split the block in two halves */
+        const int half = nb >> 1;
+
+        ret = insert_block(idx, bn + 1);
+        if (ret < 0)
+            return ret;
+        b = &idx->blocks[bn];
+        ret = encode_block(&idx->blocks[bn + 1], &idx->cache[half], nb - half);
+        if (ret < 0) {
+            memmove(&idx->blocks[bn + 1], &idx->blocks[bn + 2],
+                    (idx->nb_blocks - bn - 2) * sizeof(*idx->blocks));
+            idx->nb_blocks--;
+            return ret;
+        }
+        idx->blocks[bn + 1].first = b->first + half;
+        nb = half;
+    }
+    ret = encode_block(b, idx->cache, nb);
+    if (ret < 0)
+        return ret;
+
+    if (insert) {
+        idx->nb_entries++;
+        for (int i = bn + 1, first = b->first + b->nb; i < idx->nb_blocks; i++) {
+            idx->blocks[i].first = first;
+            first += idx->blocks[i].nb;
+        }
+    }
+    return n;
+}
+
+int ff_packed_index_add(FFPackedIndex *idx, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags)
+{
+    AVIndexEntry e;
+    int index;
+
+    if ((unsigned)idx->nb_entries + 1 >= INT_MAX)
+        return -1;
+
+    if (timestamp == AV_NOPTS_VALUE)
+        return AVERROR(EINVAL);
+
+    if (size < 0 || size > 0x3FFFFFFF)
+        return AVERROR(EINVAL);
+
+    if (is_relative(timestamp)) //FIXME this maintains previous behavior but we should shift by the correct offset once known
+        timestamp -= RELATIVE_TS_BASE;
+
+    e.pos          = pos;
+    e.timestamp    = timestamp;
+    e.size         = size;
+    e.flags        = flags;
+    e.min_distance = distance;
+
+    index = ff_packed_index_search(idx, timestamp, AVSEEK_FLAG_ANY);
+    if (index < 0) {
+        av_assert0(!idx->nb_entries ||
+                   idx->blocks[idx->nb_blocks - 1].last_ts < timestamp);
+        return append_entry(idx, &e);
+    } else {
+        const AVIndexEntry *ie = ff_packed_index_get(idx, index);
+        if (ie->timestamp != timestamp) {
+            if (ie->timestamp <= timestamp)
+                return -1;
+            return update_entry(idx, index, &e, 1);
+        } else if (ie->pos == pos && distance < ie->min_distance) {
+            // do not reduce the distance
+            e.min_distance = ie->min_distance;
+        }
+        return update_entry(idx, index, &e, 0);
+    }
+}
+
+int ff_packed_index_halve(FFPackedIndex *idx)
+{
+    FFPackedIndex tmp = { .cached_block = -1 };
+    int ret = 0;
+
+    for (int i = 0; i < idx->nb_entries; i += 2) {
+        ret = append_entry(&tmp, ff_packed_index_get(idx, i));
+        if (ret < 0) {
+            for (int j = 0; j < tmp.nb_blocks; j++)
+                av_free(tmp.blocks[j].data);
+            av_free(tmp.blocks);
+            return ret;
+        }
+    }
+
+    for (int i = 0; i < idx->nb_blocks; i++)
+        av_free(idx->blocks[i].data);
+    av_free(idx->blocks);
+    *idx = tmp;
+    return 0;
+}
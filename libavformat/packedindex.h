@@ -0,0 +1,77 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PACKEDINDEX_H
+#define AVFORMAT_PACKEDINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * Compact storage of the index entries of a stream.
+ *
+ * The entries are kept sorted by timestamp in blocks of up to 64 entries,
+ * each stored as variable length deltas to the previous entry of its block,
+ * which typically takes a third of the size of an AVIndexEntry.
+ *
+ * Appending is amortized O(1), inserting elsewhere only re-encodes the
+ * block concerned, and lookups decode a single block.
+ */
+typedef struct FFPackedIndex FFPackedIndex;
+
+FFPackedIndex *ff_packed_index_alloc(void);
+
+void ff_packed_index_free(FFPackedIndex **pidx);
+
+int ff_packed_index_count(const FFPackedIndex *idx);
+
+/**
+ * Number of bytes used by the index.
+ */
+size_t ff_packed_index_size(const FFPackedIndex *idx);
+
+/**
+ * Add an entry, with the same semantics as ff_add_index_entry().
+ *
+ * @return the index of the entry, or < 0 on error
+ */
+int ff_packed_index_add(FFPackedIndex *idx, int64_t pos, int64_t timestamp,
+                        int size, int distance, int flags);
+
+/**
+ * Get an entry. The returned pointer is valid until the next call to any
+ * function taking idx.
+ *
+ * @return the entry, or NULL if n is out of range
+ */
+const AVIndexEntry *ff_packed_index_get(FFPackedIndex *idx, int n);
+
+/**
+ * Search for an entry, with the same semantics as
+ * ff_index_search_timestamp().
+ */
+int ff_packed_index_search(FFPackedIndex *idx, int64_t wanted_timestamp, int flags);
+
+/**
+ * Drop every other entry, keeping the first, like ff_reduce_index().
+ */
+int ff_packed_index_halve(FFPackedIndex *idx);
+
+#endif /* AVFORMAT_PACKEDINDEX_H */
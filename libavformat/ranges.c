@@ -0,0 +1,499 @@
+/*
+ * Parallel HTTP range reader
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Splits the reads of a remote file into fixed size chunks, which are
+ * fetched ahead of the read position with concurrent Range requests over
+ * several persistent HTTP connections.
+ *
+ * The chunks are kept in a ring of 2 * connections slots, chunk k living in
+ * slot k % nb_slots, so the slots cover the window of chunks starting at the
+ * one being read. Workers fetch the lowest chunk of the window that is not
+ * present yet; moving the read position moves the window, which frees the
+ * slots of the chunks left behind.
+ */
+
+#include <stdatomic.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "http.h"
+#include "url.h"
+
+typedef struct RangesSlot {
+    uint8_t *data;
+    int64_t  chunk;     ///< chunk held or being fetched, -1 if none
+    int      len;
+    int      fetching;
+    int      error;
+} RangesSlot;
+
+typedef struct RangesWorker {
+    URLContext *h;
+    URLContext *inner;
+    pthread_t   thread;
+    int         thread_started;
+    int         pending;    ///< inner already has a request in flight for slot 0
+} RangesWorker;
+
+typedef struct RangesContext {
+    AVClass        *class;
+    const char     *url;
+    AVDictionary   *inner_options;
+    URLContext     *inner;      ///< used directly when ranges are not supported
+
+    int64_t         logical_pos;
+    int64_t         logical_size;
+    int64_t         read_chunk; ///< first chunk of the window
+
+    RangesSlot     *slots;
+    int             nb_slots;
+    RangesWorker   *workers;
+    int             nb_workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_wakeup_main;
+    pthread_cond_t  cond_wakeup_workers;
+
+    atomic_int      abort_request;
+    AVIOInterruptCB interrupt_callback;
+
+    /* statistics */
+    int64_t         nb_requests;
+    int64_t         nb_connections;
+
+    /* options */
+    int             connections;
+    int             chunk_size;
+} RangesContext;
+
+static int ranges_check_interrupt(void *arg)
+{
+    URLContext    *h = arg;
+    RangesContext *c = h->priv_data;
+
+    if (atomic_load(&c->abort_request))
+        return 1;
+
+    if (ff_check_interrupt(&c->interrupt_callback))
+        atomic_store(&c->abort_request, 1);
+
+    return atomic_load(&c->abort_request);
+}
+
+static int64_t chunk_count(const RangesContext *c)
+{
+    return (c->logical_size + c->chunk_size - 1) / c->chunk_size;
+}
+
+/**
+ * Request a byte range on the connection of a worker, opening a new one if
+ * it cannot be reused. Returns 1 if a new connection was opened.
+ */
+static int request_range(URLContext *h, RangesWorker *w, int64_t start, int64_t end)
+{
+    RangesContext *c = h->priv_data;
+    AVIOInterruptCB interrupt_callback = { .callback = ranges_check_interrupt, .opaque = h };
+    AVDictionary *opts = NULL;
+    int ret;
+
+    if (w->inner) {
+        av_dict_set_int(&opts, "offset", start, 0);
+        av_dict_set_int(&opts, "end_offset", end, 0);
+        ret = ff_http_do_new_request2(w->inner, c->url, &opts);
+        av_dict_free(&opts);
+        if (ret >= 0)
+            return 0;
+        /* the server may have closed the connection, try a new one */
+        ffurl_closep(&w->inner);
+    }
+
+    ret = av_dict_copy(&opts, c->inner_options, 0);
+    if (ret < 0)
+        return ret;
+    av_dict_set_int(&opts, "offset", start, 0);
+    av_dict_set_int(&opts, "end_offset", end, 0);
+    av_dict_set_int(&opts, "multiple_requests", 1, 0);
+    ret = ffurl_open_whitelist(&w->inner, c->url, AVIO_FLAG_READ, &interrupt_callback,
+                               &opts, h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    return ret < 0 ? ret : 1;
+}
+
+static int fetch_chunk(URLContext *h, RangesWorker *w, RangesSlot *slot, int64_t chunk)
+{
+    RangesContext *c = h->priv_data;
+    const int64_t start = chunk * c->chunk_size;
+    const int size = FFMIN(c->chunk_size, c->logical_size - start);
+    int len = 0, ret;
+
+    if (w->pending) {
+        w->pending = 0;
+    } else {
+        ret = request_range(h, w, start, start + size);
+        if (ret < 0)
+            return ret;
+        pthread_mutex_lock(&c->mutex);
+        c->nb_requests++;
+        c->nb_connections += ret;
+        pthread_mutex_unlock(&c->mutex);
+    }
+
+    while (len < size) {
+        ret = ffurl_read(w->inner, slot->data + len, size - len);
+        if (ret == AVERROR_EOF || !ret)
+            break;
+        if (ret < 0)
+            return ret;
+        len += ret;
+    }
+    if (len < size) {
+        av_log(h, AV_LOG_ERROR, "Short read of %d bytes at %"PRId64", expected %d\n",
+               len, start, size);
+        return AVERROR(EIO);
+    }
+    return len;
+}
+
+/* Find the lowest chunk of the window that is neither present nor fetched */
+static RangesSlot *next_chunk(RangesContext *c, int64_t *chunk)
+{
+    const int64_t end = FFMIN(c->read_chunk + c->nb_slots, chunk_count(c));
+
+    for (int64_t k = c->read_chunk; k < end; k++) {
+        RangesSlot *slot = &c->slots[k % c->nb_slots];
+        /* a slot still busy with a chunk left behind is skipped until done */
+        if (slot->chunk == k || slot->fetching)
+            continue;
+        *chunk = k;
+        return slot;
+    }
+    return NULL;
+}
+
+static void *ranges_worker(void *arg)
+{
+    RangesWorker  *w = arg;
+    URLContext    *h = w->h;
+    RangesContext *c = h->priv_data;
+
+    ff_thread_setname("ranges");
+
+    pthread_mutex_lock(&c->mutex);
+    while (!ranges_check_interrupt(h)) {
+        RangesSlot *slot;
+        int64_t chunk;
+        int ret;
+
+        if (w->pending) {
+            slot  = &c->slots[0];
+            chunk = 0;
+        } else {
+            slot = next_chunk(c, &chunk);
+            if (!slot) {
+                pthread_cond_wait(&c->cond_wakeup_workers, &c->mutex);
+                continue;
+            }
+            slot->chunk    = chunk;
+            slot->fetching = 1;
+            slot->len      = 0;
+            slot->error    = 0;
+        }
+        pthread_mutex_unlock(&c->mutex);
+
+        /* the slot is owned by this worker while fetching */
+        ret = fetch_chunk(h, w, slot, chunk);
+        if (ret < 0)
+            ffurl_closep(&w->inner);
+
+        pthread_mutex_lock(&c->mutex);
+        slot->fetching = 0;
+        slot->len      = FFMAX(ret, 0);
+        slot->error    = FFMIN(ret, 0);
+        pthread_cond_broadcast(&c->cond_wakeup_main);
+        /* a slot freed from a chunk left behind may unblock other workers */
+        pthread_cond_broadcast(&c->cond_wakeup_workers);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static int ranges_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    RangesContext *c = h->priv_data;
+    AVIOInterruptCB interrupt_callback = { .callback = ranges_check_interrupt, .opaque = h };
+    AVDictionary *opts = NULL;
+    int64_t size;
+    int ret;
+
+    av_strstart(arg, "ranges:", &arg);
+    c->url = arg;
+    c->interrupt_callback = h->interrupt_callback;
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    /* the options are needed again for every new connection */
+    if (options) {
+        ret = av_dict_copy(&c->inner_options, *options, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    /* the first request fetches chunk 0 and tells whether ranges work */
+    ret = av_dict_copy(&opts, c->inner_options, 0);
+    if (ret < 0)
+        return ret;
+    av_dict_set_int(&opts, "end_offset", c->chunk_size, 0);
+    av_dict_set_int(&opts, "multiple_requests", 1, 0);
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &interrupt_callback, &opts,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(h, AV_LOG_ERROR, "ffurl_open failed : %s, %s\n", av_err2str(ret), arg);
+        return ret;
+    }
+    if (options)
+        av_dict_free(options);
+    c->nb_requests = c->nb_connections = 1;
+
+    size = ffurl_size(c->inner);
+    h->is_streamed = c->inner->is_streamed;
+    if (h->is_streamed || size <= 0 ||
+        (strcmp(c->inner->prot->name, "http") && strcmp(c->inner->prot->name, "https"))) {
+        av_log(h, AV_LOG_VERBOSE, "Range requests not supported, reading sequentially\n");
+        /* the whole file may follow if the range was ignored */
+        if (!strcmp(c->inner->prot->name, "http") || !strcmp(c->inner->prot->name, "https"))
+            av_opt_set_int(c->inner->priv_data, "end_offset", 0, 0);
+        return 0;
+    }
+    c->logical_size = size;
+
+    c->nb_workers = FFMIN(c->connections, chunk_count(c));
+    c->nb_slots   = 2 * c->connections;
+    c->slots   = av_calloc(c->nb_slots, sizeof(*c->slots));
+    c->workers = av_calloc(c->nb_workers, sizeof(*c->workers));
+    if (!c->slots || !c->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < c->nb_slots; i++) {
+        c->slots[i].chunk = -1;
+        c->slots[i].data  = av_malloc(c->chunk_size);
+        if (!c->slots[i].data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
+    /* the first worker takes over the connection with chunk 0 in flight */
+    c->workers[0].inner   = c->inner;
+    c->workers[0].pending = 1;
+    c->inner = NULL;
+    c->slots[0].chunk    = 0;
+    c->slots[0].fetching = 1;
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_main, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&c->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_workers, NULL);
+    if (ret) {
+        pthread_cond_destroy(&c->cond_wakeup_main);
+        pthread_mutex_destroy(&c->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    for (int i = 0; i < c->nb_workers; i++) {
+        RangesWorker *w = &c->workers[i];
+        w->h = h;
+        ret = pthread_create(&w->thread, NULL, ranges_worker, w);
+        if (ret) {
+            av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            /* run with the workers started so far */
+            if (i)
+                break;
+            c->nb_workers = 0;
+            ret = AVERROR(ret);
+            goto fail_thread;
+        }
+        w->thread_started = 1;
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Reading %"PRId64" bytes in chunks of %d over %d connections\n",
+           size, c->chunk_size, c->nb_workers);
+    return 0;
+
+fail_thread:
+    pthread_cond_destroy(&c->cond_wakeup_workers);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+fail:
+    if (c->workers)
+        ffurl_closep(&c->workers[0].inner);
+    for (int i = 0; c->slots && i < c->nb_slots; i++)
+        av_freep(&c->slots[i].data);
+    av_freep(&c->slots);
+    av_freep(&c->workers);
+    ffurl_closep(&c->inner);
+    av_dict_free(&c->inner_options);
+    return ret;
+}
+
+static int ranges_close(URLContext *h)
+{
+    RangesContext *c = h->priv_data;
+
+    if (c->workers) {
+        pthread_mutex_lock(&c->mutex);
+        atomic_store(&c->abort_request, 1);
+        pthread_cond_broadcast(&c->cond_wakeup_workers);
+        pthread_mutex_unlock(&c->mutex);
+
+        for (int i = 0; i < c->nb_workers; i++) {
+            if (c->workers[i].thread_started)
+                pthread_join(c->workers[i].thread, NULL);
+            ffurl_closep(&c->workers[i].inner);
+        }
+
+        pthread_cond_destroy(&c->cond_wakeup_workers);
+        pthread_cond_destroy(&c->cond_wakeup_main);
+        pthread_mutex_destroy(&c->mutex);
+
+        av_log(h, AV_LOG_DEBUG, "Statistics, requests: %"PRId64" connections: %"PRId64"\n",
+               c->nb_requests, c->nb_connections);
+    }
+
+    for (int i = 0; c->slots && i < c->nb_slots; i++)
+        av_freep(&c->slots[i].data);
+    av_freep(&c->slots);
+    av_freep(&c->workers);
+    ffurl_closep(&c->inner);
+    av_dict_free(&c->inner_options);
+    return 0;
+}
+
+static int ranges_read(URLContext *h, unsigned char *buf, int size)
+{
+    RangesContext *c = h->priv_data;
+    int ret;
+
+    if (c->inner)
+        return ffurl_read(c->inner, buf, size);
+
+    if (c->logical_pos >= c->logical_size)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&c->mutex);
+    c->read_chunk = c->logical_pos / c->chunk_size;
+    pthread_cond_broadcast(&c->cond_wakeup_workers);
+
+    for (;;) {
+        RangesSlot *slot = &c->slots[c->read_chunk % c->nb_slots];
+        const int offset = c->logical_pos - c->read_chunk * c->chunk_size;
+
+        if (ranges_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (slot->chunk == c->read_chunk && !slot->fetching) {
+            if (slot->error < 0) {
+                ret = slot->error;
+                /* fetch it again on the next read */
+                slot->chunk = -1;
+                break;
+            }
+            ret = FFMIN(size, slot->len - offset);
+            memcpy(buf, slot->data + offset, ret);
+            c->logical_pos += ret;
+            break;
+        }
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t ranges_seek(URLContext *h, int64_t pos, int whence)
+{
+    RangesContext *c = h->priv_data;
+
+    if (c->inner)
+        return ffurl_seek(c->inner, pos, whence);
+
+    if (whence == AVSEEK_SIZE)
+        return c->logical_size;
+    else if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END)
+        pos += c->logical_size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    /* the window moves with the next read */
+    c->logical_pos = pos;
+    return pos;
+}
+
+#define OFFSET(x) offsetof(RangesContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+
+static const AVOption options[] = {
+    { "connections", "Number of concurrent connections", OFFSET(connections), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, D },
+    { "range_size", "Size in bytes of each range request", OFFSET(chunk_size), AV_OPT_TYPE_INT, { .i64 = 4 << 20 }, 16384, 1 << 28, D },
+    { NULL },
+};
+
+#undef D
+#undef OFFSET
+
+static const AVClass ranges_context_class = {
+    .class_name = "Ranges",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_ranges_protocol = {
+    .name                = "ranges",
+    .url_open2           = ranges_open,
+    .url_read            = ranges_read,
+    .url_seek            = ranges_seek,
+    .url_close           = ranges_close,
+    .priv_data_size      = sizeof(RangesContext),
+    .priv_data_class     = &ranges_context_class,
+};
@@ -42,10 +42,15 @@
 #include <poll.h>
 #endif
 
+#define RTP_BATCH_SIZE 32
+#define RTCP_BATCH_SIZE 4
+
 typedef struct RTPContext {
     const AVClass *class;
     URLContext *rtp_hd, *rtcp_hd, *fec_hd;
     int rtp_fd, rtcp_fd;
+    /* datagrams received from rtp_fd and rtcp_fd */
+    IPRecvBatch *batch[2];
     IPSourceFilters filters;
     int write_to_source;
     struct sockaddr_storage last_rtp_source, last_rtcp_source;
@@ -373,6 +378,12 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     h->max_packet_size = s->rtp_hd->max_packet_size;
     h->is_streamed = 1;
 
+    if (flags & AVIO_FLAG_READ) {
+        if (ff_ip_recv_batch_alloc(&s->batch[0], RTP_BATCH_SIZE,  h->max_packet_size) < 0 ||
+            ff_ip_recv_batch_alloc(&s->batch[1], RTCP_BATCH_SIZE, h->max_packet_size) < 0)
+            goto fail;
+    }
+
     av_free(fec_protocol);
     av_dict_free(&fec_opts);
 
@@ -380,6 +391,8 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
 
  fail:
     ff_ip_reset_filters(&s->filters);
+    ff_ip_recv_batch_free(&s->batch[0], NULL);
+    ff_ip_recv_batch_free(&s->batch[1], NULL);
     ffurl_closep(&s->rtp_hd);
     ffurl_closep(&s->rtcp_hd);
     ffurl_closep(&s->fec_hd);
@@ -397,8 +410,22 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
     struct sockaddr_storage *addrs[2] = { &s->last_rtp_source, &s->last_rtcp_source };
     socklen_t *addr_lens[2] = { &s->last_rtp_source_len, &s->last_rtcp_source_len };
     int runs = h->rw_timeout / 1000 / POLLING_TIME;
+    struct sockaddr_storage *addr;
+    uint8_t *data;
 
     for(;;) {
+        /* first return the datagrams already received, RTCP first */
+        for (i = 1; i >= 0; i--) {
+            while ((len = ff_ip_recv_batch_next(s->batch[i], &data, &addr,
+                                                addr_lens[i])) >= 0) {
+                *addrs[i] = *addr;
+                if (ff_ip_check_source_lists(addrs[i], &s->filters))
+                    continue;
+                len = FFMIN(len, size);
+                memcpy(buf, data, len);
+                return len;
+            }
+        }
         if (ff_check_interrupt(&h->interrupt_callback))
             return AVERROR_EXIT;
         n = poll(p, 2, poll_delay);
@@ -407,19 +434,16 @@ static int rtp_read(URLContext *h, uint8_t *buf, int size)
             for (i = 1; i >= 0; i--) {
                 if (!(p[i].revents & POLLIN))
                     continue;
-                *addr_lens[i] = sizeof(*addrs[i]);
-                len = recvfrom(p[i].fd, buf, size, 0,
-                                (struct sockaddr *)addrs[i], addr_lens[i]);
+                len = ff_ip_recv_batch_fill(s->batch[i], p[i].fd);
                 if (len < 0) {
-                    if (ff_neterrno() == AVERROR(EAGAIN) ||
-                        ff_neterrno() == AVERROR(EINTR))
+                    if (len == AVERROR(EAGAIN) || len == AVERROR(EINTR))
                         continue;
                     return AVERROR(EIO);
                 }
-                if (ff_ip_check_source_lists(addrs[i], &s->filters))
-                    continue;
-                return len;
+                break;
             }
+            if (i >= 0)
+                continue;
         } else if (n == 0 && h->rw_timeout > 0 && --runs <= 0) {
             return AVERROR(ETIMEDOUT);
         } else if (n < 0) {
@@ -523,6 +547,8 @@ static int rtp_close(URLContext *h)
     RTPContext *s = h->priv_data;
 
     ff_ip_reset_filters(&s->filters);
+    ff_ip_recv_batch_free(&s->batch[0], h);
+    ff_ip_recv_batch_free(&s->batch[1], h);
 
     ffurl_closep(&s->rtp_hd);
     ffurl_closep(&s->rtcp_hd);
@@ -530,6 +556,14 @@ static int rtp_close(URLContext *h)
     return 0;
 }
 
+int ff_rtp_has_pending_data(URLContext *h)
+{
+    RTPContext *s = h->priv_data;
+
+    return s->batch[0] && (ff_ip_recv_batch_pending(s->batch[0]) ||
+                           ff_ip_recv_batch_pending(s->batch[1]));
+}
+
 /**
  * Return the local rtp port used by the RTP connection
  * @param h media file context
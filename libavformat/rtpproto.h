@@ -27,4 +27,11 @@ int ff_rtp_set_remote_url(URLContext *h, const char *uri);
 
 int ff_rtp_get_local_rtp_port(URLContext *h);
 
+/**
+ * Return whether datagrams were received along the previous ones and can be
+ * read without waiting, which poll() on the RTP and RTCP sockets does not
+ * tell.
+ */
+int ff_rtp_has_pending_data(URLContext *h);
+
 #endif /* AVFORMAT_RTPPROTO_H */
@@ -2094,6 +2094,17 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
             return AVERROR_EXIT;
         if (wait_end && wait_end - av_gettime_relative() < 0)
             return AVERROR(EAGAIN);
+        for (i = 0; i < rt->nb_rtsp_streams; i++) {
+            rtsp_st = rt->rtsp_streams[i];
+            if (rtsp_st->rtp_handle &&
+                ff_rtp_has_pending_data(rtsp_st->rtp_handle)) {
+                ret = ffurl_read(rtsp_st->rtp_handle, buf, buf_size);
+                if (ret > 0) {
+                    *prtsp_st = rtsp_st;
+                    return ret;
+                }
+            }
+        }
         n = poll(p, rt->max_p, POLLING_TIME);
         if (n > 0) {
             int j = rt->rtsp_hd ? 1 : 0;
@@ -33,6 +33,7 @@
 #include "avio_internal.h"
 #include "demux.h"
 #include "internal.h"
+#include "packedindex.h"
 
 void avpriv_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timestamp)
 {
@@ -47,13 +48,35 @@ void avpriv_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timesta
     }
 }
 
+static const AVIndexEntry *index_entry(FFStream *sti, int idx)
+{
+    if (sti->packed_index)
+        return ff_packed_index_get(sti->packed_index, idx);
+    return &sti->index_entries[idx];
+}
+
+int ff_stream_pack_index(AVStream *st)
+{
+    FFStream *const sti = ffstream(st);
+
+    if (sti->packed_index || sti->nb_index_entries)
+        return 0;
+    sti->packed_index = ff_packed_index_alloc();
+    return sti->packed_index ? 0 : AVERROR(ENOMEM);
+}
+
 void ff_reduce_index(AVFormatContext *s, int stream_index)
 {
     AVStream *const st  = s->streams[stream_index];
     FFStream *const sti = ffstream(st);
     unsigned int max_entries = s->max_index_size / sizeof(AVIndexEntry);
 
-    if ((unsigned) sti->nb_index_entries >= max_entries) {
+    if (sti->packed_index) {
+        if (ff_packed_index_size(sti->packed_index) >= s->max_index_size) {
+            ff_packed_index_halve(sti->packed_index);
+            sti->nb_index_entries = ff_packed_index_count(sti->packed_index);
+        }
+    } else if ((unsigned) sti->nb_index_entries >= max_entries) {
         int i;
         for (i = 0; 2 * i < sti->nb_index_entries; i++)
             sti->index_entries[i] = sti->index_entries[2 * i];
@@ -124,6 +147,12 @@ int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
 {
     FFStream *const sti = ffstream(st);
     timestamp = ff_wrap_timestamp(st, timestamp);
+    if (sti->packed_index) {
+        int ret = ff_packed_index_add(sti->packed_index, pos, timestamp,
+                                      size, distance, flags);
+        sti->nb_index_entries = ff_packed_index_count(sti->packed_index);
+        return ret;
+    }
     return ff_add_index_entry(&sti->index_entries, &sti->nb_index_entries,
                               &sti->index_entries_allocated_size, pos,
                               timestamp, size, distance, flags);
@@ -203,14 +232,14 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
                 continue;
 
             for (int i1 = 0, i2 = 0; i1 < sti1->nb_index_entries; i1++) {
-                const AVIndexEntry *const e1 = &sti1->index_entries[i1];
+                const AVIndexEntry *const e1 = index_entry(sti1, i1);
                 int64_t e1_pts = av_rescale_q(e1->timestamp, st1->time_base, AV_TIME_BASE_Q);
 
                 if (e1->size < (1 << 23))
                     skip = FFMAX(skip, e1->size);
 
                 for (; i2 < sti2->nb_index_entries; i2++) {
-                    const AVIndexEntry *const e2 = &sti2->index_entries[i2];
+                    const AVIndexEntry *const e2 = index_entry(sti2, i2);
                     int64_t e2_pts = av_rescale_q(e2->timestamp, st2->time_base, AV_TIME_BASE_Q);
                     int64_t cur_delta;
                     if (e2_pts < e1_pts || e2_pts - (uint64_t)e1_pts < time_tolerance)
@@ -245,6 +274,8 @@ void ff_configure_buffers_for_index(AVFormatContext *s, int64_t time_tolerance)
 int av_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
 {
     const FFStream *const sti = ffstream(st);
+    if (sti->packed_index)
+        return ff_packed_index_search(sti->packed_index, wanted_timestamp, flags);
     return ff_index_search_timestamp(sti->index_entries, sti->nb_index_entries,
                                      wanted_timestamp, flags);
 }
@@ -256,26 +287,24 @@ int avformat_index_get_entries_count(const AVStream *st)
 
 const AVIndexEntry *avformat_index_get_entry(AVStream *st, int idx)
 {
-    const FFStream *const sti = ffstream(st);
+    FFStream *const sti = ffstream(st);
     if (idx < 0 || idx >= sti->nb_index_entries)
         return NULL;
 
-    return &sti->index_entries[idx];
+    return index_entry(sti, idx);
 }
 
 const AVIndexEntry *avformat_index_get_entry_from_timestamp(AVStream *st,
                                                             int64_t wanted_timestamp,
                                                             int flags)
 {
-    const FFStream *const sti = ffstream(st);
-    int idx = ff_index_search_timestamp(sti->index_entries,
-                                        sti->nb_index_entries,
-                                        wanted_timestamp, flags);
+    FFStream *const sti = ffstream(st);
+    int idx = av_index_search_timestamp(st, wanted_timestamp, flags);
 
     if (idx < 0)
         return NULL;
 
-    return &sti->index_entries[idx];
+    return index_entry(sti, idx);
 }
 
 static int64_t read_timestamp(AVFormatContext *s, int stream_index, int64_t *ppos, int64_t pos_limit,
@@ -309,7 +338,7 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
 
     st  = s->streams[stream_index];
     sti = ffstream(st);
-    if (sti->index_entries) {
+    if (sti->index_entries || (sti->packed_index && sti->nb_index_entries)) {
         const AVIndexEntry *e;
 
         /* FIXME: Whole function must be checked for non-keyframe entries in
@@ -317,7 +346,7 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
         index = av_index_search_timestamp(st, target_ts,
                                           flags | AVSEEK_FLAG_BACKWARD);
         index = FFMAX(index, 0);
-        e     = &sti->index_entries[index];
+        e     = index_entry(sti, index);
 
         if (e->timestamp <= target_ts || e->pos == e->min_distance) {
             pos_min = e->pos;
@@ -332,7 +361,7 @@ int ff_seek_frame_binary(AVFormatContext *s, int stream_index,
                                           flags & ~AVSEEK_FLAG_BACKWARD);
         av_assert0(index < sti->nb_index_entries);
         if (index >= 0) {
-            e = &sti->index_entries[index];
+            e = index_entry(sti, index);
             av_assert1(e->timestamp >= target_ts);
             pos_max   = e->pos;
             ts_max    = e->timestamp;
@@ -536,7 +565,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     index = av_index_search_timestamp(st, timestamp, flags);
 
     if (index < 0 && sti->nb_index_entries &&
-        timestamp < sti->index_entries[0].timestamp)
+        timestamp < index_entry(sti, 0)->timestamp)
         return -1;
 
     if (index < 0 || index == sti->nb_index_entries - 1) {
@@ -544,8 +573,8 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
         int nonkey = 0;
 
         if (sti->nb_index_entries) {
-            av_assert0(sti->index_entries);
-            ie = &sti->index_entries[sti->nb_index_entries - 1];
+            av_assert0(sti->index_entries || sti->packed_index);
+            ie = index_entry(sti, sti->nb_index_entries - 1);
             if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
                 return ret;
             s->io_repositioned = 1;
@@ -585,7 +614,7 @@ static int seek_frame_generic(AVFormatContext *s, int stream_index,
     if (ffifmt(s->iformat)->read_seek)
         if (ffifmt(s->iformat)->read_seek(s, stream_index, timestamp, flags) >= 0)
             return 0;
-    ie = &sti->index_entries[index];
+    ie = index_entry(sti, index);
     if ((ret = avio_seek(s->pb, ie->pos, SEEK_SET)) < 0)
         return ret;
     s->io_repositioned = 1;
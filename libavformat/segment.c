@@ -28,6 +28,7 @@
 
 #include <time.h>
 
+#include "asyncwriter.h"
 #include "avformat.h"
 #include "internal.h"
 #include "mux.h"
@@ -124,6 +125,9 @@ typedef struct SegmentContext {
     int use_rename;
     char temp_list_filename[1024];
 
+    int async_io;          ///< size of the queue of the background writer
+    FFAsyncWriter *writer;
+
     SegmentListEntry cur_entry;
     SegmentListEntry *segment_list_entries;
     SegmentListEntry *segment_list_entries_end;
@@ -145,6 +149,26 @@ static void print_csv_escaped_str(AVIOContext *ctx, const char *str)
         avio_w8(ctx, '"');
 }
 
+static int segment_io_open(AVFormatContext *s, AVFormatContext *ctx,
+                           AVIOContext **pb, const char *url)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (seg->writer)
+        return ff_async_writer_open(seg->writer, pb, url, NULL);
+    return ctx->io_open(ctx, pb, url, AVIO_FLAG_WRITE, NULL);
+}
+
+static int segment_io_close(AVFormatContext *s, AVFormatContext *ctx,
+                            AVIOContext **pb)
+{
+    SegmentContext *seg = s->priv_data;
+
+    if (seg->writer)
+        return ff_async_writer_close(seg->writer, pb);
+    return ff_format_io_close(ctx, pb);
+}
+
 static int segment_mux_init(AVFormatContext *s)
 {
     SegmentContext *seg = s->priv_data;
@@ -250,7 +274,7 @@ static int segment_start(AVFormatContext *s, int write_header)
     if ((err = set_segment_filename(s)) < 0)
         return err;
 
-    if ((err = s->io_open(s, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0) {
+    if ((err = segment_io_open(s, s, &oc->pb, oc->url)) < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
         return err;
     }
@@ -280,7 +304,11 @@ static int segment_list_open(AVFormatContext *s)
     int ret;
 
     snprintf(seg->temp_list_filename, sizeof(seg->temp_list_filename), seg->use_rename ? "%s.tmp" : "%s", seg->list);
-    ret = s->io_open(s, &seg->list_pb, seg->temp_list_filename, AVIO_FLAG_WRITE, NULL);
+    /* a list which is only appended to stays open on the writer thread */
+    if (seg->writer && !seg->list_size && seg->list_type != LIST_TYPE_M3U8)
+        ret = ff_async_writer_open_stream(seg->writer, &seg->list_pb, seg->temp_list_filename, NULL);
+    else
+        ret = segment_io_open(s, s, &seg->list_pb, seg->temp_list_filename);
     if (ret < 0) {
         av_log(s, AV_LOG_ERROR, "Failed to open segment list '%s'\n", seg->list);
         return ret;
@@ -367,6 +395,13 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
         av_log(s, AV_LOG_ERROR, "Failure occurred when ending segment '%s'\n",
                oc->url);
 
+    /* queue the segment before the list which references it */
+    if (seg->writer) {
+        err = ff_async_writer_close(seg->writer, &oc->pb);
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
+
     if (seg->list) {
         if (seg->list_size || seg->list_type == LIST_TYPE_M3U8) {
             SegmentListEntry *entry = av_mallocz(sizeof(*entry));
@@ -392,18 +427,35 @@ static int segment_end(AVFormatContext *s, int write_trailer, int is_last)
                 av_freep(&entry);
             }
 
-            if ((ret = segment_list_open(s)) < 0)
+            if ((err = segment_list_open(s)) < 0) {
+                ret = err;
                 goto end;
+            }
             for (entry = seg->segment_list_entries; entry; entry = entry->next)
                 segment_list_print_entry(seg->list_pb, seg->list_type, entry, s);
             if (seg->list_type == LIST_TYPE_M3U8 && is_last)
                 avio_printf(seg->list_pb, "#EXT-X-ENDLIST\n");
-            ff_format_io_close(s, &seg->list_pb);
-            if (seg->use_rename)
-                ff_rename(seg->temp_list_filename, seg->list, s);
+            if (seg->writer) {
+                err = ff_async_writer_close(seg->writer, &seg->list_pb);
+                if (err >= 0 && seg->use_rename)
+                    err = ff_async_writer_rename(seg->writer, seg->temp_list_filename, seg->list);
+                if (err < 0 && ret >= 0)
+                    ret = err;
+            } else {
+                ff_format_io_close(s, &seg->list_pb);
+                if (seg->use_rename)
+                    ff_rename(seg->temp_list_filename, seg->list, s);
+            }
         } else {
             segment_list_print_entry(seg->list_pb, seg->list_type, &seg->cur_entry, s);
-            avio_flush(seg->list_pb);
+            if (seg->writer) {
+                /* appended once the segment is written */
+                err = ff_async_writer_sync(seg->writer, seg->list_pb);
+                if (err < 0 && ret >= 0)
+                    ret = err;
+            } else {
+                avio_flush(seg->list_pb);
+            }
         }
     }
 
@@ -647,6 +699,7 @@ static void seg_free(AVFormatContext *s)
     SegmentContext *seg = s->priv_data;
     SegmentListEntry *cur;
 
+    ff_async_writer_free(&seg->writer);
     ff_format_io_close(s, &seg->list_pb);
     if (seg->avf) {
         if (seg->is_nullctx)
@@ -721,6 +774,16 @@ static int seg_init(AVFormatContext *s)
         }
     }
 
+    if (seg->async_io) {
+        ret = ff_async_writer_alloc(&seg->writer, s, seg->async_io, NULL, NULL);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(s, AV_LOG_WARNING, "async_io requires threads, "
+                   "writing the segments synchronously\n");
+        } else if (ret < 0) {
+            return ret;
+        }
+    }
+
     if (seg->list) {
         if (seg->list_type == LIST_TYPE_UNDEFINED) {
             if      (av_match_ext(seg->list, "csv" )) seg->list_type = LIST_TYPE_CSV;
@@ -767,9 +830,8 @@ static int seg_init(AVFormatContext *s)
     oc = seg->avf;
 
     if (seg->write_header_trailer) {
-        if ((ret = s->io_open(s, &oc->pb,
-                              seg->header_filename ? seg->header_filename : oc->url,
-                              AVIO_FLAG_WRITE, NULL)) < 0) {
+        if ((ret = segment_io_open(s, s, &oc->pb,
+                                   seg->header_filename ? seg->header_filename : oc->url)) < 0) {
             av_log(s, AV_LOG_ERROR, "Failed to open segment '%s'\n", oc->url);
             return ret;
         }
@@ -832,12 +894,12 @@ static int seg_write_header(AVFormatContext *s)
     if (!seg->write_header_trailer || seg->header_filename) {
         if (seg->header_filename) {
             av_write_frame(oc, NULL);
-            ff_format_io_close(oc, &oc->pb);
+            segment_io_close(s, oc, &oc->pb);
         } else {
             close_null_ctxp(&oc->pb);
             seg->is_nullctx = 0;
         }
-        if ((ret = oc->io_open(oc, &oc->pb, oc->url, AVIO_FLAG_WRITE, NULL)) < 0)
+        if ((ret = segment_io_open(s, oc, &oc->pb, oc->url)) < 0)
             return ret;
         if (!seg->individual_header_trailer)
             oc->pb->seekable = 0;
@@ -1009,6 +1071,14 @@ static int seg_write_trailer(struct AVFormatContext *s)
     } else {
         ret = segment_end(s, 1, 1);
     }
+    if (seg->writer) {
+        int err = ff_async_writer_close(seg->writer, &seg->list_pb);
+        if (err < 0 && ret >= 0)
+            ret = err;
+        err = ff_async_writer_flush(seg->writer);
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
     return ret;
 }
 
@@ -1075,6 +1145,7 @@ static const AVOption options[] = {
     { "reset_timestamps", "reset timestamps at the beginning of each segment", OFFSET(reset_timestamps), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
     { "initial_offset", "set initial timestamp offset", OFFSET(initial_offset), AV_OPT_TYPE_DURATION, {.i64 = 0}, -INT64_MAX, INT64_MAX, E },
     { "write_empty_segments", "allow writing empty 'filler' segments", OFFSET(write_empty), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, E },
+    { "async_io", "write the segments on a background thread, with a queue of this size", OFFSET(async_io), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, E },
     { NULL },
 };
 
@@ -0,0 +1,247 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Read a file through the persistent store of the cache protocol: blocks
+ * are only fetched when read, the blocks of a modified file are not used,
+ * non-seekable inputs are skipped forward, the least recently used blocks
+ * are evicted first and blocks larger than the store are not stored.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/murmur3.h"
+
+#include "libavformat/avio.h"
+#include "libavformat/url.h"
+
+/* the conditions of the persistent store in cache.c */
+#if HAVE_MMAP && HAVE_FCNTL && HAVE_UNISTD_H
+#include <unistd.h>
+
+#define BLOCK_SIZE 4096
+#define MAX_BLOCKS 8
+
+static char dir[1024], url[1024];
+
+static uint8_t byte_at(int64_t pos, int seed)
+{
+    return pos * 13 + (pos >> 11) + seed;
+}
+
+static int write_file(const char *name, int64_t size, int seed)
+{
+    AVIOContext *pb;
+    int ret = avio_open(&pb, name, AVIO_FLAG_WRITE);
+    if (ret < 0)
+        return ret;
+    for (int64_t pos = 0; pos < size; pos++)
+        avio_w8(pb, byte_at(pos, seed));
+    return avio_closep(&pb);
+}
+
+/* the name of the file of a block in the store, as cache.c builds it */
+static void block_path(int64_t block_no, char *path, size_t size)
+{
+    struct AVMurMur3 *ctx = av_murmur3_alloc();
+    uint8_t hash[16], buf[8];
+    uint64_t key = 0;
+
+    if (ctx) {
+        AV_WL64(buf, block_no);
+        av_murmur3_init(ctx);
+        av_murmur3_update(ctx, url, strlen(url) + 1);
+        av_murmur3_update(ctx, buf, sizeof(buf));
+        av_murmur3_final(ctx, hash);
+        av_free(ctx);
+        key = AV_RL64(hash);
+    }
+    snprintf(path, size, "%s/%016"PRIx64, dir, key ? key : 1);
+}
+
+static int block_stored(int64_t block_no)
+{
+    char path[1100];
+
+    block_path(block_no, path, sizeof(path));
+    return !access(path, F_OK);
+}
+
+static void remove_store(void)
+{
+    char path[1100];
+
+    for (int i = 0; i < MAX_BLOCKS; i++) {
+        block_path(i, path, sizeof(path));
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s/index", dir);
+    remove(path);
+    rmdir(dir);
+}
+
+static int open_cache(URLContext **h, int64_t max_size, int seekable)
+{
+    AVDictionary *opts = NULL;
+    char name[1100];
+    int ret;
+
+    snprintf(name, sizeof(name), "cache:%s", url);
+    av_dict_set(&opts, "cache_dir", dir, 0);
+    av_dict_set_int(&opts, "cache_block_size", BLOCK_SIZE, 0);
+    av_dict_set_int(&opts, "cache_max_size", max_size, 0);
+    if (!seekable)
+        av_dict_set(&opts, "seekable", "0", 0);
+    ret = ffurl_open_whitelist(h, name, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "cannot open %s: %s\n", name, av_err2str(ret));
+    return ret < 0;
+}
+
+static int check_read(URLContext *h, int64_t pos, int size, int seed)
+{
+    uint8_t buf[2 * BLOCK_SIZE];
+    int ret;
+
+    if (pos >= 0 && ffurl_seek(h, pos, SEEK_SET) != pos) {
+        fprintf(stderr, "seek to %"PRId64" failed\n", pos);
+        return 1;
+    }
+    if (pos < 0)
+        pos = ffurl_seek(h, 0, SEEK_CUR);
+    ret = ffurl_read_complete(h, buf, size);
+    if (ret != size) {
+        fprintf(stderr, "read of %d bytes at %"PRId64" returned %d\n", size, pos, ret);
+        return 1;
+    }
+    for (int i = 0; i < size; i++) {
+        if (buf[i] != byte_at(pos + i, seed)) {
+            fprintf(stderr, "wrong byte at %"PRId64"\n", pos + i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* read the whole file sequentially, without seeking */
+static int check_file(URLContext *h, int64_t size, int seed)
+{
+    uint8_t buf[1];
+    int ret = 0;
+
+    for (int64_t pos = 0; !ret && pos < size; pos += 3000)
+        ret = check_read(h, -1, FFMIN(3000, size - pos), seed);
+    if (!ret && ffurl_read(h, buf, 1) != AVERROR_EOF) {
+        fprintf(stderr, "no end of file after %"PRId64" bytes\n", size);
+        ret = 1;
+    }
+    return ret;
+}
+
+static int check_stored(const char *test, const int *expected)
+{
+    for (int i = 0; i < MAX_BLOCKS; i++) {
+        if (block_stored(i) != expected[i]) {
+            fprintf(stderr, "%s: block %d is%s stored\n", test, i,
+                    expected[i] ? " not" : "");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : "cache.tmp";
+    static const int stored_a[MAX_BLOCKS] = { 1, 0, 1 };
+    /* the empty block past the end tells later readers where the file ends */
+    static const int stored_d[MAX_BLOCKS] = { 1, 0, 0, 1, 0, 1, 1 };
+    URLContext *h = NULL;
+    int ret;
+
+    snprintf(dir, sizeof(dir), "%s.d", name);
+    snprintf(url, sizeof(url), "file:%s", name);
+    remove_store();
+
+    /* only the blocks which are read are fetched */
+    ret = write_file(name, 5 * BLOCK_SIZE + 1000, 0) < 0 ||
+          open_cache(&h, 1 << 20, 1);
+    if (!ret) {
+        ret = check_read(h, 2 * BLOCK_SIZE + 100, BLOCK_SIZE / 2, 0) ||
+              check_read(h, 10, 2000, 0);
+        ffurl_closep(&h);
+    }
+    ret = ret || check_stored("partial read", stored_a);
+
+    /* the missing blocks of a non-seekable input are reached by skipping
+     * the data in between */
+    ret = ret || open_cache(&h, 1 << 20, 0);
+    if (!ret) {
+        ret = check_file(h, 5 * BLOCK_SIZE + 1000, 0);
+        ffurl_closep(&h);
+    }
+
+    /* the blocks of the previous version of the file are not used */
+    ret = ret || write_file(name, 4 * BLOCK_SIZE + 500, 1) < 0 ||
+          open_cache(&h, 1 << 20, 1);
+    if (!ret) {
+        ret = check_file(h, 4 * BLOCK_SIZE + 500, 1);
+        ffurl_closep(&h);
+    }
+
+    /* the least recently used blocks are evicted */
+    ret = ret || write_file(name, 6 * BLOCK_SIZE, 2) < 0 ||
+          open_cache(&h, 3 * BLOCK_SIZE, 1);
+    if (!ret) {
+        ret = check_file(h, 6 * BLOCK_SIZE, 2)             ||
+              check_read(h, 3 * BLOCK_SIZE, BLOCK_SIZE, 2) ||
+              check_read(h, 0, 100, 2);
+        ffurl_closep(&h);
+    }
+    ret = ret || check_stored("eviction", stored_d);
+
+    /* a block larger than the store evicts nothing */
+    ret = ret || open_cache(&h, BLOCK_SIZE / 2, 1);
+    if (!ret) {
+        ret = check_read(h, BLOCK_SIZE, 100, 2);
+        ffurl_closep(&h);
+    }
+    ret = ret || check_stored("oversized block", stored_d);
+
+    remove_store();
+    remove(name);
+
+    return ret;
+}
+#else
+int main(void)
+{
+    return 0;
+}
+#endif
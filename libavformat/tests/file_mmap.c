@@ -0,0 +1,211 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "config.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+
+#include "libavcodec/defs.h"
+
+#include "libavformat/avio_internal.h"
+#include "libavformat/url.h"
+
+/* not a multiple of the page size, so the last page ends with zeros */
+#define FILE_SIZE ((3 << 19) - 1000)
+
+static int64_t file_size;
+
+static uint8_t byte_at(int64_t pos)
+{
+    return pos * 13 + (pos >> 11);
+}
+
+static int check_data(const uint8_t *data, int64_t pos, int size)
+{
+    for (int i = 0; i < size; i++) {
+        if (data[i] != byte_at(pos + i)) {
+            fprintf(stderr, "wrong byte at %"PRId64"\n", pos + i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_read(AVIOContext *pb, int size)
+{
+    int64_t pos = avio_tell(pb);
+    uint8_t *buf = av_malloc(size);
+    int ret;
+
+    if (!buf)
+        return 1;
+
+    ret = avio_read(pb, buf, size);
+    if (ret != size) {
+        fprintf(stderr, "avio_read(%d) at %"PRId64" returned %d\n", size, pos, ret);
+        ret = 1;
+    } else {
+        ret = check_data(buf, pos, size);
+    }
+
+    av_free(buf);
+    return ret;
+}
+
+/* read like the demuxers do, falling back to copying if the data cannot be
+ * referenced */
+static int check_read_buffer(AVIOContext *pb, int size, int *referenced)
+{
+    int64_t pos = avio_tell(pb);
+    AVBufferRef *buf;
+    int ret;
+
+    ret = ffio_read_buffer(pb, &buf, size);
+    if (ret == AVERROR(ENOSYS))
+        return check_read(pb, size);
+    if (ret != size) {
+        fprintf(stderr, "ffio_read_buffer(%d) at %"PRId64" returned %d\n",
+                size, pos, ret);
+        return 1;
+    }
+    (*referenced)++;
+
+    /* the padding is the following data of the file, or zeros past its end */
+    ret = check_data(buf->data, pos, size);
+    for (int i = 0; !ret && i < AV_INPUT_BUFFER_PADDING_SIZE; i++) {
+        if (buf->data[size + i] != (pos + size + i < file_size ? byte_at(pos + size + i) : 0)) {
+            fprintf(stderr, "wrong padding of the data at %"PRId64"\n", pos);
+            ret = 1;
+        }
+    }
+    if (!ret && avio_tell(pb) != pos + size) {
+        fprintf(stderr, "position %"PRId64" after reading %d bytes at %"PRId64"\n",
+                avio_tell(pb), size, pos);
+        ret = 1;
+    }
+
+    av_buffer_unref(&buf);
+    return ret;
+}
+
+static int write_file(const char *name, int64_t start, int64_t end)
+{
+    FILE *f = fopen(name, start ? "ab" : "wb");
+    int ret = 0;
+
+    if (!f)
+        return AVERROR(errno);
+    for (int64_t pos = start; pos < end; pos++)
+        fputc(byte_at(pos), f);
+    if (ferror(f))
+        ret = AVERROR(EIO);
+    if (fclose(f) && !ret)
+        ret = AVERROR(errno);
+    if (!ret)
+        file_size = end;
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : "file_mmap.tmp";
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    URLContext *h;
+    int referenced = 0, ret;
+
+    ret = write_file(name, 0, FILE_SIZE);
+    if (ret < 0) {
+        fprintf(stderr, "cannot write %s\n", name);
+        return 1;
+    }
+
+    av_dict_set(&opts, "mmap",      "1", 0);
+    av_dict_set(&opts, "zero_copy", "1", 0);
+    ret = ffurl_open_whitelist(&h, name, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret >= 0) {
+        /* make the buffer large enough to contain some referenced reads */
+        h->max_packet_size = 1 << 18;
+        ret = ffio_fdopen(&pb, h);
+        if (ret < 0)
+            ffurl_closep(&h);
+    }
+    if (ret < 0) {
+        fprintf(stderr, "cannot open %s\n", name);
+        remove(name);
+        return 1;
+    }
+
+    /* referenced reads both within and past the buffered data must be
+     * followed by copied reads of the following bytes */
+    ret = check_read       (pb,   1000)                      ||
+          check_read_buffer(pb, 100000, &referenced)         ||
+          check_read       (pb,  50000)                      ||
+          check_read_buffer(pb, 400000, &referenced)         ||
+          check_read       (pb,   4097)                      ||
+          check_read_buffer(pb,  65536, &referenced)         ||
+          avio_seek(pb, FILE_SIZE - 70000, SEEK_SET) < 0     ||
+          check_read_buffer(pb,  70000, &referenced)         ||
+          avio_r8(pb) || !avio_feof(pb);
+
+    /* data appended to the file can be referenced too */
+    ret = ret || write_file(name, FILE_SIZE, 2 * FILE_SIZE) < 0 ||
+          avio_seek(pb, FILE_SIZE - 1000, SEEK_SET) < 0      ||
+          check_read_buffer(pb, 100000, &referenced);
+
+#if HAVE_UNISTD_H
+    /* data removed from the file is not referenced, and is not returned */
+    if (!ret) {
+        AVBufferRef *buf = NULL;
+        int64_t pos = FILE_SIZE - 70000;
+
+        ret = truncate(name, FILE_SIZE) < 0 ||
+              avio_seek(pb, pos, SEEK_SET) != pos;
+        if (!ret && ffio_read_buffer(pb, &buf, 100000) != AVERROR(ENOSYS)) {
+            fprintf(stderr, "data past the end of the truncated file was referenced\n");
+            av_buffer_unref(&buf);
+            ret = 1;
+        }
+        file_size = FILE_SIZE;
+        ret = ret || check_read(pb, 70000) || avio_r8(pb) || !avio_feof(pb);
+    }
+#endif
+
+#if HAVE_MMAP
+    if (!ret && referenced != 5) {
+        fprintf(stderr, "only %d reads were referenced\n", referenced);
+        ret = 1;
+    }
+#endif
+
+    avio_closep(&pb);
+    remove(name);
+
+    return ret;
+}
@@ -0,0 +1,159 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+
+#include "libavformat/demux.h"
+#include "libavformat/packedindex.h"
+
+typedef struct Index {
+    AVIndexEntry *entries;
+    int nb_entries;
+    unsigned allocated;
+    FFPackedIndex *packed;
+} Index;
+
+static int compare(Index *idx, AVLFG *lfg)
+{
+    static const int search_flags[] = {
+        0, AVSEEK_FLAG_BACKWARD, AVSEEK_FLAG_ANY,
+        AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD,
+    };
+
+    if (ff_packed_index_count(idx->packed) != idx->nb_entries) {
+        fprintf(stderr, "count mismatch: %d != %d\n",
+                ff_packed_index_count(idx->packed), idx->nb_entries);
+        return 1;
+    }
+
+    for (int i = 0; i < idx->nb_entries; i++) {
+        const AVIndexEntry *a = &idx->entries[i];
+        const AVIndexEntry *b = ff_packed_index_get(idx->packed, i);
+
+        if (!b || a->pos != b->pos || a->timestamp != b->timestamp ||
+            a->size != b->size || a->flags != b->flags ||
+            a->min_distance != b->min_distance) {
+            fprintf(stderr, "entry %d mismatch\n", i);
+            return 1;
+        }
+    }
+    if (ff_packed_index_get(idx->packed, idx->nb_entries))
+        return 1;
+
+    for (int i = 0; i < 1000; i++) {
+        int64_t ts = (int64_t)(av_lfg_get(lfg) % 200000) - 1000;
+        int flags = search_flags[i & 3];
+        int a = ff_index_search_timestamp(idx->entries, idx->nb_entries, ts, flags);
+        int b = ff_packed_index_search(idx->packed, ts, flags);
+
+        if (a != b) {
+            fprintf(stderr, "search for %"PRId64" with flags %d: %d != %d\n",
+                    ts, flags, a, b);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int add(Index *idx, int64_t pos, int64_t ts, int size, int distance, int flags)
+{
+    int a = ff_add_index_entry(&idx->entries, &idx->nb_entries, &idx->allocated,
+                               pos, ts, size, distance, flags);
+    int b = ff_packed_index_add(idx->packed, pos, ts, size, distance, flags);
+
+    if (a != b) {
+        fprintf(stderr, "add of %"PRId64": %d != %d\n", ts, a, b);
+        return 1;
+    }
+    return 0;
+}
+
+static void halve(Index *idx)
+{
+    idx->nb_entries = (idx->nb_entries + 1) >> 1;
+    for (int i = 0; i < idx->nb_entries; i++)
+        idx->entries[i] = idx->entries[2 * i];
+}
+
+int main(void)
+{
+    Index idx = { 0 };
+    AVLFG lfg;
+    int64_t ts = 0, pos = 0;
+    size_t packed_size, array_size;
+    int ret = 1;
+
+    av_lfg_init(&lfg, 0xff);
+    idx.packed = ff_packed_index_alloc();
+    if (!idx.packed)
+        return 1;
+
+    /* appending, as when demuxing sequentially */
+    for (int i = 0; i < 5000; i++) {
+        int size = av_lfg_get(&lfg) % 100000;
+        ts  += 1 + av_lfg_get(&lfg) % 40;
+        if (add(&idx, pos, ts, size, av_lfg_get(&lfg) % 5,
+                av_lfg_get(&lfg) % 4 ? AVINDEX_KEYFRAME : 0))
+            goto end;
+        pos += size;
+    }
+    if (compare(&idx, &lfg))
+        goto end;
+
+    packed_size = ff_packed_index_size(idx.packed);
+    array_size  = idx.nb_entries * sizeof(*idx.entries);
+    if (packed_size * 2 > array_size) {
+        fprintf(stderr, "packed index too large: %zu for %zu\n",
+                packed_size, array_size);
+        goto end;
+    }
+
+    /* out of order insertions, replacements and discarded entries */
+    for (int i = 0; i < 3000; i++) {
+        int64_t t = av_lfg_get(&lfg) % (ts + 1000);
+        int flags = av_lfg_get(&lfg) % 4;
+        if (add(&idx, av_lfg_get(&lfg) % pos, t, av_lfg_get(&lfg) % 1000,
+                av_lfg_get(&lfg) % 5, flags))
+            goto end;
+        if (!(i % 500) && compare(&idx, &lfg))
+            goto end;
+    }
+    if (compare(&idx, &lfg))
+        goto end;
+
+    if (ff_packed_index_add(idx.packed, 0, AV_NOPTS_VALUE, 0, 0, 0) >= 0 ||
+        ff_packed_index_add(idx.packed, 0, 0, -1, 0, 0) >= 0)
+        goto end;
+
+    while (idx.nb_entries > 1) {
+        if (ff_packed_index_halve(idx.packed) < 0)
+            goto end;
+        halve(&idx);
+        if (compare(&idx, &lfg))
+            goto end;
+    }
+    ret = 0;
+
+end:
+    av_free(idx.entries);
+    ff_packed_index_free(&idx.packed);
+    return ret;
+}
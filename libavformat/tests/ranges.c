@@ -0,0 +1,323 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Read a file through the ranges protocol from a minimal HTTP/1.1 server
+ * running on the loopback interface, with and without range support.
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/thread.h"
+
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavformat/network.h"
+
+/* not a multiple of the range size, so the last range is short */
+#define RANGE_SIZE  16384
+#define FILE_SIZE   (10 * RANGE_SIZE + 1234)
+#define MAX_CLIENTS 64
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct Server Server;
+
+typedef struct Client {
+    Server   *server;
+    int       fd;
+    pthread_t thread;
+} Client;
+
+struct Server {
+    int        fd;
+    int        port;
+    int        ranges;      ///< whether Range headers are honoured
+    atomic_int stop;
+    atomic_int nb_partial;  ///< number of 206 replies
+    pthread_t  thread;
+    Client     clients[MAX_CLIENTS];
+    int        nb_clients;
+};
+
+static uint8_t file_data[FILE_SIZE];
+
+static int send_all(int fd, const void *buf, int64_t size)
+{
+    const uint8_t *p = buf;
+
+    while (size > 0) {
+        int ret = send(fd, p, FFMIN(size, 65536), MSG_NOSIGNAL);
+        if (ret <= 0)
+            return -1;
+        p    += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int reply(Client *cl, const char *request)
+{
+    Server *s = cl->server;
+    const char *range = av_stristr(request, "\r\nRange: bytes=");
+    int64_t start = 0, end = FILE_SIZE - 1;
+    char header[256];
+
+    if (s->ranges && range) {
+        char *p;
+        start = strtoll(range + 15, &p, 10);
+        if (*p == '-' && p[1] >= '0' && p[1] <= '9')
+            end = FFMIN(strtoll(p + 1, NULL, 10), FILE_SIZE - 1);
+        if (start > end) {
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                     "Content-Range: bytes */%d\r\n"
+                     "Content-Length: 0\r\n\r\n", FILE_SIZE);
+            return send_all(cl->fd, header, strlen(header));
+        }
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 206 Partial Content\r\n"
+                 "Accept-Ranges: bytes\r\n"
+                 "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n"
+                 "Content-Length: %"PRId64"\r\n\r\n",
+                 start, end, FILE_SIZE, end - start + 1);
+        atomic_fetch_add(&s->nb_partial, 1);
+    } else {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Length: %d\r\n\r\n", FILE_SIZE);
+    }
+
+    if (send_all(cl->fd, header, strlen(header)) < 0)
+        return -1;
+    return send_all(cl->fd, file_data + start, end - start + 1);
+}
+
+/* serve the requests of a keep-alive connection until it is closed */
+static void *client_thread(void *arg)
+{
+    Client *cl = arg;
+    char request[4096];
+    int len = 0;
+
+    for (;;) {
+        char *end;
+        int ret = recv(cl->fd, request + len, sizeof(request) - 1 - len, 0);
+        if (ret <= 0)
+            break;
+        len += ret;
+        request[len] = 0;
+
+        while ((end = strstr(request, "\r\n\r\n"))) {
+            int consumed = end + 4 - request;
+            end[2] = 0;
+            if (reply(cl, request) < 0)
+                goto end;
+            memmove(request, request + consumed, len - consumed + 1);
+            len -= consumed;
+        }
+        if (len == sizeof(request) - 1)
+            break;
+    }
+end:
+    closesocket(cl->fd);
+    return NULL;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *s = arg;
+
+    while (s->nb_clients < MAX_CLIENTS) {
+        Client *cl = &s->clients[s->nb_clients];
+        int fd = accept(s->fd, NULL, NULL);
+
+        if (fd < 0)
+            break;
+        if (atomic_load(&s->stop)) {
+            closesocket(fd);
+            break;
+        }
+        cl->server = s;
+        cl->fd     = fd;
+        if (pthread_create(&cl->thread, NULL, client_thread, cl)) {
+            closesocket(fd);
+            break;
+        }
+        s->nb_clients++;
+    }
+    return NULL;
+}
+
+static int server_start(Server *s, int ranges)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    memset(s, 0, sizeof(*s));
+    s->ranges = ranges;
+    atomic_init(&s->stop,       0);
+    atomic_init(&s->nb_partial, 0);
+
+    s->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(s->fd, MAX_CLIENTS) < 0 ||
+        getsockname(s->fd, (struct sockaddr *)&addr, &addr_len) < 0 ||
+        pthread_create(&s->thread, NULL, server_thread, s)) {
+        closesocket(s->fd);
+        return -1;
+    }
+    s->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static void server_stop(Server *s)
+{
+    struct sockaddr_in addr = { 0 };
+    int fd;
+
+    /* wake up accept() with a last connection */
+    atomic_store(&s->stop, 1);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(s->port);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+        closesocket(fd);
+    }
+    pthread_join(s->thread, NULL);
+    closesocket(s->fd);
+
+    for (int i = 0; i < s->nb_clients; i++)
+        pthread_join(s->clients[i].thread, NULL);
+}
+
+static int check_read(AVIOContext *pb, int64_t pos, int size)
+{
+    uint8_t buf[3 * RANGE_SIZE];
+    int ret;
+
+    size = FFMIN(size, FILE_SIZE - pos);
+    if (avio_seek(pb, pos, SEEK_SET) != pos) {
+        fprintf(stderr, "seek to %"PRId64" failed\n", pos);
+        return 1;
+    }
+    ret = avio_read(pb, buf, size);
+    if (ret != size) {
+        fprintf(stderr, "read of %d bytes at %"PRId64" returned %d\n", size, pos, ret);
+        return 1;
+    }
+    if (memcmp(buf, file_data + pos, size)) {
+        fprintf(stderr, "wrong data read at %"PRId64"\n", pos);
+        return 1;
+    }
+    return 0;
+}
+
+static int test(int ranges, int connections)
+{
+    static const int64_t seeks[] = {
+        5 * RANGE_SIZE + 17, 100, FILE_SIZE - 3000, 2 * RANGE_SIZE - 1, 9 * RANGE_SIZE,
+    };
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    Server s;
+    char url[64];
+    int ret;
+
+    if (server_start(&s, ranges) < 0) {
+        fprintf(stderr, "cannot start the server\n");
+        return 1;
+    }
+
+    snprintf(url, sizeof(url), "ranges:http://127.0.0.1:%d/file", s.port);
+    av_dict_set_int(&opts, "connections", connections, 0);
+    av_dict_set_int(&opts, "range_size",  RANGE_SIZE,  0);
+    ret = avio_open2(&pb, url, AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", url, av_err2str(ret));
+        server_stop(&s);
+        return 1;
+    }
+
+    /* read the whole file with reads straddling the ranges */
+    ret = 0;
+    for (int64_t pos = 0; !ret && pos < FILE_SIZE; pos += 7000)
+        ret = check_read(pb, pos, 7000);
+    if (!ret && (avio_r8(pb) || !avio_feof(pb))) {
+        fprintf(stderr, "no end of file after %d bytes\n", FILE_SIZE);
+        ret = 1;
+    }
+
+    /* without range support, the file can only be read sequentially */
+    if (ranges) {
+        if (!ret && avio_size(pb) != FILE_SIZE) {
+            fprintf(stderr, "size %"PRId64", expected %d\n", avio_size(pb), FILE_SIZE);
+            ret = 1;
+        }
+        for (int i = 0; !ret && i < FF_ARRAY_ELEMS(seeks); i++)
+            ret = check_read(pb, seeks[i], 2 * RANGE_SIZE + 99);
+    }
+
+    avio_closep(&pb);
+    server_stop(&s);
+
+    if (!ret && ranges && atomic_load(&s.nb_partial) < FILE_SIZE / RANGE_SIZE) {
+        fprintf(stderr, "only %d range requests\n", atomic_load(&s.nb_partial));
+        ret = 1;
+    }
+    if (ret)
+        fprintf(stderr, "test with%s ranges and %d connections failed\n",
+                ranges ? "" : "out", connections);
+    return ret;
+}
+
+int main(void)
+{
+    int ret;
+
+    for (int i = 0; i < FILE_SIZE; i++)
+        file_data[i] = i * 13 + (i >> 11);
+
+    avformat_network_init();
+
+    ret = test(1, 1) ||
+          test(1, 3) ||
+          test(1, 8) ||
+          test(0, 4);
+
+    avformat_network_deinit();
+
+    return ret;
+}
@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -41,6 +42,10 @@
 #include "url.h"
 #include "ip.h"
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #ifdef __APPLE__
 #include "TargetConditionals.h"
 #endif
@@ -77,6 +82,9 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_BATCH_SIZE 32
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_SIZE 65507
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -90,6 +98,8 @@ typedef struct UDPContext {
     int local_port;
     int reuse_socket;
     int overrun_nonfatal;
+    int batch_size;
+    int gro, gso;
     struct sockaddr_storage dest_addr;
     int dest_addr_len;
     int is_connected;
@@ -108,6 +118,8 @@ typedef struct UDPContext {
     int thread_started;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    IPRecvBatch *rx_batch;
+    uint64_t nb_sent, nb_send_calls;
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -137,6 +149,9 @@ static const AVOption options[] = {
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
+    { "batch_size",     "maximum number of datagrams received or sent per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = UDP_BATCH_SIZE }, 1, 1024, D|E },
+    { "gro",            "let the kernel coalesce the received datagrams (UDP GRO)", OFFSET(gro),  AV_OPT_TYPE_BOOL, { .i64 = 0 },      0, 1,       D },
+    { "gso",            "let the kernel segment the sent datagrams (UDP GSO)",      OFFSET(gso),  AV_OPT_TYPE_BOOL, { .i64 = 0 },      0, 1,       E },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { NULL }
@@ -495,44 +510,47 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        int len, ret;
+        uint8_t *data, hdr[4];
+        struct sockaddr_storage *addr;
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        ret = ff_ip_recv_batch_fill(s->rx_batch, s->udp_fd);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (ret < 0) {
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
+                s->circular_buffer_error = ret;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
-
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        while ((len = ff_ip_recv_batch_next(s->rx_batch, &data, &addr, NULL)) >= 0) {
+            if (ff_ip_check_source_lists(addr, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+
+            if (av_fifo_can_write(s->fifo) < len + 4) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
             }
+            AV_WL32(hdr, len);
+            av_fifo_write(s->fifo, hdr, 4);
+            av_fifo_write(s->fifo, data, len);
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
         pthread_cond_signal(&s->cond);
     }
 
@@ -542,6 +560,101 @@ end:
     return NULL;
 }
 
+#if HAVE_SENDMMSG
+#ifdef UDP_SEGMENT
+/* The kernel segments a message into datagrams of the same size, but for
+ * the last which can be shorter. */
+static int udp_gso_possible(const struct iovec *iovs, int nb)
+{
+    size_t size = 0;
+
+    if (nb < 2 || nb > UDP_GSO_MAX_SEGMENTS || !iovs[0].iov_len)
+        return 0;
+    for (int i = 0; i < nb; i++) {
+        if (iovs[i].iov_len > iovs[0].iov_len ||
+            (i < nb - 1 && iovs[i].iov_len != iovs[0].iov_len))
+            return 0;
+        size += iovs[i].iov_len;
+    }
+    return size <= UDP_GSO_MAX_SIZE;
+}
+
+static int udp_send_gso(UDPContext *s, struct iovec *iovs, int nb)
+{
+    union {
+        uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control = { { 0 } };
+    struct msghdr msg = {
+        .msg_name       = s->is_connected ? NULL : &s->dest_addr,
+        .msg_namelen    = s->is_connected ? 0 : s->dest_addr_len,
+        .msg_iov        = iovs,
+        .msg_iovlen     = nb,
+        .msg_control    = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    uint16_t seg_size = iovs[0].iov_len;
+    int ret;
+
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type  = UDP_SEGMENT;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(seg_size));
+    memcpy(CMSG_DATA(cmsg), &seg_size, sizeof(seg_size));
+
+    do {
+        ret = sendmsg(s->udp_fd, &msg, 0);
+    } while (ret < 0 && (ff_neterrno() == AVERROR(EAGAIN) ||
+                         ff_neterrno() == AVERROR(EINTR)));
+    return ret < 0 ? ff_neterrno() : 0;
+}
+#endif
+
+static int udp_send_batch(URLContext *h, struct mmsghdr *msgs,
+                          struct iovec *iovs, int nb)
+{
+    UDPContext *s = h->priv_data;
+    int sent = 0, ret;
+
+#ifdef UDP_SEGMENT
+    if (s->gso && udp_gso_possible(iovs, nb)) {
+        ret = udp_send_gso(s, iovs, nb);
+        if (!ret) {
+            s->nb_sent += nb;
+            s->nb_send_calls++;
+            return 0;
+        }
+        /* e.g. no checksum offload on the interface */
+        av_log(h, AV_LOG_WARNING, "Sending with UDP GSO failed (%s), disabling it\n",
+               av_err2str(ret));
+        s->gso = 0;
+    }
+#endif
+
+    for (int i = 0; i < nb; i++) {
+        msgs[i].msg_hdr = (struct msghdr) {
+            .msg_name    = s->is_connected ? NULL : &s->dest_addr,
+            .msg_namelen = s->is_connected ? 0 : s->dest_addr_len,
+            .msg_iov     = &iovs[i],
+            .msg_iovlen  = 1,
+        };
+    }
+    while (sent < nb) {
+        ret = sendmmsg(s->udp_fd, msgs + sent, nb - sent, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+            continue;
+        }
+        s->nb_sent += ret;
+        s->nb_send_calls++;
+        sent += ret;
+    }
+    return 0;
+}
+#endif
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -551,11 +664,21 @@ static void *circular_buffer_task_tx( void *_URLContext)
     int64_t sent_bits = 0;
     int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
     int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+#if HAVE_SENDMMSG
+    struct mmsghdr *msgs = av_calloc(s->batch_size, sizeof(*msgs));
+    struct iovec   *iovs = av_calloc(s->batch_size, sizeof(*iovs));
+#endif
 
     ff_thread_setname("udp-tx");
 
     pthread_mutex_lock(&s->mutex);
 
+#if HAVE_SENDMMSG
+    if (!msgs || !iovs) {
+        s->circular_buffer_error = AVERROR(ENOMEM);
+        goto end;
+    }
+#endif
     if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
         av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
         s->circular_buffer_error = AVERROR(EIO);
@@ -564,7 +687,11 @@ static void *circular_buffer_task_tx( void *_URLContext)
 
     for(;;) {
         int len;
+#if HAVE_SENDMMSG
+        int nb, size, ret;
+#else
         const uint8_t *p;
+#endif
         uint8_t tmp[4];
         int64_t timestamp;
 
@@ -607,6 +734,43 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
+#if HAVE_SENDMMSG
+        /* send the following packets along if they are already due */
+        iovs[0] = (struct iovec){ s->tmp, len };
+        size = len;
+        nb   = 1;
+        pthread_mutex_lock(&s->mutex);
+        while (nb < s->batch_size && av_fifo_can_read(s->fifo) >= 4) {
+            av_fifo_peek(s->fifo, tmp, 4, 0);
+            len = AV_RL32(tmp);
+            if (size + len > sizeof(s->tmp))
+                break;
+            if (s->bitrate) {
+                timestamp = av_gettime_relative();
+                if (timestamp < target_timestamp)
+                    break;
+                if (timestamp - burst_interval > target_timestamp) {
+                    start_timestamp = timestamp - burst_interval;
+                    sent_bits = 0;
+                }
+                sent_bits += len * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
+            }
+            av_fifo_drain2(s->fifo, 4);
+            av_fifo_read(s->fifo, s->tmp + size, len);
+            iovs[nb++] = (struct iovec){ s->tmp + size, len };
+            size += len;
+        }
+        pthread_mutex_unlock(&s->mutex);
+
+        ret = udp_send_batch(h, msgs, iovs, nb);
+        if (ret < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            goto end;
+        }
+#else
+        s->nb_sent++;
         p = s->tmp;
         while (len) {
             int ret;
@@ -620,6 +784,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
             if (ret >= 0) {
                 len -= ret;
                 p   += ret;
+                s->nb_send_calls++;
             } else {
                 ret = ff_neterrno();
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
@@ -630,12 +795,17 @@ static void *circular_buffer_task_tx( void *_URLContext)
                 }
             }
         }
+#endif
 
         pthread_mutex_lock(&s->mutex);
     }
 
 end:
     pthread_mutex_unlock(&s->mutex);
+#if HAVE_SENDMMSG
+    av_free(msgs);
+    av_free(iovs);
+#endif
     return NULL;
 }
 
@@ -755,6 +925,18 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = strtol(buf, NULL, 10);
+            if (s->batch_size < 1 || s->batch_size > 1024) {
+                av_log(h, AV_LOG_ERROR, "batch_size(%d) should be in range [1,1024]\n", s->batch_size);
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
+        }
+        if (!is_output && av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
+        if (is_output && av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
@@ -893,6 +1075,17 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = ff_neterrno();
             goto fail;
         }
+        if (s->gso) {
+#if HAVE_SENDMMSG && defined(UDP_SEGMENT)
+            /* the datagrams are only gathered when sending at a set bitrate */
+            if (!s->bitrate)
+                av_log(h, AV_LOG_WARNING, "'gso' option was set but 'bitrate' is not, but required\n");
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'gso' option was set but it is not supported on this build\n");
+            s->gso = 0;
+#endif
+        }
     } else {
         /* set udp recv buffer size to the requested value (default UDP_RX_BUF_SIZE) */
         tmp = s->buffer_size;
@@ -910,6 +1103,16 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
+
+        if (s->gro) {
+#if HAVE_RECVMMSG && defined(UDP_GRO)
+            if (setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &s->gro, sizeof(s->gro)) < 0)
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(UDP_GRO)");
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'gro' option was set but it is not supported on this build\n");
+#endif
+        }
     }
     if (s->is_connected) {
         if (connect(udp_fd, (struct sockaddr *) &s->dest_addr, s->dest_addr_len)) {
@@ -940,6 +1143,11 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        if (!is_output) {
+            ret = ff_ip_recv_batch_alloc(&s->rx_batch, s->batch_size, h->max_packet_size);
+            if (ret < 0)
+                goto fail;
+        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -973,6 +1181,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+    ff_ip_recv_batch_free(&s->rx_batch, NULL);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -991,8 +1200,8 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 {
     UDPContext *s = h->priv_data;
     int ret;
-    struct sockaddr_storage addr;
-    socklen_t addr_len = sizeof(addr);
+    uint8_t *data;
+    struct sockaddr_storage *addr;
 #if HAVE_PTHREAD_CANCEL
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
@@ -1038,16 +1247,28 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
-    if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
-        ret = ff_network_wait_fd(s->udp_fd, 0);
+    if (!s->rx_batch) {
+        ret = ff_ip_recv_batch_alloc(&s->rx_batch, s->batch_size, h->max_packet_size);
         if (ret < 0)
             return ret;
     }
-    ret = recvfrom(s->udp_fd, buf, size, 0, (struct sockaddr *)&addr, &addr_len);
-    if (ret < 0)
-        return ff_neterrno();
-    if (ff_ip_check_source_lists(&addr, &s->filters))
+    ret = ff_ip_recv_batch_next(s->rx_batch, &data, &addr, NULL);
+    if (ret == AVERROR(EAGAIN)) {
+        if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+            ret = ff_network_wait_fd(s->udp_fd, 0);
+            if (ret < 0)
+                return ret;
+        }
+        ret = ff_ip_recv_batch_fill(s->rx_batch, s->udp_fd);
+        if (ret < 0)
+            return ret;
+        ret = ff_ip_recv_batch_next(s->rx_batch, &data, &addr, NULL);
+    }
+    if (ff_ip_check_source_lists(addr, &s->filters))
         return AVERROR(EINTR);
+    /* the end of the datagram is lost, as with recvfrom() */
+    ret = FFMIN(ret, size);
+    memcpy(buf, data, ret);
     return ret;
 }
 
@@ -1097,8 +1318,12 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
                       s->dest_addr_len);
     } else
         ret = send(s->udp_fd, buf, size, 0);
+    if (ret < 0)
+        return ff_neterrno();
 
-    return ret < 0 ? ff_neterrno() : ret;
+    s->nb_sent++;
+    s->nb_send_calls++;
+    return ret;
 }
 
 static int udp_close(URLContext *h)
@@ -1142,6 +1367,11 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
+    ff_ip_recv_batch_free(&s->rx_batch, h);
+    if (s->nb_send_calls)
+        av_log(h, AV_LOG_VERBOSE,
+               "%"PRIu64" datagrams sent in %"PRIu64" system calls (%.2f per call)\n",
+               s->nb_sent, s->nb_send_calls, (double)s->nb_sent / s->nb_send_calls);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -0,0 +1,648 @@
+/*
+ * io_uring based asynchronous file I/O
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * io_uring based file protocol
+ *
+ * Reads are submitted ahead of the read position, so that several of them
+ * are in flight while the caller processes the data. Writes are copied into
+ * one of a fixed number of buffers and submitted without waiting for their
+ * completion; the caller only blocks when all buffers are in flight.
+ *
+ * The ring is driven through the raw system calls, so no external library
+ * is needed.
+ */
+
+/* for syscall() and MAP_POPULATE */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/error.h"
+#include "libavutil/file_open.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "url.h"
+
+typedef struct UringBuffer {
+    uint8_t *data;
+    int64_t  pos;       ///< file offset of the data
+    int      size;      ///< number of bytes to transfer, 0 if unused
+    int      done;      ///< number of bytes transferred so far
+    int      pending;   ///< a request for this buffer is in flight
+    int      error;
+} UringBuffer;
+
+typedef struct UringContext {
+    const AVClass *class;
+    int queue_depth;
+    int buffer_size;
+    int trunc;
+
+    int fd;
+    int write;
+
+    int ring_fd;
+    void  *sq_ring;
+    size_t sq_ring_size;
+    void  *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    atomic_uint *sq_tail;
+    atomic_uint *cq_head;
+    atomic_uint *cq_tail;
+    unsigned *sq_array;
+    unsigned  sq_mask;
+    unsigned  cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned  nb_queued;    ///< requests not yet passed to the kernel
+    unsigned  nb_pending;   ///< requests in flight
+
+    UringBuffer *bufs;
+    int64_t pos;            ///< logical read/write position
+
+    /* reading: bufs[head] to bufs[head + nb_active - 1] (modulo queue_depth)
+     * hold consecutive ranges of the file, starting at the one containing
+     * pos and ending before next_pos */
+    int head;
+    int nb_active;
+    int64_t next_pos;
+    int64_t file_size;
+
+    /* writing: first error returned by a completed request */
+    int error;
+} UringContext;
+
+#define OFFSET(x) offsetof(UringContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_ENCODING_PARAM
+
+static const AVOption options[] = {
+    { "queue_depth", "set the maximum number of requests in flight", OFFSET(queue_depth), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 256, D|E },
+    { "buffer_size", "set the size of each request in bytes", OFFSET(buffer_size), AV_OPT_TYPE_INT, { .i64 = 256 * 1024 }, 4096, INT_MAX / 2, D|E },
+    { "truncate", "truncate existing files on write", OFFSET(trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, E },
+    { NULL }
+};
+
+static int ring_setup(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+
+    c->ring_fd = syscall(__NR_io_uring_setup, c->queue_depth, &p);
+    if (c->ring_fd < 0) {
+        int ret = AVERROR(errno);
+        /* io_uring is missing from the kernel or disabled by policy */
+        if (ret == AVERROR(ENOSYS) || ret == AVERROR(EPERM)) {
+            av_log(h, AV_LOG_VERBOSE, "io_uring is not available (%s), "
+                   "reading and writing synchronously\n", av_err2str(ret));
+            return 0;
+        }
+        av_log(h, AV_LOG_ERROR, "Failed to set up io_uring: %s\n", av_err2str(ret));
+        return ret;
+    }
+
+    c->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    c->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        c->sq_ring_size = c->cq_ring_size = FFMAX(c->sq_ring_size, c->cq_ring_size);
+
+    c->sq_ring = mmap(NULL, c->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_SQ_RING);
+    if (c->sq_ring == MAP_FAILED) {
+        c->sq_ring = NULL;
+        return AVERROR(errno);
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        c->cq_ring = c->sq_ring;
+    } else {
+        c->cq_ring = mmap(NULL, c->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_CQ_RING);
+        if (c->cq_ring == MAP_FAILED) {
+            c->cq_ring = NULL;
+            return AVERROR(errno);
+        }
+    }
+
+    c->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    c->sqes = mmap(NULL, c->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, c->ring_fd, IORING_OFF_SQES);
+    if (c->sqes == MAP_FAILED) {
+        c->sqes = NULL;
+        return AVERROR(errno);
+    }
+
+    sq = c->sq_ring;
+    cq = c->cq_ring;
+    c->sq_tail  = (atomic_uint *)(sq + p.sq_off.tail);
+    c->sq_mask  = *(unsigned *)(sq + p.sq_off.ring_mask);
+    c->sq_array = (unsigned *)(sq + p.sq_off.array);
+    c->cq_head  = (atomic_uint *)(cq + p.cq_off.head);
+    c->cq_tail  = (atomic_uint *)(cq + p.cq_off.tail);
+    c->cq_mask  = *(unsigned *)(cq + p.cq_off.ring_mask);
+    c->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+static void ring_free(UringContext *c)
+{
+    if (c->sqes)
+        munmap(c->sqes, c->sqes_size);
+    if (c->cq_ring && c->cq_ring != c->sq_ring)
+        munmap(c->cq_ring, c->cq_ring_size);
+    if (c->sq_ring)
+        munmap(c->sq_ring, c->sq_ring_size);
+    if (c->ring_fd >= 0)
+        close(c->ring_fd);
+    c->sqes    = NULL;
+    c->cq_ring = c->sq_ring = NULL;
+    c->ring_fd = -1;
+}
+
+static void complete_request(UringContext *c, int idx, int res);
+
+/* Queue the transfer of the remaining part of a buffer. The number of
+ * requests never exceeds the ring size, so there is always a free entry.
+ * Without a ring, the transfer is done right away. */
+static void queue_request(UringContext *c, int idx)
+{
+    UringBuffer *b = &c->bufs[idx];
+    unsigned tail, i;
+    struct io_uring_sqe *sqe;
+
+    if (c->ring_fd < 0) {
+        ssize_t ret;
+        if (c->write)
+            ret = pwrite(c->fd, b->data + b->done, b->size - b->done, b->pos + b->done);
+        else
+            ret = pread (c->fd, b->data + b->done, b->size - b->done, b->pos + b->done);
+        b->pending = 1;
+        c->nb_pending++;
+        complete_request(c, idx, ret < 0 ? -errno : ret);
+        return;
+    }
+
+    tail = atomic_load_explicit(c->sq_tail, memory_order_relaxed);
+    i    = tail & c->sq_mask;
+    sqe  = &c->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = c->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd        = c->fd;
+    sqe->addr      = (uintptr_t)(b->data + b->done);
+    sqe->len       = b->size - b->done;
+    sqe->off       = b->pos + b->done;
+    sqe->user_data = idx;
+    c->sq_array[i] = i;
+
+    atomic_store_explicit(c->sq_tail, tail + 1, memory_order_release);
+
+    b->pending = 1;
+    c->nb_queued++;
+    c->nb_pending++;
+}
+
+static void complete_request(UringContext *c, int idx, int res)
+{
+    UringBuffer *b = &c->bufs[idx];
+
+    b->pending = 0;
+    c->nb_pending--;
+
+    if (res < 0) {
+        b->error = AVERROR(-res);
+    } else if (res == 0) {
+        /* end of file for reads, which leaves the buffer short */
+        if (c->write)
+            b->error = AVERROR(EIO);
+    } else {
+        b->done += res;
+        if (b->done < b->size) {
+            queue_request(c, idx);
+            return;
+        }
+    }
+
+    if (c->write) {
+        if (b->error && !c->error)
+            c->error = b->error;
+        b->size = 0;
+    }
+}
+
+/**
+ * Process all available completions.
+ *
+ * @return number of processed completions
+ */
+static unsigned ring_reap(UringContext *c)
+{
+    unsigned head = atomic_load_explicit(c->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(c->cq_tail, memory_order_acquire);
+    unsigned nb   = tail - head;
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &c->cqes[head & c->cq_mask];
+        complete_request(c, cqe->user_data, cqe->res);
+    }
+    atomic_store_explicit(c->cq_head, head, memory_order_release);
+
+    return nb;
+}
+
+/**
+ * Submit the queued requests and process the completed ones.
+ * If wait is set and requests are in flight, block until at least one of
+ * them completes.
+ */
+static int ring_process(URLContext *h, int wait)
+{
+    UringContext *c = h->priv_data;
+    int busy = 0;
+
+    /* synchronous requests are complete as soon as they are queued */
+    if (c->ring_fd < 0)
+        return 0;
+
+    if (ring_reap(c))
+        wait = 0;
+    wait = wait && c->nb_pending;
+
+    while (c->nb_queued || wait) {
+        /* when the kernel cannot take more requests, only wait for some of
+         * the submitted ones to complete, which makes room for the others */
+        unsigned to_submit    = busy ? 0 : c->nb_queued;
+        unsigned min_complete = wait || busy;
+        unsigned flags        = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        int ret;
+
+        ret = syscall(__NR_io_uring_enter, c->ring_fd, to_submit,
+                      min_complete, flags, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EBUSY) && !busy &&
+                c->nb_pending > c->nb_queued) {
+                busy = 1;
+                continue;
+            }
+            ret = AVERROR(errno);
+            av_log(h, AV_LOG_ERROR, "io_uring_enter() failed: %s\n", av_err2str(ret));
+            return ret;
+        }
+        c->nb_queued -= ret;
+
+        if (ring_reap(c) || busy)
+            wait = 0;
+        busy = 0;
+    }
+
+    return 0;
+}
+
+static int drain(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+
+    while (c->nb_pending) {
+        int ret = ring_process(h, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int update_file_size(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    struct stat st;
+
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+    c->file_size = st.st_size;
+    return 0;
+}
+
+/* Keep as many reads in flight as there are free buffers. */
+static int fill_readahead(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+
+    while (c->nb_active < c->queue_depth && c->next_pos < c->file_size) {
+        int idx = (c->head + c->nb_active) % c->queue_depth;
+        UringBuffer *b = &c->bufs[idx];
+
+        b->pos   = c->next_pos;
+        b->size  = c->buffer_size;
+        b->done  = 0;
+        b->error = 0;
+        queue_request(c, idx);
+
+        c->next_pos += c->buffer_size;
+        c->nb_active++;
+    }
+
+    return ring_process(h, 0);
+}
+
+static int retire_head(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+
+    while (c->bufs[c->head].pending) {
+        int ret = ring_process(h, 1);
+        if (ret < 0)
+            return ret;
+    }
+    c->head = (c->head + 1) % c->queue_depth;
+    c->nb_active--;
+    return 0;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    UringContext *c = h->priv_data;
+    int ret;
+
+    while (1) {
+        UringBuffer *b;
+        int64_t avail;
+
+        if (!c->nb_active && c->next_pos >= c->file_size) {
+            /* the file may have grown since it was opened */
+            if ((ret = update_file_size(h)) < 0)
+                return ret;
+            if (c->pos >= c->file_size)
+                return AVERROR_EOF;
+            c->next_pos = c->pos;
+        }
+
+        if ((ret = fill_readahead(h)) < 0)
+            return ret;
+
+        b = &c->bufs[c->head];
+        while (b->pending) {
+            if ((ret = ring_process(h, 1)) < 0)
+                return ret;
+        }
+        if (b->error)
+            return b->error;
+
+        avail = b->pos + b->done - c->pos;
+        if (avail > 0) {
+            size = FFMIN(size, avail);
+            memcpy(buf, b->data + (c->pos - b->pos), size);
+            c->pos += size;
+            if (c->pos == b->pos + b->size && (ret = retire_head(h)) < 0)
+                return ret;
+            return size;
+        }
+
+        if (b->done < b->size) {
+            /* the file ended before the end of this buffer */
+            ret = drain(h);
+            c->head      = 0;
+            c->nb_active = 0;
+            c->next_pos  = c->pos;
+            c->file_size = c->pos;
+            return ret < 0 ? ret : AVERROR_EOF;
+        }
+
+        if ((ret = retire_head(h)) < 0)
+            return ret;
+    }
+}
+
+static int uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    UringContext *c = h->priv_data;
+    UringBuffer *b = NULL;
+    int ret;
+
+    while (1) {
+        if (c->error)
+            return c->error;
+        for (int i = 0; i < c->queue_depth; i++) {
+            if (!c->bufs[i].size) {
+                b = &c->bufs[i];
+                break;
+            }
+        }
+        if (b)
+            break;
+        if ((ret = ring_process(h, 1)) < 0)
+            return ret;
+    }
+
+    size = FFMIN(size, c->buffer_size);
+    memcpy(b->data, buf, size);
+    b->pos   = c->pos;
+    b->size  = size;
+    b->done  = 0;
+    b->error = 0;
+    queue_request(c, b - c->bufs);
+    c->pos += size;
+
+    ret = ring_process(h, 0);
+    return ret < 0 ? ret : size;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    UringContext *c = h->priv_data;
+    int ret;
+
+    if (whence == AVSEEK_SIZE) {
+        /* make sure the size includes the data still in flight */
+        if (c->write && (ret = drain(h)) < 0)
+            return ret;
+        if ((ret = update_file_size(h)) < 0)
+            return ret;
+        return c->file_size;
+    }
+
+    if (whence == SEEK_CUR) {
+        pos += c->pos;
+    } else if (whence == SEEK_END) {
+        if ((c->write && (ret = drain(h)) < 0) ||
+            (ret = update_file_size(h)) < 0)
+            return ret;
+        pos += c->file_size;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (c->write) {
+        /* writes to overlapping ranges could complete in any order */
+        if ((ret = drain(h)) < 0)
+            return ret;
+        if (c->error)
+            return c->error;
+    } else if (c->nb_active && pos >= c->bufs[c->head].pos && pos < c->next_pos) {
+        /* keep the readahead that is still useful */
+        while (pos >= c->bufs[c->head].pos + c->bufs[c->head].size) {
+            if ((ret = retire_head(h)) < 0)
+                return ret;
+        }
+    } else {
+        if ((ret = drain(h)) < 0)
+            return ret;
+        c->head      = 0;
+        c->nb_active = 0;
+        c->next_pos  = pos;
+    }
+
+    c->pos = pos;
+    return pos;
+}
+
+static int uring_get_handle(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    return c->fd;
+}
+
+static int uring_close(URLContext *h)
+{
+    UringContext *c = h->priv_data;
+    int ret = 0;
+
+    if (c->ring_fd >= 0)
+        ret = drain(h);
+    if (ret >= 0)
+        ret = c->error;
+
+    ring_free(c);
+    if (c->bufs) {
+        for (int i = 0; i < c->queue_depth; i++)
+            av_freep(&c->bufs[i].data);
+        av_freep(&c->bufs);
+    }
+    if (c->fd >= 0 && close(c->fd) < 0 && ret >= 0)
+        ret = AVERROR(errno);
+    c->fd = -1;
+
+    return ret;
+}
+
+static int uring_open(URLContext *h, const char *filename, int flags)
+{
+    UringContext *c = h->priv_data;
+    struct stat st;
+    int access, ret;
+
+    c->fd      = -1;
+    c->ring_fd = -1;
+
+    av_strstart(filename, "uring:", &filename);
+
+    if ((flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_READ_WRITE) {
+        av_log(h, AV_LOG_ERROR, "Opening for both reading and writing is not supported\n");
+        return AVERROR(ENOSYS);
+    }
+
+    c->write = !!(flags & AVIO_FLAG_WRITE);
+    if (c->write) {
+        access = O_CREAT | O_WRONLY;
+        if (c->trunc)
+            access |= O_TRUNC;
+    } else {
+        access = O_RDONLY;
+    }
+
+    c->fd = avpriv_open(filename, access, 0666);
+    if (c->fd < 0)
+        return AVERROR(errno);
+
+    if (fstat(c->fd, &st) < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        av_log(h, AV_LOG_ERROR, "Only regular files are supported\n");
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+    c->file_size = st.st_size;
+
+    c->bufs = av_calloc(c->queue_depth, sizeof(*c->bufs));
+    if (!c->bufs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < c->queue_depth; i++) {
+        c->bufs[i].data = av_malloc(c->buffer_size);
+        if (!c->bufs[i].data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+
+    if ((ret = ring_setup(h)) < 0)
+        goto fail;
+
+    /* let each write fill a whole buffer */
+    if (c->write)
+        h->min_packet_size = h->max_packet_size = c->buffer_size;
+
+    return 0;
+fail:
+    uring_close(h);
+    return ret;
+}
+
+static const AVClass uring_context_class = {
+    .class_name = "uring",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_uring_protocol = {
+    .name                = "uring",
+    .url_open            = uring_open,
+    .url_read            = uring_read,
+    .url_write           = uring_write,
+    .url_seek            = uring_seek,
+    .url_close           = uring_close,
+    .url_get_file_handle = uring_get_handle,
+    .priv_data_size      = sizeof(UringContext),
+    .priv_data_class     = &uring_context_class,
+    .default_whitelist   = "uring,crypto,data",
+};
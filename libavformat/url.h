@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -84,6 +85,18 @@ typedef struct URLProtocol {
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
     int (*url_shutdown)(URLContext *h, int flags);
+    /**
+     * Return a reference to size bytes of the resource starting at pos
+     * without copying them. The referenced memory must stay valid for
+     * the lifetime of the reference, also after the protocol is closed,
+     * and be followed by AV_INPUT_BUFFER_PADDING_SIZE readable bytes, which
+     * are the next bytes of the resource or zeros past its end.
+     * The read position of the protocol is not changed.
+     * Return the number of bytes referenced, AVERROR(ENOSYS) if the range
+     * cannot be referenced or another negative error code.
+     */
+    int (*url_read_buffer)(URLContext *h, int64_t pos, int size,
+                           AVBufferRef **buf);
     const AVClass *priv_data_class;
     int priv_data_size;
     int flags;
@@ -263,6 +276,15 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(void *urlcontext);
 
+/**
+ * Reference size bytes of the resource starting at pos without copying
+ * them, if the protocol supports it.
+ *
+ * @return number of bytes referenced on success, AVERROR(ENOSYS) if not
+ *         supported for this URL or range, another negative value on error
+ */
+int ffurl_read_buffer(URLContext *h, int64_t pos, int size, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -20,8 +20,12 @@
 
 #include "config.h"
 
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <string.h>
 
+#include "error.h"
 #include "mem.h"
 #include "thread.h"
 
@@ -43,11 +47,104 @@
 
 #endif //!HAVE_THREADS
 
+/* Thread local record of the executor the calling thread works for, which
+ * tells when a graph is started from one of its own tasks. */
+static AVOnce worker_key_once = AV_ONCE_INIT;
+
+#if HAVE_PTHREADS
+
+static pthread_key_t worker_key;
+static int worker_key_valid;
+
+static void worker_key_init(void)
+{
+    worker_key_valid = !pthread_key_create(&worker_key, NULL);
+}
+
+static void set_worker(AVExecutor *e)
+{
+    if (worker_key_valid)
+        pthread_setspecific(worker_key, e);
+}
+
+static int is_worker(const AVExecutor *e)
+{
+    return worker_key_valid && pthread_getspecific(worker_key) == e;
+}
+
+#elif HAVE_W32THREADS
+
+static DWORD worker_key = TLS_OUT_OF_INDEXES;
+
+static void worker_key_init(void)
+{
+    worker_key = TlsAlloc();
+}
+
+static void set_worker(AVExecutor *e)
+{
+    if (worker_key != TLS_OUT_OF_INDEXES)
+        TlsSetValue(worker_key, e);
+}
+
+static int is_worker(const AVExecutor *e)
+{
+    return worker_key != TLS_OUT_OF_INDEXES && TlsGetValue(worker_key) == e;
+}
+
+#else
+
+/* nested graphs are not detected with OS/2 threads */
+static void worker_key_init(void) { }
+#define set_worker(e)   do {} while (0)
+#define is_worker(e)    0
+
+#endif
+
 typedef struct ThreadInfo {
     AVExecutor *e;
     ExecutorThread thread;
 } ThreadInfo;
 
+typedef struct GraphTask {
+    AVTaskFunc func;
+    void *opaque;
+    int arg;
+
+    AVTaskGraph *graph;
+    int *successors;
+    int nb_successors;
+    int nb_dependencies;
+
+    /* number of dependencies which did not finish yet in the current run */
+    atomic_int pending;
+
+    /* links in the TaskDeque the task is queued on */
+    struct GraphTask *prev, *next;
+} GraphTask;
+
+struct AVTaskGraph {
+    GraphTask *tasks;
+    int nb_tasks;
+    int checked; /* set if the dependencies are known to contain no cycle */
+
+    /* state of the current run */
+    atomic_int remaining;
+    atomic_int ret;
+    AVMutex lock;
+    AVCond cond;
+    int done;
+};
+
+/**
+ * Ready graph tasks of a worker thread. The owning thread queues and takes
+ * tasks at the bottom, other threads steal tasks from the top.
+ */
+typedef struct TaskDeque {
+    AVMutex lock;
+    GraphTask *top, *bottom;
+} TaskDeque;
+
 struct AVExecutor {
     AVTaskCallbacks cb;
     int thread_count;
@@ -61,6 +158,15 @@ struct AVExecutor {
     int die;
 
     AVTask *tasks;
+
+    /**
+     * One deque per worker thread, followed by the deque of tasks queued by
+     * av_executor_start_graph(). The latter is only ever taken from the top,
+     * so that the graphs of different callers are served in submission order.
+     */
+    TaskDeque *deques;
+    int nb_deques;
+    atomic_int nb_ready;      /* number of queued graph tasks */
 };
 
 static AVTask* remove_task(AVTask **prev, AVTask *t)
@@ -95,17 +201,130 @@ static int run_one_task(AVExecutor *e, void *lc)
     return 0;
 }
 
+static void deque_push(AVExecutor *e, TaskDeque *d, GraphTask *t)
+{
+    ff_mutex_lock(&d->lock);
+    t->prev = d->bottom;
+    t->next = NULL;
+    if (d->bottom)
+        d->bottom->next = t;
+    else
+        d->top = t;
+    d->bottom = t;
+    atomic_fetch_add(&e->nb_ready, 1);
+    ff_mutex_unlock(&d->lock);
+}
+
+static GraphTask *deque_pop(AVExecutor *e, TaskDeque *d)
+{
+    GraphTask *t;
+
+    ff_mutex_lock(&d->lock);
+    t = d->bottom;
+    if (t) {
+        d->bottom = t->prev;
+        if (d->bottom)
+            d->bottom->next = NULL;
+        else
+            d->top = NULL;
+        atomic_fetch_sub(&e->nb_ready, 1);
+    }
+    ff_mutex_unlock(&d->lock);
+    return t;
+}
+
+static GraphTask *deque_steal(AVExecutor *e, TaskDeque *d)
+{
+    GraphTask *t;
+
+    ff_mutex_lock(&d->lock);
+    t = d->top;
+    if (t) {
+        d->top = t->next;
+        if (d->top)
+            d->top->prev = NULL;
+        else
+            d->bottom = NULL;
+        atomic_fetch_sub(&e->nb_ready, 1);
+    }
+    ff_mutex_unlock(&d->lock);
+    return t;
+}
+
+static void wake_workers(AVExecutor *e)
+{
+    ff_mutex_lock(&e->lock);
+    ff_cond_broadcast(&e->cond);
+    ff_mutex_unlock(&e->lock);
+}
+
+static void graph_task_run(AVExecutor *e, GraphTask *t, int thread)
+{
+    AVTaskGraph *g = t->graph;
+    int ret, nb_queued = 0;
+
+    ret = t->func(t->opaque, t->arg, thread);
+    if (ret < 0) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&g->ret, &expected, ret);
+    }
+
+    for (int i = 0; i < t->nb_successors; i++) {
+        GraphTask *next = &g->tasks[t->successors[i]];
+        if (atomic_fetch_sub(&next->pending, 1) == 1) {
+            deque_push(e, &e->deques[thread], next);
+            nb_queued++;
+        }
+    }
+    /* this thread takes one of them itself */
+    if (nb_queued > 1)
+        wake_workers(e);
+
+    /* the graph may be freed as soon as the caller is signalled */
+    if (atomic_fetch_sub(&g->remaining, 1) == 1) {
+        ff_mutex_lock(&g->lock);
+        g->done = 1;
+        ff_cond_signal(&g->cond);
+        ff_mutex_unlock(&g->lock);
+    }
+}
+
 #if HAVE_THREADS
+static int run_graph_task(AVExecutor *e, int thread)
+{
+    GraphTask *t = deque_pop(e, &e->deques[thread]);
+
+    if (!t)
+        t = deque_steal(e, &e->deques[e->thread_count]);
+    for (int i = 1; !t && i < e->thread_count; i++)
+        t = deque_steal(e, &e->deques[(thread + i) % e->thread_count]);
+    if (!t)
+        return 0;
+
+    graph_task_run(e, t, thread);
+    return 1;
+}
+
 static void *executor_worker_task(void *data)
 {
     ThreadInfo *ti = (ThreadInfo*)data;
     AVExecutor *e  = ti->e;
-    void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
+    const int idx  = ti - e->threads;
+    void *lc       = e->local_contexts + idx * e->cb.local_context_size;
+
+    set_worker(e);
 
     ff_mutex_lock(&e->lock);
     while (1) {
         if (e->die) break;
 
+        if (atomic_load(&e->nb_ready) > 0) {
+            ff_mutex_unlock(&e->lock);
+            run_graph_task(e, idx);
+            ff_mutex_lock(&e->lock);
+            continue;
+        }
+
         if (!run_one_task(e, lc)) {
             //no task in one loop
             ff_cond_wait(&e->cond, &e->lock);
@@ -133,6 +352,10 @@ static void executor_free(AVExecutor *e, const int has_lock, const int has_cond)
     if (has_lock)
         ff_mutex_destroy(&e->lock);
 
+    for (int i = 0; i < e->nb_deques; i++)
+        ff_mutex_destroy(&e->deques[i].lock);
+    av_free(e->deques);
+
     av_free(e->threads);
     av_free(e->local_contexts);
 
@@ -143,13 +366,15 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
 {
     AVExecutor *e;
     int has_lock = 0, has_cond = 0;
-    if (!cb || !cb->user_data || !cb->ready || !cb->run || !cb->priority_higher)
+    if (cb && (!cb->user_data || !cb->ready || !cb->run || !cb->priority_higher))
         return NULL;
 
     e = av_mallocz(sizeof(*e));
     if (!e)
         return NULL;
-    e->cb = *cb;
+    if (cb)
+        e->cb = *cb;
+    atomic_init(&e->nb_ready, 0);
 
     e->local_contexts = av_calloc(FFMAX(thread_count, 1), e->cb.local_context_size);
     if (!e->local_contexts)
@@ -162,6 +387,16 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
     if (!thread_count)
         return e;
 
+    ff_thread_once(&worker_key_once, worker_key_init);
+
+    e->deques = av_calloc(thread_count + 1, sizeof(*e->deques));
+    if (!e->deques)
+        goto free_executor;
+    for (; e->nb_deques < thread_count + 1; e->nb_deques++) {
+        if (ff_mutex_init(&e->deques[e->nb_deques].lock, NULL))
+            goto free_executor;
+    }
+
     has_lock = !ff_mutex_init(&e->lock, NULL);
     has_cond = !ff_cond_init(&e->cond, NULL);
 
@@ -219,3 +454,209 @@ void av_executor_execute(AVExecutor *e, AVTask *t)
         e->recursive = false;
     }
 }
+
+int av_executor_thread_count(const AVExecutor *e)
+{
+    return e->thread_count;
+}
+
+AVTaskGraph *av_task_graph_alloc(void)
+{
+    AVTaskGraph *g = av_mallocz(sizeof(*g));
+    if (!g)
+        return NULL;
+
+    if (ff_mutex_init(&g->lock, NULL)) {
+        av_free(g);
+        return NULL;
+    }
+    if (ff_cond_init(&g->cond, NULL)) {
+        ff_mutex_destroy(&g->lock);
+        av_free(g);
+        return NULL;
+    }
+    atomic_init(&g->remaining, 0);
+    atomic_init(&g->ret, 0);
+    g->checked = 1;
+
+    return g;
+}
+
+void av_task_graph_free(AVTaskGraph **pg)
+{
+    AVTaskGraph *g = *pg;
+    if (!g)
+        return;
+
+    for (int i = 0; i < g->nb_tasks; i++)
+        av_free(g->tasks[i].successors);
+    av_free(g->tasks);
+    ff_cond_destroy(&g->cond);
+    ff_mutex_destroy(&g->lock);
+    av_freep(pg);
+}
+
+int av_task_graph_add_task(AVTaskGraph *g, AVTaskFunc func, void *opaque, int arg)
+{
+    GraphTask *tasks, *t;
+
+    if (!func || g->nb_tasks == INT_MAX)
+        return AVERROR(EINVAL);
+
+    tasks = av_realloc_array(g->tasks, g->nb_tasks + 1, sizeof(*g->tasks));
+    if (!tasks)
+        return AVERROR(ENOMEM);
+    g->tasks = tasks;
+
+    t = &g->tasks[g->nb_tasks];
+    memset(t, 0, sizeof(*t));
+    t->func   = func;
+    t->opaque = opaque;
+    t->arg    = arg;
+    t->graph  = g;
+    atomic_init(&t->pending, 0);
+
+    return g->nb_tasks++;
+}
+
+int av_task_graph_add_dependency(AVTaskGraph *g, int task, int dependency)
+{
+    GraphTask *dep;
+    int *successors;
+
+    if (task < 0 || task >= g->nb_tasks || dependency < 0 ||
+        dependency >= g->nb_tasks || task == dependency)
+        return AVERROR(EINVAL);
+
+    dep = &g->tasks[dependency];
+    successors = av_realloc_array(dep->successors, dep->nb_successors + 1,
+                                  sizeof(*dep->successors));
+    if (!successors)
+        return AVERROR(ENOMEM);
+    dep->successors = successors;
+    dep->successors[dep->nb_successors++] = task;
+
+    g->tasks[task].nb_dependencies++;
+    g->checked = 0;
+    return 0;
+}
+
+/* Check that all tasks can eventually run, i.e. that there are no cycles */
+static int graph_check(AVTaskGraph *g)
+{
+    int *pending, *ready, nb_ready = 0, nb_done = 0;
+
+    if (g->checked)
+        return 0;
+
+    pending = av_malloc_array(g->nb_tasks, 2 * sizeof(*pending));
+    if (!pending)
+        return AVERROR(ENOMEM);
+    ready = pending + g->nb_tasks;
+
+    for (int i = 0; i < g->nb_tasks; i++) {
+        pending[i] = g->tasks[i].nb_dependencies;
+        if (!pending[i])
+            ready[nb_ready++] = i;
+    }
+
+    while (nb_ready) {
+        const GraphTask *t = &g->tasks[ready[--nb_ready]];
+        for (int i = 0; i < t->nb_successors; i++) {
+            if (!--pending[t->successors[i]])
+                ready[nb_ready++] = t->successors[i];
+        }
+        nb_done++;
+    }
+
+    av_free(pending);
+    if (nb_done != g->nb_tasks)
+        return AVERROR(EINVAL);
+
+    g->checked = 1;
+    return 0;
+}
+
+static int graph_run_inline(AVTaskGraph *g)
+{
+    GraphTask *stack = NULL;
+    int ret = 0;
+
+    for (int i = 0; i < g->nb_tasks; i++) {
+        GraphTask *t = &g->tasks[i];
+        if (!t->nb_dependencies) {
+            t->next = stack;
+            stack = t;
+        }
+    }
+
+    while (stack) {
+        GraphTask *t = stack;
+        int err;
+
+        stack = t->next;
+        err = t->func(t->opaque, t->arg, 0);
+        if (err < 0 && !ret)
+            ret = err;
+
+        for (int i = 0; i < t->nb_successors; i++) {
+            GraphTask *next = &g->tasks[t->successors[i]];
+            if (atomic_fetch_sub(&next->pending, 1) == 1) {
+                next->next = stack;
+                stack = next;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int av_executor_start_graph(AVExecutor *e, AVTaskGraph *g)
+{
+    int ret = graph_check(g);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < g->nb_tasks; i++)
+        atomic_store(&g->tasks[i].pending, g->tasks[i].nb_dependencies);
+    atomic_store(&g->ret, 0);
+    atomic_store(&g->remaining, g->nb_tasks);
+    g->done = !g->nb_tasks;
+
+    /* a task waiting for a graph on its own executor could take the last
+     * free thread, so the graph is run on the calling thread instead */
+    if (!e->thread_count || !HAVE_THREADS || is_worker(e)) {
+        atomic_store(&g->ret, graph_run_inline(g));
+        atomic_store(&g->remaining, 0);
+        g->done = 1;
+        return 0;
+    }
+
+    for (int i = 0; i < g->nb_tasks; i++) {
+        GraphTask *t = &g->tasks[i];
+        if (!t->nb_dependencies)
+            deque_push(e, &e->deques[e->thread_count], t);
+    }
+    if (g->nb_tasks)
+        wake_workers(e);
+
+    return 0;
+}
+
+int av_executor_wait_graph(AVExecutor *e, AVTaskGraph *g)
+{
+    ff_mutex_lock(&g->lock);
+    while (!g->done)
+        ff_cond_wait(&g->cond, &g->lock);
+    ff_mutex_unlock(&g->lock);
+
+    return atomic_load(&g->ret);
+}
+
+int av_executor_run_graph(AVExecutor *e, AVTaskGraph *g)
+{
+    int ret = av_executor_start_graph(e, g);
+    if (ret < 0)
+        return ret;
+    return av_executor_wait_graph(e, g);
+}
@@ -45,7 +45,8 @@ typedef struct AVTaskCallbacks {
 
 /**
  * Alloc executor
- * @param callbacks callback structure for executor
+ * @param callbacks callback structure for executor, may be NULL if the
+ *                  executor is only used to run task graphs
  * @param thread_count worker thread number, 0 for run on caller's thread directly
  * @return return the executor
  */
@@ -64,4 +65,108 @@ void av_executor_free(AVExecutor **e);
  */
 void av_executor_execute(AVExecutor *e, AVTask *t);
 
+/**
+ * Get the number of worker threads of the executor
+ * @param e pointer to executor
+ * @return the thread_count the executor was allocated with
+ */
+int av_executor_thread_count(const AVExecutor *e);
+
+/**
+ * A graph of tasks with dependencies between them. Tasks only start running
+ * once all the tasks they depend on have finished. The graph can be run
+ * repeatedly, and by any executor.
+ */
+typedef struct AVTaskGraph AVTaskGraph;
+
+/**
+ * Function run by a task of an AVTaskGraph
+ * @param opaque the opaque pointer the task was added with
+ * @param arg    the integer argument the task was added with
+ * @param thread index of the thread running the task, lower than
+ *               av_executor_thread_count(), or 0 if that is 0. Tasks of the
+ *               same graph which run at the same time never share an index.
+ * @return 0 on success, a negative error code otherwise
+ */
+typedef int (*AVTaskFunc)(void *opaque, int arg, int thread);
+
+/**
+ * Alloc an empty task graph
+ * @return the graph, or NULL on allocation failure
+ */
+AVTaskGraph *av_task_graph_alloc(void);
+
+/**
+ * Free a task graph. It must not be running.
+ * @param g pointer to the graph, set to NULL
+ */
+void av_task_graph_free(AVTaskGraph **g);
+
+/**
+ * Add a task to the graph. It must not be running.
+ * @param g      pointer to the graph
+ * @param func   function run by the task
+ * @param opaque opaque pointer passed to func
+ * @param arg    integer argument passed to func
+ * @return the index of the task, or a negative error code
+ */
+int av_task_graph_add_task(AVTaskGraph *g, AVTaskFunc func, void *opaque, int arg);
+
+/**
+ * Make a task wait for another task. The graph must not be running.
+ * @param g          pointer to the graph
+ * @param task       index of the waiting task
+ * @param dependency index of the task to wait for
+ * @return 0 on success, a negative error code otherwise
+ */
+int av_task_graph_add_dependency(AVTaskGraph *g, int task, int dependency);
+
+/**
+ * Start running all tasks of a graph, without waiting for them to finish.
+ *
+ * Ready tasks are queued on per-thread deques. A thread runs the tasks its
+ * own finished tasks made ready first, then the tasks of started graphs in
+ * the order the graphs were started, and takes work from the other threads
+ * when it runs out. The graphs of several callers, e.g. different codec or
+ * filter instances sharing the executor, can run at the same time.
+ *
+ * There is no fairness between callers: a graph with many tasks delays the
+ * graphs started after it until threads become free, so the latency of each
+ * caller depends on the load the others put on the executor.
+ *
+ * If the executor has no threads, or if this is called from a task running
+ * on the same executor, the tasks are run on the calling thread before
+ * returning. Waiting for the other threads from one of them could deadlock
+ * once all of them are waiting.
+ *
+ * @param e pointer to executor
+ * @param g pointer to the graph
+ * @return 0 on success, AVERROR(EINVAL) if the dependencies contain a cycle
+ *         or another negative error code
+ */
+int av_executor_start_graph(AVExecutor *e, AVTaskGraph *g);
+
+/**
+ * Wait for all tasks of a graph started with av_executor_start_graph() to
+ * finish.
+ *
+ * @param e pointer to executor
+ * @param g pointer to the graph
+ * @return 0 if all tasks succeeded, or the error code returned by one of the
+ *         failed tasks
+ */
+int av_executor_wait_graph(AVExecutor *e, AVTaskGraph *g);
+
+/**
+ * Run all tasks of a graph and wait for them to finish, like
+ * av_executor_start_graph() followed by av_executor_wait_graph().
+ *
+ * @param e pointer to executor
+ * @param g pointer to the graph
+ * @return 0 if all tasks succeeded, the error code returned by one of the
+ *         failed tasks, AVERROR(EINVAL) if the dependencies contain a cycle
+ *         or another negative error code
+ */
+int av_executor_run_graph(AVExecutor *e, AVTaskGraph *g);
+
 #endif //AVUTIL_EXECUTOR_H
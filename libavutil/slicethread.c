@@ -18,6 +18,7 @@
 
 #include <stdatomic.h>
 #include "cpu.h"
+#include "executor.h"
 #include "internal.h"
 #include "slicethread.h"
 #include "mem.h"
@@ -52,6 +53,10 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* shared thread pool, used instead of private workers if set */
+    AVExecutor      *executor;
+    AVTaskGraph     **graphs; /* graphs[i] runs run_jobs() on i threads of the pool */
 };
 
 static int run_jobs(AVSliceThread *ctx)
@@ -68,6 +73,21 @@ static int run_jobs(AVSliceThread *ctx)
     return current_job == nb_jobs + nb_active_threads - 1;
 }
 
+/* On the pool, a task may start long after the others, so no job is reserved
+ * for it: all jobs are claimed in order from current_job, and a job can only
+ * wait for jobs already claimed by running threads. first_job only hands out
+ * the thread indices. */
+static void run_pool_jobs(AVSliceThread *ctx)
+{
+    unsigned nb_jobs    = ctx->nb_jobs;
+    unsigned nb_active_threads = ctx->nb_active_threads;
+    unsigned threadnr   = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
+    unsigned current_job;
+
+    while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, current_job, threadnr, nb_jobs, nb_active_threads);
+}
+
 static void *attribute_align_arg thread_worker(void *v)
 {
     WorkerContext *w = v;
@@ -95,6 +115,83 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+static int pool_task(void *opaque, int arg, int thread)
+{
+    run_pool_jobs(opaque);
+    return 0;
+}
+
+static void execute_pool(AVSliceThread *ctx, int nb_tasks, int execute_main)
+{
+    AVTaskGraph *graph = ctx->graphs[nb_tasks];
+
+    /* graphs without dependencies cannot fail to start */
+    if (nb_tasks)
+        av_executor_start_graph(ctx->executor, graph);
+
+    if (ctx->main_func && execute_main)
+        ctx->main_func(ctx->priv);
+    else
+        run_pool_jobs(ctx);
+
+    if (nb_tasks)
+        av_executor_wait_graph(ctx->executor, graph);
+}
+
+av_cold
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     AVExecutor *executor)
+{
+    AVSliceThread *ctx;
+    int nb_threads = av_executor_thread_count(executor);
+    int ret = AVERROR(ENOMEM);
+
+    *pctx = NULL;
+    if (nb_threads <= 0)
+        return AVERROR(EINVAL);
+
+    /* the calling thread runs jobs too, unless it runs main_func */
+    if (!main_func)
+        nb_threads++;
+
+    *pctx = ctx = av_mallocz(sizeof(*ctx));
+    if (!ctx)
+        return AVERROR(ENOMEM);
+
+    ctx->priv        = priv;
+    ctx->worker_func = worker_func;
+    ctx->main_func   = main_func;
+    ctx->nb_threads  = nb_threads;
+    ctx->executor    = executor;
+    atomic_init(&ctx->first_job, 0);
+    atomic_init(&ctx->current_job, 0);
+
+    ctx->graphs = av_calloc(nb_threads + 1, sizeof(*ctx->graphs));
+    if (!ctx->graphs)
+        goto fail;
+
+    for (int i = 1; i <= nb_threads; i++) {
+        ctx->graphs[i] = av_task_graph_alloc();
+        if (!ctx->graphs[i]) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (int j = 0; j < i; j++) {
+            ret = av_task_graph_add_task(ctx->graphs[i], pool_task, ctx, j);
+            if (ret < 0)
+                goto fail;
+        }
+    }
+
+    return nb_threads;
+
+fail:
+    avpriv_slicethread_free(pctx);
+    return ret;
+}
+
 av_cold
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
@@ -196,11 +293,17 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
-    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, ctx->executor ? 0 : ctx->nb_active_threads,
+                          memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
 
+    if (ctx->executor) {
+        execute_pool(ctx, nb_workers, execute_main);
+        return;
+    }
+
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
         pthread_mutex_lock(&w->mutex);
@@ -231,6 +334,14 @@ av_cold void avpriv_slicethread_free(AVSliceThread **pctx)
     if (!ctx)
         return;
 
+    if (ctx->executor) {
+        for (i = 0; ctx->graphs && i <= ctx->nb_threads; i++)
+            av_task_graph_free(&ctx->graphs[i]);
+        av_freep(&ctx->graphs);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -259,6 +370,15 @@ av_cold void avpriv_slicethread_free(AVSliceThread **pctx)
 
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     AVExecutor *executor)
+{
+    *pctx = NULL;
+    return AVERROR(ENOSYS);
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -21,6 +21,8 @@
 
 typedef struct AVSliceThread AVSliceThread;
 
+struct AVExecutor;
+
 /**
  * Create slice threading context.
  * @param pctx slice threading context returned here
@@ -35,6 +37,21 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create slice threading context running its jobs on a thread pool shared
+ * with other contexts, instead of on private worker threads.
+ * @param pctx slice threading context returned here
+ * @param priv private pointer to be passed to callback function
+ * @param worker_func callback function to be executed
+ * @param main_func special callback function, called from main thread, may be NULL
+ * @param executor thread pool with at least one thread, must outlive the context
+ * @return return number of threads or negative AVERROR on failure
+ */
+int avpriv_slicethread_create_shared(AVSliceThread **pctx, void *priv,
+                                     void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                                     void (*main_func)(void *priv),
+                                     struct AVExecutor *executor);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
@@ -0,0 +1,386 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "libavutil/error.h"
+#include "libavutil/executor.h"
+#include "libavutil/macros.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+
+#define LAYERS      6
+#define LAYER_SIZE  8
+#define NB_TASKS    (LAYERS * LAYER_SIZE)
+#define MAX_THREADS 4
+
+typedef struct TestGraph {
+    AVTaskGraph *graph;
+    atomic_int seq;
+    atomic_int done[NB_TASKS];     /* sequence number at which each task finished */
+    atomic_int busy[MAX_THREADS];  /* tasks currently running per thread index */
+    atomic_int errors;
+    int fail_task;
+} TestGraph;
+
+static int deps_of(int task, int *deps)
+{
+    const int layer = task / LAYER_SIZE, pos = task % LAYER_SIZE;
+    int nb = 0;
+
+    if (!layer)
+        return 0;
+    /* depend on the task above and its right neighbour, forming diamonds */
+    deps[nb++] = task - LAYER_SIZE;
+    if (pos + 1 < LAYER_SIZE)
+        deps[nb++] = task - LAYER_SIZE + 1;
+    return nb;
+}
+
+static int run_task(void *opaque, int task, int thread)
+{
+    TestGraph *t = opaque;
+    int deps[2], nb = deps_of(task, deps);
+
+    if (thread < 0 || thread >= MAX_THREADS ||
+        atomic_fetch_add(&t->busy[thread], 1)) {
+        atomic_fetch_add(&t->errors, 1);
+        return AVERROR_BUG;
+    }
+
+    for (int i = 0; i < nb; i++) {
+        if (!atomic_load(&t->done[deps[i]]))
+            atomic_fetch_add(&t->errors, 1);
+    }
+    atomic_store(&t->done[task], atomic_fetch_add(&t->seq, 1) + 1);
+
+    atomic_fetch_sub(&t->busy[thread], 1);
+    return task == t->fail_task ? AVERROR(EAGAIN) : 0;
+}
+
+static int init_graph(TestGraph *t)
+{
+    t->graph = av_task_graph_alloc();
+    if (!t->graph)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < NB_TASKS; i++) {
+        int ret = av_task_graph_add_task(t->graph, run_task, t, i);
+        if (ret != i)
+            return ret < 0 ? ret : AVERROR_BUG;
+    }
+
+    for (int i = 0; i < NB_TASKS; i++) {
+        int deps[2], nb = deps_of(i, deps);
+        for (int j = 0; j < nb; j++) {
+            int ret = av_task_graph_add_dependency(t->graph, i, deps[j]);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    return 0;
+}
+
+static int run_graph(AVExecutor *e, TestGraph *t, int fail_task, int async)
+{
+    int ret;
+
+    atomic_init(&t->seq, 0);
+    atomic_init(&t->errors, 0);
+    for (int i = 0; i < NB_TASKS; i++)
+        atomic_init(&t->done[i], 0);
+    for (int i = 0; i < MAX_THREADS; i++)
+        atomic_init(&t->busy[i], 0);
+    t->fail_task = fail_task;
+
+    if (async) {
+        ret = av_executor_start_graph(e, t->graph);
+        if (ret >= 0)
+            ret = av_executor_wait_graph(e, t->graph);
+    } else {
+        ret = av_executor_run_graph(e, t->graph);
+    }
+    if (fail_task >= 0)
+        return ret == AVERROR(EAGAIN) ? 0 : -1;
+    if (ret < 0 || atomic_load(&t->errors) || atomic_load(&t->seq) != NB_TASKS)
+        return -1;
+    return 0;
+}
+
+static int test_cycle(AVExecutor *e)
+{
+    AVTaskGraph *g = av_task_graph_alloc();
+    TestGraph t = { 0 };
+    int ret = -1;
+
+    if (!g)
+        return -1;
+    for (int i = 0; i < 3; i++) {
+        if (av_task_graph_add_task(g, run_task, &t, i) != i)
+            goto end;
+    }
+    if (av_task_graph_add_dependency(g, 1, 0) < 0 ||
+        av_task_graph_add_dependency(g, 2, 1) < 0 ||
+        av_task_graph_add_dependency(g, 0, 2) < 0)
+        goto end;
+    if (av_task_graph_add_dependency(g, 1, 1) != AVERROR(EINVAL) ||
+        av_task_graph_add_dependency(g, 3, 0) != AVERROR(EINVAL))
+        goto end;
+
+    if (av_executor_run_graph(e, g) == AVERROR(EINVAL) &&
+        atomic_load(&t.seq) == 0)
+        ret = 0;
+end:
+    av_task_graph_free(&g);
+    return ret;
+}
+
+#define NB_NESTED (2 * MAX_THREADS)
+
+typedef struct NestedTest {
+    AVExecutor *e;
+    TestGraph inner[NB_NESTED];
+} NestedTest;
+
+static int run_nested(void *opaque, int i, int thread)
+{
+    NestedTest *n = opaque;
+    return run_graph(n->e, &n->inner[i], -1, i & 1) < 0 ? AVERROR_BUG : 0;
+}
+
+/* graphs run from the tasks of another graph on the same executor, which
+ * deadlocks if the inner graphs wait for the threads running the outer one */
+static int test_nested(AVExecutor *e)
+{
+    NestedTest n = { .e = e };
+    AVTaskGraph *g = av_task_graph_alloc();
+    int ret = g ? 0 : -1;
+
+    for (int i = 0; !ret && i < NB_NESTED; i++) {
+        if (init_graph(&n.inner[i]) < 0 ||
+            av_task_graph_add_task(g, run_nested, &n, i) != i)
+            ret = -1;
+    }
+    if (!ret && av_executor_run_graph(e, g) < 0)
+        ret = -1;
+
+    for (int i = 0; i < NB_NESTED; i++)
+        av_task_graph_free(&n.inner[i].graph);
+    av_task_graph_free(&g);
+    return ret;
+}
+
+#if HAVE_THREADS
+static void *caller_thread(void *arg)
+{
+    void **args = arg;
+    intptr_t ret = 0;
+
+    for (int i = 0; i < 20 && !ret; i++)
+        ret = run_graph(args[0], args[1], -1, i & 1);
+    return (void *)ret;
+}
+
+/* several callers sharing one executor */
+static int test_shared(AVExecutor *e)
+{
+    TestGraph t[3] = { 0 };
+    void *args[3][2];
+    pthread_t threads[3];
+    int ret = 0;
+
+    for (int i = 0; i < 3; i++) {
+        if (init_graph(&t[i]) < 0) {
+            ret = -1;
+            goto end;
+        }
+        args[i][0] = e;
+        args[i][1] = &t[i];
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (pthread_create(&threads[i], NULL, caller_thread, args[i])) {
+            ret = -1;
+            for (int j = 0; j < i; j++)
+                pthread_join(threads[j], NULL);
+            goto end;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        void *res;
+        pthread_join(threads[i], &res);
+        if (res)
+            ret = -1;
+    }
+
+end:
+    for (int i = 0; i < 3; i++)
+        av_task_graph_free(&t[i].graph);
+    return ret;
+}
+
+#define NB_WPP_JOBS 64
+
+typedef struct WppTest {
+    AVSliceThread  *slicethread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             progress;   /* number of jobs finished, in order */
+    int             nb_blocked; /* number of executor threads kept busy */
+    int             errors;
+} WppTest;
+
+/* each job waits for the previous one, like the rows of a WPP frame */
+static void wpp_job(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    WppTest *w = priv;
+
+    pthread_mutex_lock(&w->mutex);
+    if (threadnr < 0 || threadnr >= nb_threads)
+        w->errors++;
+    while (w->progress < jobnr)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    w->progress = jobnr + 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+}
+
+/* keeps an executor thread busy until all the jobs are done */
+static int wpp_blocker(void *opaque, int arg, int thread)
+{
+    WppTest *w = opaque;
+
+    pthread_mutex_lock(&w->mutex);
+    w->nb_blocked++;
+    pthread_cond_broadcast(&w->cond);
+    while (w->progress < NB_WPP_JOBS)
+        pthread_cond_wait(&w->cond, &w->mutex);
+    pthread_mutex_unlock(&w->mutex);
+    return 0;
+}
+
+/* slice jobs depending on each other on a shared executor, whose threads are
+ * all busy with other work: this deadlocks if a job can wait for a job that
+ * no running thread has claimed */
+static int test_slicethread(AVExecutor *e)
+{
+    const int nb_threads = av_executor_thread_count(e);
+    AVTaskGraph *blockers = av_task_graph_alloc();
+    WppTest w = { 0 };
+    int ret = blockers ? 0 : -1;
+
+    pthread_mutex_init(&w.mutex, NULL);
+    pthread_cond_init(&w.cond, NULL);
+    for (int i = 0; !ret && i < nb_threads; i++) {
+        if (av_task_graph_add_task(blockers, wpp_blocker, &w, i) != i)
+            ret = -1;
+    }
+    if (!ret && avpriv_slicethread_create_shared(&w.slicethread, &w, wpp_job,
+                                                 NULL, e) < 0)
+        ret = -1;
+
+    for (int i = 0; !ret && i < 10; i++) {
+        w.progress = 0;
+        avpriv_slicethread_execute(w.slicethread, NB_WPP_JOBS, 0);
+        if (w.progress != NB_WPP_JOBS || w.errors)
+            ret = -1;
+    }
+
+    if (!ret) {
+        w.progress = 0;
+        if (av_executor_start_graph(e, blockers) < 0)
+            ret = -1;
+    }
+    if (!ret) {
+        pthread_mutex_lock(&w.mutex);
+        while (w.nb_blocked < nb_threads)
+            pthread_cond_wait(&w.cond, &w.mutex);
+        pthread_mutex_unlock(&w.mutex);
+
+        avpriv_slicethread_execute(w.slicethread, NB_WPP_JOBS, 0);
+        if (av_executor_wait_graph(e, blockers) < 0 ||
+            w.progress != NB_WPP_JOBS || w.errors)
+            ret = -1;
+    }
+
+    avpriv_slicethread_free(&w.slicethread);
+    av_task_graph_free(&blockers);
+    pthread_cond_destroy(&w.cond);
+    pthread_mutex_destroy(&w.mutex);
+    return ret;
+}
+#endif
+
+int main(void)
+{
+    static const int thread_counts[] = { 0, 1, MAX_THREADS };
+    int ret = 0;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(thread_counts); i++) {
+        const int nb_threads = thread_counts[i];
+        AVExecutor *e = av_executor_alloc(NULL, nb_threads);
+        TestGraph t = { 0 };
+
+        if (!e || av_executor_thread_count(e) != nb_threads) {
+            fprintf(stderr, "executor allocation failed\n");
+            return 1;
+        }
+
+        if (init_graph(&t) < 0) {
+            fprintf(stderr, "graph initialization failed\n");
+            ret = 1;
+        }
+        for (int j = 0; !ret && j < 10; j++) {
+            if (run_graph(e, &t, -1, j & 1) < 0) {
+                fprintf(stderr, "graph run failed with %d threads\n", nb_threads);
+                ret = 1;
+            }
+        }
+        if (!ret && run_graph(e, &t, NB_TASKS / 2, 0) < 0) {
+            fprintf(stderr, "task error not reported with %d threads\n", nb_threads);
+            ret = 1;
+        }
+        if (!ret && test_cycle(e) < 0) {
+            fprintf(stderr, "cycle not detected with %d threads\n", nb_threads);
+            ret = 1;
+        }
+        if (!ret && test_nested(e) < 0) {
+            fprintf(stderr, "nested graphs failed with %d threads\n", nb_threads);
+            ret = 1;
+        }
+#if HAVE_THREADS
+        if (!ret && test_shared(e) < 0) {
+            fprintf(stderr, "shared executor failed with %d threads\n", nb_threads);
+            ret = 1;
+        }
+        if (!ret && nb_threads && test_slicethread(e) < 0) {
+            fprintf(stderr, "dependent slice jobs failed with %d threads\n", nb_threads);
+            ret = 1;
+        }
+#endif
+
+        av_task_graph_free(&t.graph);
+        av_executor_free(&e);
+        if (ret)
+            break;
+    }
+
+    return ret;
+}
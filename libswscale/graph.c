@@ -627,8 +627,12 @@ int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *
     graph->exec.input.fmt  = src->format;
     graph->exec.output.fmt = dst->format;
 
-    ret = avpriv_slicethread_create(&graph->slicethread, (void *) graph,
-                                    sws_graph_worker, NULL, ctx->threads);
+    if (ctx->thread_pool && ctx->threads != 1)
+        ret = avpriv_slicethread_create_shared(&graph->slicethread, (void *) graph,
+                                               sws_graph_worker, NULL, ctx->thread_pool);
+    else
+        ret = avpriv_slicethread_create(&graph->slicethread, (void *) graph,
+                                        sws_graph_worker, NULL, ctx->threads);
     if (ret == AVERROR(ENOSYS))
         graph->num_threads = 1;
     else if (ret < 0)
@@ -683,23 +687,94 @@ static int opts_equal(const SwsContext *c1, const SwsContext *c2)
            c1->dst_h_chr_pos == c2->dst_h_chr_pos &&
            c1->dst_v_chr_pos == c2->dst_v_chr_pos &&
            c1->intent        == c2->intent        &&
+           c1->thread_pool   == c2->thread_pool   &&
            !memcmp(c1->scaler_params, c2->scaler_params, sizeof(c1->scaler_params));
 
 }
 
+static int graph_matches(const SwsGraph *graph, SwsContext *ctx,
+                         const SwsFormat *dst, const SwsFormat *src, int field)
+{
+    return graph->field == field         &&
+           ff_fmt_equal(&graph->src, src) &&
+           ff_fmt_equal(&graph->dst, dst) &&
+           opts_equal(ctx, &graph->opts_copy);
+}
+
+/* Move a graph that is no longer active to the front of the cache, evicting
+ * the least recently used graph if the cache is full. */
+static void graph_cache_put(SwsInternal *s, SwsGraph **pgraph)
+{
+    if (!*pgraph)
+        return;
+
+    /* the cache size may have been lowered in the meantime */
+    while (s->graph_cache_nb && s->graph_cache_nb >= s->graph_cache_size)
+        ff_sws_graph_free(&s->graph_cache[--s->graph_cache_nb]);
+
+    if (!s->graph_cache_size) {
+        ff_sws_graph_free(pgraph);
+        return;
+    }
+
+    memmove(&s->graph_cache[1], &s->graph_cache[0],
+            s->graph_cache_nb * sizeof(*s->graph_cache));
+    s->graph_cache[0] = *pgraph;
+    s->graph_cache_nb++;
+    *pgraph = NULL;
+}
+
+/* Remove and return a cached graph for the given parameters, if any. */
+static SwsGraph *graph_cache_get(SwsInternal *s, SwsContext *ctx,
+                                 const SwsFormat *dst, const SwsFormat *src,
+                                 int field)
+{
+    for (int i = 0; i < s->graph_cache_nb; i++) {
+        SwsGraph *graph = s->graph_cache[i];
+        if (!graph_matches(graph, ctx, dst, src, field))
+            continue;
+
+        memmove(&s->graph_cache[i], &s->graph_cache[i + 1],
+                (s->graph_cache_nb - i - 1) * sizeof(*s->graph_cache));
+        s->graph_cache_nb--;
+        return graph;
+    }
+
+    return NULL;
+}
+
+void ff_sws_graph_cache_uninit(SwsContext *ctx)
+{
+    SwsInternal *s = sws_internal(ctx);
+    for (int i = 0; i < s->graph_cache_nb; i++)
+        ff_sws_graph_free(&s->graph_cache[i]);
+    s->graph_cache_nb = 0;
+}
+
 int ff_sws_graph_reinit(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
                         int field, SwsGraph **out_graph)
 {
+    SwsInternal *s = sws_internal(ctx);
     SwsGraph *graph = *out_graph;
-    if (graph && ff_fmt_equal(&graph->src, src) &&
-                 ff_fmt_equal(&graph->dst, dst) &&
-                 opts_equal(ctx, &graph->opts_copy))
-    {
+    if (graph && graph_matches(graph, ctx, dst, src, field)) {
         ff_sws_graph_update_metadata(graph, &src->color);
         return 0;
     }
 
-    ff_sws_graph_free(out_graph);
+    if (s->graph_cache_size) {
+        SwsGraph *cached = graph_cache_get(s, ctx, dst, src, field);
+        graph_cache_put(s, out_graph);
+        if (cached) {
+            s->graph_cache_hits++;
+            ff_sws_graph_update_metadata(cached, &src->color);
+            *out_graph = cached;
+            return 0;
+        }
+        s->graph_cache_misses++;
+    } else {
+        graph_cache_put(s, out_graph);
+    }
+
     return ff_sws_graph_create(ctx, dst, src, field, out_graph);
 }
 
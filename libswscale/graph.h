@@ -141,12 +141,20 @@ void ff_sws_graph_update_metadata(SwsGraph *graph, const SwsColor *color);
 /**
  * Wrapper around ff_sws_graph_create() that reuses the existing graph if the
  * format is compatible. This will also update dynamic per-frame metadata.
+ * If the graph cache of the context is enabled, the replaced graph is kept
+ * there and a cached graph matching the new parameters is reused instead of
+ * creating a new one.
  * Must be called after changing any of the fields in `ctx`, or else they will
  * have no effect.
  */
 int ff_sws_graph_reinit(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
                         int field, SwsGraph **graph);
 
+/**
+ * Free all graphs kept for reuse by ff_sws_graph_reinit().
+ */
+void ff_sws_graph_cache_uninit(SwsContext *ctx);
+
 /**
  * Dispatch the filter graph on a single field. Internally threaded.
  */
@@ -28,8 +28,10 @@ static const char *sws_context_to_name(void *ptr)
 }
 
 #define OFFSET(x) offsetof(SwsContext, x)
+#define OFFSET_INTERNAL(x) offsetof(SwsInternal, x)
 #define DEFAULT 0
 #define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
+#define RO AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY
 
 static const AVOption swscale_options[] = {
     { "sws_flags",           "swscale flags",     OFFSET(flags),  AV_OPT_TYPE_FLAGS, { .i64 = SWS_BICUBIC        }, .flags = VE, .unit = "sws_flags", .max = UINT_MAX },
@@ -91,6 +93,10 @@ static const AVOption swscale_options[] = {
         { "saturation",            "saturation mapping",             0, AV_OPT_TYPE_CONST,  { .i64 = SWS_INTENT_SATURATION            }, .flags = VE, .unit = "intent" },
         { "absolute_colorimetric", "absolute colorimetric clipping", 0, AV_OPT_TYPE_CONST,  { .i64 = SWS_INTENT_ABSOLUTE_COLORIMETRIC }, .flags = VE, .unit = "intent" },
 
+    { "graph_cache",        "number of unused scaling graphs kept for reuse", OFFSET_INTERNAL(graph_cache_size),   AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, SWS_MAX_GRAPH_CACHE, VE },
+    { "graph_cache_hits",   "number of scaling graphs reused from the cache", OFFSET_INTERNAL(graph_cache_hits),   AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, RO },
+    { "graph_cache_misses", "number of scaling graphs not found in the cache", OFFSET_INTERNAL(graph_cache_misses), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, RO },
+
     { NULL }
 };
 
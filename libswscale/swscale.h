@@ -239,6 +239,17 @@ typedef struct SwsContext {
      */
     int intent;
 
+    /**
+     * Thread pool shared with other contexts. If set, processing runs on the
+     * threads of this pool instead of on private threads, and `threads` is
+     * ignored unless it is 1. The pool must have at least one thread and must
+     * outlive the context. When scaling is called from a job running on the
+     * pool, e.g. by a filter, the slices are processed on the calling thread.
+     * Other users of the pool can delay the processing, as the pool does not
+     * share its threads fairly between its users.
+     */
+    struct AVExecutor *thread_pool;
+
     /* Remember to add new fields to graph.c:opts_equal() */
 } SwsContext;
 
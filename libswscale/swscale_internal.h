@@ -50,6 +50,7 @@
 #define MAX_FILTER_SIZE SWS_MAX_FILTER_SIZE
 
 #define SWS_MAX_THREADS 8192 /* sanity clamp */
+#define SWS_MAX_GRAPH_CACHE 64
 
 #if HAVE_BIGENDIAN
 #define ALT32_CORR (-1)
@@ -690,6 +691,13 @@ struct SwsInternal {
     int          color_conversion_warned;
 
     Half2FloatTables *h2f_tables;
+
+    /* Recently used scaling graphs, most recently used first. */
+    SwsGraph  *graph_cache[SWS_MAX_GRAPH_CACHE];
+    int        graph_cache_nb;
+    int        graph_cache_size; /* maximum number of cached graphs */
+    int64_t    graph_cache_hits;
+    int64_t    graph_cache_misses;
 };
 //FIXME check init (where 0)
 
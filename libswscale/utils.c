@@ -1823,8 +1823,12 @@ static int context_init_threaded(SwsContext *sws,
     SwsInternal *c = sws_internal(sws);
     int ret;
 
-    ret = avpriv_slicethread_create(&c->slicethread, (void*) sws,
-                                    ff_sws_slice_worker, NULL, sws->threads);
+    if (sws->thread_pool)
+        ret = avpriv_slicethread_create_shared(&c->slicethread, (void*) sws,
+                                               ff_sws_slice_worker, NULL, sws->thread_pool);
+    else
+        ret = avpriv_slicethread_create(&c->slicethread, (void*) sws,
+                                        ff_sws_slice_worker, NULL, sws->threads);
     if (ret == AVERROR(ENOSYS)) {
         sws->threads = 1;
         return 0;
@@ -2239,6 +2243,7 @@ void sws_freeContext(SwsContext *sws)
 
     for (i = 0; i < FF_ARRAY_ELEMS(c->graph); i++)
         ff_sws_graph_free(&c->graph[i]);
+    ff_sws_graph_cache_uninit(sws);
 
     for (i = 0; i < c->nb_slice_ctx; i++)
         sws_freeContext(c->slice_ctx[i]);
@@ -255,7 +255,25 @@ FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS, ARESAMPLE_FILTER) += $(FATE_AAC_ENCODE
 
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
+# The slice threaded encoder must output the same bitstream as the
+# single-threaded one, compare a 5.1 encode with the default coder and tools.
+AAC_ENCODE_THREADS_ARGS = -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -af "pan=5.1|c0=c0|c1=c1|c2=0.5*c0+0.5*c1|c3=0.2*c0|c4=c0|c5=c1,aresample" -c:a aac -b:a 384k -fflags +bitexact -flags +bitexact -f adts
+
+FATE_AAC_ENCODE_THREADS += fate-aac-encode-threads-1
+fate-aac-encode-threads-1: ./tests/data/asynth-44100-2.wav
+fate-aac-encode-threads-1: CMD = ffmpeg $(AAC_ENCODE_THREADS_ARGS) -threads 1 -y $(TARGET_PATH)/tests/data/fate/aac-encode-threads.adts
+fate-aac-encode-threads-1: CMP = null
+
+FATE_AAC_ENCODE_THREADS += fate-aac-encode-threads-4
+fate-aac-encode-threads-4: fate-aac-encode-threads-1
+fate-aac-encode-threads-4: CMD = ffmpeg $(AAC_ENCODE_THREADS_ARGS) -threads 4 -thread_type slice -
+fate-aac-encode-threads-4: CMP = rawdiff
+fate-aac-encode-threads-4: REF = $(TARGET_PATH)/tests/data/fate/aac-encode-threads.adts
+
+FATE_AAC_ENCODE_THREADS-$(call ENCMUX, AAC, ADTS, PAN_FILTER ARESAMPLE_FILTER) += $(FATE_AAC_ENCODE_THREADS)
+
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes) $(FATE_AAC_ENCODE_THREADS-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
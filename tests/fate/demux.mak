@@ -163,6 +163,15 @@ fate-ts-demux: CMD = ffprobe_demux $(TARGET_SAMPLES)/ac3/mp3ac325-4864-small.ts
 FATE_FFPROBE_DEMUX-$(CONFIG_MPEGTS_DEMUXER) += fate-ts-timed-id3-demux
 fate-ts-timed-id3-demux: CMD = ffprobe_demux $(TARGET_SAMPLES)/mpegts/id3.ts
 
+# the threaded PES reassembly must give the same packets
+FATE_FFPROBE_DEMUX-$(CONFIG_MPEGTS_DEMUXER) += fate-ts-demux-pes-threads
+fate-ts-demux-pes-threads: CMD = ffprobe_demux $(TARGET_SAMPLES)/ac3/mp3ac325-4864-small.ts -pes_threads 4
+fate-ts-demux-pes-threads: REF = $(SRC_PATH)/tests/ref/fate/ts-demux
+
+FATE_FFPROBE_DEMUX-$(CONFIG_MPEGTS_DEMUXER) += fate-ts-small-demux-pes-threads
+fate-ts-small-demux-pes-threads: CMD = ffprobe_demux $(TARGET_SAMPLES)/mpegts/h264small.ts -pes_threads 4
+fate-ts-small-demux-pes-threads: REF = $(SRC_PATH)/tests/ref/fate/ts-small-demux
+
 FATE_SAMPLES_DEMUX += $(FATE_SAMPLES_DEMUX-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_SAMPLES_DEMUX)
 FATE_FFPROBE_DEMUX   += $(FATE_FFPROBE_DEMUX-yes)
@@ -249,6 +249,22 @@ fate-ffmpeg-filter-in-eof: CMD = framecrc
     -filter_complex "[0][1]concat" -c:v rawvideo
 FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, CONCAT_FILTER) += fate-ffmpeg-filter-in-eof
 
+# Test splitting a simple filter chain into pipelined filtergraphs, which
+# must produce the same output as running the chain in a single graph,
+# including quoted and escaped option values and instance names.
+FILTER_PIPELINE_ARGS =                                                                     \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv  \
+    -vf "hflip@first,setpts=2*PTS+min(0\\,1),fps=13,vflip,crop=min(iw\\,320):ih-16,transpose" \
+    -c:v rawvideo
+
+fate-ffmpeg-filter-pipeline: tests/data/vsynth1.yuv
+fate-ffmpeg-filter-pipeline: CMD = framecrc $(FILTER_PIPELINE_ARGS)
+fate-ffmpeg-filter-pipeline-stages: tests/data/vsynth1.yuv
+fate-ffmpeg-filter-pipeline-stages: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-filter-pipeline
+fate-ffmpeg-filter-pipeline-stages: CMD = framecrc -filter_pipeline_stages 3 $(FILTER_PIPELINE_ARGS)
+FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, HFLIP_FILTER SETPTS_FILTER FPS_FILTER VFLIP_FILTER CROP_FILTER TRANSPOSE_FILTER) += \
+    fate-ffmpeg-filter-pipeline fate-ffmpeg-filter-pipeline-stages
+
 # Test termination on streamcopy with -t as an output option.
 fate-ffmpeg-streamcopy-t: tests/data/vsynth1.yuv
 fate-ffmpeg-streamcopy-t: CMP = null
@@ -257,6 +273,19 @@ fate-ffmpeg-streamcopy-t: CMD = ffmpeg
     -c copy -f null -t 1 -
 FATE_FFMPEG-$(call REMUX, RAWVIDEO) += fate-ffmpeg-streamcopy-t
 
+# Test writing a file through io_uring and reading it back, which must give
+# the same packets as the original file.
+fate-ffmpeg-uring-write: tests/data/vsynth1.yuv
+fate-ffmpeg-uring-write: CMD = framecrc                                                           \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv              \
+    -c copy -f rawvideo -y uring:$(TARGET_PATH)/tests/data/fate/ffmpeg-uring.yuv -c copy
+fate-ffmpeg-uring-read: fate-ffmpeg-uring-write
+fate-ffmpeg-uring-read: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-uring-write
+fate-ffmpeg-uring-read: CMD = framecrc                                                            \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -i uring:$(TARGET_PATH)/tests/data/fate/ffmpeg-uring.yuv \
+    -c copy
+FATE_FFMPEG-$(call REMUX, RAWVIDEO, URING_PROTOCOL) += fate-ffmpeg-uring-write fate-ffmpeg-uring-read
+
 # Test loopback decoding and passing the output to a complex graph.
 fate-ffmpeg-loopback-decoding: tests/data/vsynth1.yuv
 fate-ffmpeg-loopback-decoding: CMD = transcode \
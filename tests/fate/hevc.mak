@@ -221,6 +221,17 @@ FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) +=         \
 
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) += $(HEVC_TESTS_MULTIVIEW)
 
+# Decode the tiles of the slice segments in parallel, the output must match the
+# sequential decoding.
+HEVC_TESTS_TILE_THREADS = TILES_A_Cisco_2 TILES_B_Cisco_1
+
+fate-hevc-tile-threads-%: CMD = framecrc -flags output_corrupt -i $(TARGET_SAMPLES)/hevc-conformance/$(subst fate-hevc-tile-threads-,,$(@)).bit -pix_fmt yuv420p
+fate-hevc-tile-threads-%: REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(subst fate-hevc-tile-threads-,,$(@))
+fate-hevc-tile-threads-%: THREADS = 4
+fate-hevc-tile-threads-%: THREAD_TYPE = slice
+
+FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER) += $(HEVC_TESTS_TILE_THREADS:%=fate-hevc-tile-threads-%)
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -fps_mode passthrough -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER LARGE_TESTS) += fate-hevc-paramchange-yuv420p-yuv420p10
 
@@ -85,6 +85,20 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-list-size: tests/data/hls_list_size.m3u8
 fate-hls-list-size: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_list_size.m3u8 -vf setpts=N*23
 
+# Same output as fate-hls-list-size, with the files written on a background
+# thread.
+tests/data/hls_async_io.m3u8: TAG = GEN
+tests/data/hls_async_io.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f hls -hls_time 4 -map 0 \
+	-hls_list_size 4 -async_io 2 -codec:a mp2fixed -hls_segment_filename $(TARGET_PATH)/tests/data/hls_async_io_%d.ts \
+	$(TARGET_PATH)/tests/data/hls_async_io.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER ARESAMPLE_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-async-io
+fate-hls-async-io: tests/data/hls_async_io.m3u8
+fate-hls-async-io: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_async_io.m3u8 -vf setpts=N*23
+fate-hls-async-io: REF = $(SRC_PATH)/tests/ref/fate/hls-list-size
+
 tests/data/hls_fmp4.m3u8: TAG = GEN
 tests/data/hls_fmp4.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
@@ -109,6 +123,33 @@ FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER EAC3_DEMUXER) += fate-hls-fmp4_ac3
 fate-hls-fmp4_ac3: tests/data/hls_fmp4_ac3.m3u8
 fate-hls-fmp4_ac3: CMD = probeaudiostream $(TARGET_PATH)/tests/data/now_ac3.mp4
 
+# Low-latency HLS: every playlist update is written to stdout, so that the
+# partial segments and the preload hint of the intermediate playlists are
+# checked too.
+FATE_HLSENC-$(call ALLYES, HLS_MUXER MP4_MUXER AEVALSRC_FILTER ARESAMPLE_FILTER LAVFI_INDEV MP2FIXED_ENCODER PIPE_PROTOCOL) += fate-hls-part-time
+fate-hls-part-time: CMD = ffmpeg -auto_conversion_filters \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=3" -map 0 -codec:a mp2fixed \
+	-f hls -hls_segment_type fmp4 -hls_time 1 -hls_part_time 0.25 -hls_list_size 0 \
+	-hls_fmp4_init_filename $(TARGET_PATH)/tests/data/hls_part_init.mp4 \
+	-hls_segment_filename "$(TARGET_PATH)/tests/data/hls_part_%d.m4s" \
+	pipe:1 | grep -e "^\#EXT-X-PART" -e "^\#EXT-X-PRELOAD-HINT"
+
+tests/data/hls_prefetch_id3.m3u8: TAG = GEN
+tests/data/hls_prefetch_id3.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=10" -map 0 -codec:a aac \
+	-metadata title=prefetch -f segment -segment_format adts -segment_format_options write_id3v2=1 \
+	-segment_time 2 -segment_list_type m3u8 -segment_list $(TARGET_PATH)/tests/data/hls_prefetch_id3.m3u8 \
+	$(TARGET_PATH)/tests/data/hls_prefetch_id3_%d.aac 2>/dev/null
+
+# Audio elementary stream segments starting with an ID3 tag, which is stripped
+# from the prefetched data.
+FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER AAC_DEMUXER SEGMENT_MUXER ADTS_MUXER AAC_ENCODER AEVALSRC_FILTER ARESAMPLE_FILTER LAVFI_INDEV) += fate-hls-prefetch-id3
+fate-hls-prefetch-id3: tests/data/hls_prefetch_id3.m3u8
+fate-hls-prefetch-id3: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -bitexact -prefetch_segments 3 -count_packets \
+	-show_entries stream=codec_name,nb_read_packets:stream_tags=title -print_format compact \
+	$(TARGET_PATH)/tests/data/hls_prefetch_id3.m3u8
+
 FATE_SAMPLES_FFMPEG += $(FATE_HLSENC-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HLSENC_PROBE-yes)
 fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes)
@@ -2,10 +2,20 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT-$(CONFIG_CACHE_PROTOCOL) += fate-cache
+fate-cache: libavformat/tests/cache$(EXESUF)
+fate-cache: CMD = run libavformat/tests/cache$(EXESUF) $(TARGET_PATH)/tests/data/cache.tmp
+fate-cache: CMP = null
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
 
+FATE_LIBAVFORMAT-$(CONFIG_RANGES_PROTOCOL) += fate-ranges
+fate-ranges: libavformat/tests/ranges$(EXESUF)
+fate-ranges: CMD = run libavformat/tests/ranges$(EXESUF)
+fate-ranges: CMP = null
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh$(EXESUF)
@@ -26,6 +36,16 @@ FATE_LIBAVFORMAT-$(CONFIG_IMF_DEMUXER) += fate-imf
 fate-imf: libavformat/tests/imf$(EXESUF)
 fate-imf: CMD = run libavformat/tests/imf$(EXESUF)
 
+FATE_LIBAVFORMAT-$(CONFIG_FILE_PROTOCOL) += fate-file_mmap
+fate-file_mmap: libavformat/tests/file_mmap$(EXESUF)
+fate-file_mmap: CMD = run libavformat/tests/file_mmap$(EXESUF) $(TARGET_PATH)/tests/data/file_mmap.tmp
+fate-file_mmap: CMP = null
+
+FATE_LIBAVFORMAT += fate-packedindex
+fate-packedindex: libavformat/tests/packedindex$(EXESUF)
+fate-packedindex: CMD = run libavformat/tests/packedindex$(EXESUF)
+fate-packedindex: CMP = null
+
 FATE_LIBAVFORMAT += fate-seek_utils
 fate-seek_utils: libavformat/tests/seek_utils$(EXESUF)
 fate-seek_utils: CMD = run libavformat/tests/seek_utils$(EXESUF)
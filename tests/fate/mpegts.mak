@@ -22,4 +22,25 @@ fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_ve
 
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+#
+# Test resynchronizing after lost bytes, in the middle of a batch of the
+# threaded PES reassembly
+#
+tests/data/mpegts-resync.ts: TAG = GEN
+tests/data/mpegts-resync.ts: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+        -f lavfi -i "aevalsrc=sin(440*2*PI*t):d=1" -c:v mpeg2video -q:v 2 -c:a mp2fixed \
+        -flags +bitexact -fflags +bitexact -f mpegts -y $(TARGET_PATH)/$@ 2>/dev/null
+
+MPEGTS_RESYNC_SRC = "concat:subfile,,start,0,end,200100,,:$(TARGET_PATH)/tests/data/mpegts-resync.ts|subfile,,start,200200,end,0,,:$(TARGET_PATH)/tests/data/mpegts-resync.ts"
+
+FATE_MPEGTS_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER MPEG2VIDEO_ENCODER LAVFI_INDEV AEVALSRC_FILTER ARESAMPLE_FILTER MP2FIXED_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER CONCAT_PROTOCOL SUBFILE_PROTOCOL FRAMECRC_MUXER PIPE_PROTOCOL) += fate-mpegts-resync fate-mpegts-resync-pes-threads
+fate-mpegts-resync fate-mpegts-resync-pes-threads: tests/data/mpegts-resync.ts
+fate-mpegts-resync: CMD = framecrc -i $(MPEGTS_RESYNC_SRC) -c copy
+fate-mpegts-resync-pes-threads: CMD = framecrc -pes_threads 4 -i $(MPEGTS_RESYNC_SRC) -c copy
+fate-mpegts-resync-pes-threads: REF = $(SRC_PATH)/tests/ref/fate/mpegts-resync
+
+FATE_FFMPEG += $(FATE_MPEGTS_FFMPEG-yes)
+
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_FFMPEG-yes)
@@ -198,6 +198,24 @@ fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_
 
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# Seek in a fragmented file without sidx or mfra while writing its side-car
+# fragment index, then with the index loaded.
+tests/data/mov-index-file.mp4: TAG = GEN
+tests/data/mov-index-file.mp4: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)rm -f tests/data/mov-index-file.idx; $(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -t 2 -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+        -c:v mpeg4 -g 5 -flags +bitexact -fflags +bitexact -movflags frag_keyframe \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_SEEK_INDEX_FILE-$(call ALLYES, RAWVIDEO_DEMUXER MPEG4_ENCODER MP4_MUXER MOV_DEMUXER FILE_PROTOCOL) += \
+    fate-seek-mov-index-file-write fate-seek-mov-index-file-read
+fate-seek-mov-index-file-write: tests/data/mov-index-file.mp4
+fate-seek-mov-index-file-read: fate-seek-mov-index-file-write
+$(FATE_SEEK_INDEX_FILE-yes): libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_INDEX_FILE-yes): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov-index-file.mp4 \
+                                  -index_file $(TARGET_PATH)/tests/data/mov-index-file.idx
+$(FATE_SEEK_INDEX_FILE-yes): REF = $(SRC_PATH)/tests/ref/seek/mov-index-file
+
 
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
@@ -205,6 +223,6 @@ $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 $(subst fate-seek-,fate-,$(FATE_SAMPLES_SEEK) $(FATE_SEEK)): KEEP_FILES ?= 1
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_INDEX_FILE-yes)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_INDEX_FILE-yes)
@@ -50,6 +50,32 @@ $(foreach N,$(FATE_SEGMENT_ALLPARTS),$(eval $(N:%=fate-segment-adts-to-mkv-heade
 fate-segment-adts-to-mkv-header-%: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/$(@:fate-segment-adts-to-mkv-header-%=adts-to-mkv-cated-%).mkv -c copy
 FATE_SEGMENT-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER MATROSKA_DEMUXER SEGMENT_MUXER HLS_DEMUXER) += $(FATE_SEGMENT_SPLIT)
 
+# Write the segments and lists on a background thread: the concatenated
+# segments must give the input frames, and the lists must only reference the
+# segments which were written.
+tests/data/segment-async.ffconcat: TAG = GEN
+tests/data/segment-async.ffconcat: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+        -f segment -async_io 2 -segment_time 0.2 -map 0 -flags +bitexact -codec copy -segment_format nut \
+        -segment_list $(TARGET_PATH)/$@ -y $(TARGET_PATH)/tests/data/segment-async-%03d.nut 2>/dev/null
+
+tests/data/segment-async.m3u8: TAG = GEN
+tests/data/segment-async.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) tests/data/vsynth1.yuv | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+        -f segment -async_io 2 -segment_time 0.2 -map 0 -flags +bitexact -codec copy -segment_format nut \
+        -segment_list_size 2 -segment_list $(TARGET_PATH)/$@ -y $(TARGET_PATH)/tests/data/segment-async-m3u8-%03d.nut 2>/dev/null
+
+FATE_SEGMENT_ASYNC-$(call ALLYES, RAWVIDEO_DEMUXER NUT_MUXER NUT_DEMUXER SEGMENT_MUXER CONCAT_DEMUXER FRAMECRC_MUXER PIPE_PROTOCOL) += fate-segment-async-io
+fate-segment-async-io: tests/data/segment-async.ffconcat
+fate-segment-async-io: CMD = framecrc -safe 0 -i $(TARGET_PATH)/tests/data/segment-async.ffconcat -c copy
+
+FATE_SEGMENT_ASYNC-$(call ALLYES, RAWVIDEO_DEMUXER NUT_MUXER SEGMENT_MUXER) += fate-segment-async-io-list-size
+fate-segment-async-io-list-size: tests/data/segment-async.m3u8
+fate-segment-async-io-list-size: CMD = cat $(TARGET_PATH)/tests/data/segment-async.m3u8
+
+FATE_FFMPEG += $(FATE_SEGMENT_ASYNC-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_SEGMENT-yes)
 
-fate-segment: $(FATE_SEGMENT-yes)
+fate-segment: $(FATE_SEGMENT-yes) $(FATE_SEGMENT_ASYNC-yes)
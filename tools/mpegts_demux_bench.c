@@ -0,0 +1,251 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Measures the throughput of the MPEG-TS demuxer on a synthetic multi
+ * program transport stream held in memory, with the PES reassembly done
+ * sequentially and with pes_threads, and checks that both return the same
+ * packets in the same order.
+ *
+ * Usage: mpegts_demux_bench [nb_programs [duration [threads [mbps]]]] */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+
+#define AUDIO_FRAME_SIZE 576
+
+typedef struct Input {
+    const uint8_t *data;
+    size_t size, pos;
+} Input;
+
+static int read_input(void *opaque, uint8_t *buf, int size)
+{
+    Input *in = opaque;
+
+    size = FFMIN(size, in->size - in->pos);
+    if (!size)
+        return AVERROR_EOF;
+    memcpy(buf, in->data + in->pos, size);
+    in->pos += size;
+    return size;
+}
+
+/* nb_programs programs of one video and one audio stream with random
+ * payloads, the video streams using most of the bitrate */
+static int generate(uint8_t **buf, int *size, int nb_programs, int duration,
+                    int mbps)
+{
+    const int video_size = (mbps * 1000000LL / 8 / nb_programs -
+                            AUDIO_FRAME_SIZE * 1000 / 24) / 25;
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    uint8_t *payload = NULL;
+    AVLFG lfg;
+    int ret;
+
+    *buf = NULL;
+    if (video_size <= 0)
+        return AVERROR(EINVAL);
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "mpegts", NULL);
+    if (ret < 0)
+        goto end;
+    payload = av_malloc(video_size);
+    if (!pkt || !payload) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    av_lfg_init(&lfg, 0);
+    for (int i = 0; i < video_size; i++)
+        payload[i] = av_lfg_get(&lfg);
+
+    for (int i = 0; i < nb_programs; i++) {
+        AVProgram *prg = av_new_program(oc, i + 1);
+        if (!prg) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (int j = 0; j < 2; j++) {
+            AVStream *st = avformat_new_stream(oc, NULL);
+            if (!st) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            if (!j) {
+                st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+                st->codecpar->codec_id   = AV_CODEC_ID_MPEG2VIDEO;
+            } else {
+                st->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+                st->codecpar->codec_id    = AV_CODEC_ID_MP2;
+                st->codecpar->sample_rate = 48000;
+                av_channel_layout_default(&st->codecpar->ch_layout, 2);
+            }
+            av_program_add_stream_index(oc, prg->id, st->index);
+        }
+    }
+
+    ret = avio_open_dyn_buf(&oc->pb);
+    if (ret < 0)
+        goto end;
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0)
+        goto end;
+
+    /* the video frames last 40 ms and the audio frames 24 ms */
+    for (int64_t t = 0; t < duration * 1000LL && ret >= 0; t++) {
+        for (int i = 0; i < 2 * nb_programs && ret >= 0; i++) {
+            int audio = i & 1;
+            if (t % (audio ? 24 : 40))
+                continue;
+            ret = av_new_packet(pkt, audio ? AUDIO_FRAME_SIZE : video_size);
+            if (ret < 0)
+                break;
+            memcpy(pkt->data, payload, pkt->size);
+            pkt->stream_index = i;
+            pkt->pts = pkt->dts = av_rescale_q(t, (AVRational){ 1, 1000 },
+                                              oc->streams[i]->time_base);
+            pkt->flags = AV_PKT_FLAG_KEY;
+            ret = av_interleaved_write_frame(oc, pkt);
+        }
+    }
+    if (ret < 0)
+        goto end;
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc && oc->pb) {
+        *size = avio_close_dyn_buf(oc->pb, buf);
+        oc->pb = NULL;
+    }
+    avformat_free_context(oc);
+    av_packet_free(&pkt);
+    av_free(payload);
+    if (ret < 0)
+        av_freep(buf);
+    return ret;
+}
+
+static int run(const uint8_t *data, int size, int threads, uint32_t *checksum)
+{
+    Input in = { .data = data, .size = size };
+    AVFormatContext *ic = avformat_alloc_context();
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    uint8_t *iobuf = av_malloc(65536);
+    AVPacket *pkt = av_packet_alloc();
+    int64_t t0, t1, nb_packets = 0;
+    int ret;
+
+    *checksum = 1;
+    if (!ic || !iobuf || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    pb = avio_alloc_context(iobuf, 65536, 0, &in, read_input, NULL, NULL);
+    if (!pb) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    iobuf = NULL;
+    ic->pb     = pb;
+    ic->flags |= AVFMT_FLAG_NOPARSE;
+    av_dict_set_int(&opts, "pes_threads", threads, 0);
+
+    t0  = av_gettime_relative();
+    ret = avformat_open_input(&ic, NULL, av_find_input_format("mpegts"), &opts);
+    if (ret < 0)
+        goto end;
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        uint8_t hdr[12];
+        memcpy(hdr, &pkt->stream_index, 4);
+        memcpy(hdr + 4, &pkt->pts, 8);
+        *checksum = av_adler32_update(*checksum, hdr, sizeof(hdr));
+        *checksum = av_adler32_update(*checksum, pkt->data, pkt->size);
+        nb_packets++;
+        av_packet_unref(pkt);
+    }
+    t1 = av_gettime_relative();
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+    if (!ret)
+        printf("pes_threads %-3d %8.1f Mbit/s %8.0f packets/s\n", threads,
+               size * 8.0 / FFMAX(t1 - t0, 1),
+               nb_packets * 1e6 / FFMAX(t1 - t0, 1));
+
+end:
+    avformat_close_input(&ic);
+    if (pb)
+        av_freep(&pb->buffer);
+    avio_context_free(&pb);
+    av_free(iobuf);
+    av_packet_free(&pkt);
+    av_dict_free(&opts);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_programs = argc > 1 ? strtol(argv[1], NULL, 0) : 20;
+    int duration    = argc > 2 ? strtol(argv[2], NULL, 0) : 4;
+    int threads     = argc > 3 ? strtol(argv[3], NULL, 0) : 4;
+    int mbps        = argc > 4 ? strtol(argv[4], NULL, 0) : 200;
+    uint32_t ref, checksum;
+    uint8_t *data;
+    int size, ret;
+
+    if (nb_programs <= 0 || duration <= 0 || threads <= 1 || mbps <= 0) {
+        fprintf(stderr, "Usage: %s [nb_programs [duration [threads [mbps]]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    ret = generate(&data, &size, nb_programs, duration, mbps);
+    if (ret < 0) {
+        fprintf(stderr, "Generating the stream failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    printf("%d programs, %d MB\n", nb_programs, size >> 20);
+
+    ret = run(data, size, 0, &ref);
+    if (ret >= 0)
+        ret = run(data, size, threads, &checksum);
+    if (ret >= 0 && checksum != ref) {
+        fprintf(stderr, "Output differs with pes_threads\n");
+        ret = AVERROR_BUG;
+    }
+    av_free(data);
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Measures the number of packets per second that can be passed between two
+ * threads through the ffmpeg CLI ThreadQueue, with and without the lock-free
+ * single-producer/single-consumer mode.
+ *
+ * Usage: thread_queue_bench [nb_packets [queue_size [nb_streams]]] */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/packet.h"
+
+#include "fftools/thread_queue.h"
+
+typedef struct BenchContext {
+    ThreadQueue *tq;
+    unsigned     nb_streams;
+    int64_t      nb_packets;
+    int          ret;
+} BenchContext;
+
+static void *sender(void *arg)
+{
+    BenchContext *bc = arg;
+    AVPacket *pkt = av_packet_alloc();
+    int ret = 0;
+
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int64_t i = 0; i < bc->nb_packets; i++) {
+        ret = av_new_packet(pkt, 188);
+        if (ret < 0)
+            break;
+        pkt->pts = i;
+
+        ret = tq_send(bc->tq, i % bc->nb_streams, pkt);
+        if (ret < 0)
+            break;
+    }
+
+finish:
+    for (unsigned i = 0; i < bc->nb_streams; i++)
+        tq_send_finish(bc->tq, i);
+
+    av_packet_free(&pkt);
+    bc->ret = ret;
+    return NULL;
+}
+
+static int run(int64_t nb_packets, unsigned queue_size, unsigned nb_streams,
+               unsigned flags)
+{
+    BenchContext bc = { .nb_streams = nb_streams, .nb_packets = nb_packets };
+    AVPacket *pkt;
+    pthread_t thread;
+    int64_t t0, t1, received = 0;
+    int ret, stream_idx;
+
+    bc.tq = tq_alloc(nb_streams, queue_size, THREAD_QUEUE_PACKETS, flags);
+    pkt   = av_packet_alloc();
+    if (!bc.tq || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    t0 = av_gettime_relative();
+
+    ret = pthread_create(&thread, NULL, sender, &bc);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto finish;
+    }
+
+    while (1) {
+        ret = tq_receive(bc.tq, &stream_idx, pkt);
+        if (ret == AVERROR_EOF && stream_idx >= 0)
+            continue;
+        if (ret < 0)
+            break;
+
+        if (pkt->pts != received) {
+            fprintf(stderr, "Packet %"PRId64" received out of order\n", received);
+            ret = AVERROR_BUG;
+        }
+        received++;
+        av_packet_unref(pkt);
+    }
+
+    pthread_join(thread, NULL);
+    t1 = av_gettime_relative();
+
+    if (ret == AVERROR_EOF)
+        ret = 0;
+    if (!ret && bc.ret < 0)
+        ret = bc.ret;
+    if (!ret && received != nb_packets) {
+        fprintf(stderr, "Received %"PRId64" packets, expected %"PRId64"\n",
+                received, nb_packets);
+        ret = AVERROR_BUG;
+    }
+
+    if (!ret)
+        printf("%-10s %10.0f packets/s\n",
+               (flags & THREAD_QUEUE_FLAG_SPSC) ? "spsc" : "locked",
+               received * 1e6 / FFMAX(t1 - t0, 1));
+
+finish:
+    av_packet_free(&pkt);
+    tq_free(&bc.tq);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t  nb_packets = argc > 1 ? strtoll(argv[1], NULL, 0) : 1000000;
+    unsigned queue_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 8;
+    unsigned nb_streams = argc > 3 ? strtoul(argv[3], NULL, 0) : 1;
+    int ret;
+
+    if (nb_packets <= 0 || !queue_size || !nb_streams) {
+        fprintf(stderr, "Usage: %s [nb_packets [queue_size [nb_streams]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    ret = run(nb_packets, queue_size, nb_streams, 0);
+    if (ret >= 0)
+        ret = run(nb_packets, queue_size, nb_streams, THREAD_QUEUE_FLAG_SPSC);
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}